@@ -10,7 +10,9 @@
  *              the getlocaltime function.  
  *             
  * Board        ESP32 / TFT 128 x 160 with SPI ST7735 driver 
- * Remarks      The refresh rate in ms is passed to the class contructor
+ * Remarks      The refresh rate in ms is passed to the class contructor.
+ *              The whole dial is drawn into a compositor every second, which
+ *              sends only the regions of the moved hands to the panel.
  * References     
  */
 #include "AnalogClock.h"
@@ -55,22 +57,24 @@ void AnalogClock::stop()
 {
   //Serial.println("clock stop");
   _isRunning = false;
+  _compositor.printStats("Analog Clock");
+  _compositor.end();
 }
 
 void AnalogClock::setup()
 {
   uint16_t radius = lcd.height() > lcd.width() ? lcd.width()/2 : lcd.height()/2;
-  lcd.fillScreen(TFT_BLACK);
-  lcd.setTextColor(TFT_GREEN, TFT_BLACK);
-  lcd.setFont(&fonts::Orbitron_Light_24);
-  lcd.setTextSize(0.75);
-  drawDial(lcd.width()/2, lcd.height()/2, radius - 10);
+  _compositor.begin(100);
+  _mx  = lcd.width()/2;
+  _my  = lcd.height()/2;
+  _r   = radius - 10;
   _isRunning = true;
+  updateDial();
 }
 
 void AnalogClock::loop()
 {
-  if (_waitAnalogClock->isOver())
+  if (_isRunning && _waitAnalogClock->isOver())
   {
     updateDial();
   }
@@ -87,11 +91,16 @@ void AnalogClock::updateDial()
   _hh = _rtcTime.tm_hour;
   _mm = _rtcTime.tm_min;
   _ss = _rtcTime.tm_sec;
-  lcd.fillCircle(_mx, _my, _rTh, TFT_BLACK);          // Erase old hands 
+  _compositor.fillScreen(TFT_BLACK);                  // The whole dial, only the 
+  drawDial(_mx, _my, _r);                             // changes reach the panel
   
-  strftime(theDate, 20, "%F", &_rtcTime);             // Date as yyyy-mo-dd
-  lcd.drawString(theDate, (lcd.width()-lcd.textWidth(theDate))/2, 3*_r/2); // place date string
+  _compositor.setTextColor(TFT_GREEN, TFT_BLACK);
+  _compositor.setFont(&fonts::Orbitron_Light_24);
+  _compositor.setTextSize(0.75);
+  strftime(theDate, sizeof(theDate), "%F", &_rtcTime);  // Date as yyyy-mo-dd
+  _compositor.drawString(theDate, (lcd.width()-_compositor.textWidth(theDate))/2, 3*_r/2); // place date string
   drawHands(_hh, _mm, _ss, _mx, _my, _rH, _rM, _rS);  // Draw new hands
+  _compositor.flush();
 }
 
 
@@ -110,7 +119,7 @@ void AnalogClock::drawTickMarks(int mx, int my, int r1, int r2, int nbr, int col
     y1 = my + r1 * sinPhi;
     x2 = mx + r2 * cosPhi;
     y2 = my + r2 * sinPhi;
-    lcd.drawLine(x1, y1, x2, y2, color);
+    _compositor.drawLine(x1, y1, x2, y2, color);
   }
 }
 
@@ -135,11 +144,11 @@ void AnalogClock::drawHands(int hh, int mm, int ss, int mx, int my, int rH, int
   xS = rS * cos(wSec) + mx;  x1S = mx -rS/4 * cos(wSec);
   yS = rS * sin(wSec) + my;  y1S = my -rS/4 * sin(wSec);
 
-  lcd.drawLine(x1H, y1H, xH, yH, TFT_WHITE);
-  lcd.drawLine(x1M, y1M, xM, yM, TFT_WHITE);
-  lcd.drawLine(x1S, y1S, xS, yS, TFT_RED);
+  _compositor.drawLine(x1H, y1H, xH, yH, TFT_WHITE);
+  _compositor.drawLine(x1M, y1M, xM, yM, TFT_WHITE);
+  _compositor.drawLine(x1S, y1S, xS, yS, TFT_RED);
 
-  lcd.fillCircle(mx, my, 4, TFT_RED);  // Draw red center disk      
+  _compositor.fillCircle(mx, my, 4, TFT_RED);  // Draw red center disk      
 }
 
 void AnalogClock::drawDial(int mx, int my, int radius)
@@ -153,8 +162,8 @@ void AnalogClock::drawDial(int mx, int my, int radius)
   _rTh = _r-13;   // radius of hour tickmarks
   _rTm = _r-7;    // radius of minute tickmarks
 
-  lcd.drawRect(0,0,lcd.width(),lcd.height(), TFT_GREEN); // Draw green border
-  lcd.drawArc(_mx, _my, _r, _rTm, 0.0, 360.0, TFT_BLUE); // Draw blue ring  
+  _compositor.drawRect(0,0,lcd.width(),lcd.height(), TFT_GREEN); // Draw green border
+  _compositor.drawArc(_mx, _my, _r, _rTm, 0.0, 360.0, TFT_BLUE); // Draw blue ring  
     
   drawTickMarks(_mx, _my, _r, _rTm,  60, TFT_BLUE);  // Draw 60 short minute tick marks
   drawTickMarks(_mx, _my, _r, _rTh,  12, TFT_BLUE);  // Draw 12 longer hour tickmarks
@@ -8,6 +8,7 @@
 #include <Arduino.h>
 #include "lgfx_ESP32_2432S028.h"
 #include "Wait.h"
+#include "Compositor.h"
 
 extern LGFX lcd;
 
@@ -28,6 +29,7 @@ class AnalogClock
     uint32_t _msRefresh;
     Wait *_waitAnalogClock = new Wait(_msRefresh);
     struct tm _rtcTime;
+    Compositor _compositor{lcd};  // flushes only the moved hands and the changed date
     void drawDial(int mx, int my, int radius);
     void drawTickMarks(int mx, int my, int r1, int r2, int nbr, int color);
     void drawHands(int hh, int mm, int ss, int mx, int my, int rH, int rM, int rS);
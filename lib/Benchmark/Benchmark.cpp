@@ -0,0 +1,29 @@
+/**
+ * Module       Benchmark
+ * 
+ * Purpose      Measures what the panel path delivers for the drawing primitives 
+ *              used by the actions: single pixels, fast lines, rectangles of 
+ *              several sizes, lines, circles, triangles, text per font, pushImage
+ *              with and without DMA and readRect.
+ *              - Each test runs within one startWrite() / endWrite(), so the 
+ *                numbers show the primitive and not the bus acquisition.
+ *              - MB/s counts the rgb565 pixel data only, the commands and the
+ *                address windows are the difference to the SPI clock.
+ *              - The results are printed as CSV, which can be compared with
+ *                the results of the host build.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The pixels per text operation are the size of the text box.
+ * References   https://github.com/lovyan03/LovyanGFX
+ */
+#include "Benchmark.h"
+
+void printBenchCsv(const BenchResult *results, int nbrResults)
+{
+  Serial.println("test,reps,us,ops_per_s,pixels_per_s,mb_per_s");
+  for (int i = 0; i < nbrResults; i++)
+  {
+    const BenchResult &r = results[i];
+    Serial.printf("%s,%u,%u,%.0f,%.0f,%.3f\n", r.name, r.reps, r.usTotal, r.opsPerSec, r.pixelsPerSec, r.mbPerSec);
+  }
+}
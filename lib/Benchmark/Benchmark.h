@@ -0,0 +1,144 @@
+/**
+ * Benchmark.h
+ * 
+ * Declaration of the class template Benchmark, which measures the drawing
+ * primitives of a graphics class. Each test runs a warm-up and then a 
+ * number of repetitions and reports operations, pixels and SPI megabytes 
+ * per second. The template works with the LGFX panel and with any class 
+ * with the same methods, e.g. a framebuffer on the host, so the results 
+ * can be compared between builds.
+ */ 
+#pragma once
+#include <Arduino.h>
+#include <initializer_list>
+
+struct BenchResult
+{
+  const char *name;
+  uint32_t reps;
+  uint32_t usTotal;
+  float    opsPerSec;
+  float    pixelsPerSec;
+  float    mbPerSec;          // rgb565 pixel data, without commands
+};
+
+void printBenchCsv(const BenchResult *results, int nbrResults);
+
+template <class GFX>
+class Benchmark
+{
+  public:
+    static constexpr int MAX_RESULTS = 24;
+
+    Benchmark(GFX &gfx) : _gfx(gfx) {}
+    int run(uint32_t scale = 1);
+    const BenchResult *getResults() { return _results; }
+    int getNbrResults() { return _nbrResults; }
+    void showResults();
+
+  private:
+    GFX         &_gfx;
+    BenchResult _results[MAX_RESULTS];
+    int         _nbrResults = 0;
+
+    template <class OP>
+    void measure(const char *name, uint32_t reps, uint32_t pixelsPerOp, OP op);
+};
+
+/**
+ * Run op(i) reps / 10 times as warm-up, then reps times
+ * within one startWrite() / endWrite() and store the result
+*/
+template <class GFX>
+template <class OP>
+void Benchmark<GFX>::measure(const char *name, uint32_t reps, uint32_t pixelsPerOp, OP op)
+{
+  if (_nbrResults >= MAX_RESULTS) return;
+
+  _gfx.startWrite();
+  for (uint32_t i = 0; i < max(reps / 10, (uint32_t)1); i++) op(i);
+  _gfx.waitDMA();
+  uint32_t usStart = micros();
+  for (uint32_t i = 0; i < reps; i++) op(i);
+  _gfx.waitDMA();
+  uint32_t usTotal = max(micros() - usStart, (uint32_t)1);
+  _gfx.endWrite();
+
+  BenchResult &r = _results[_nbrResults++];
+  r.name         = name;
+  r.reps         = reps;
+  r.usTotal      = usTotal;
+  r.opsPerSec    = 1e6f * reps / usTotal;
+  r.pixelsPerSec = r.opsPerSec * pixelsPerOp;
+  r.mbPerSec     = 2.0f * r.pixelsPerSec / 1e6f;
+}
+
+/**
+ * Run all tests, scale multiplies the repetitions. 
+ * Returns the number of results.
+*/
+template <class GFX>
+int Benchmark<GFX>::run(uint32_t scale)
+{
+  const int w = _gfx.width();
+  const int h = _gfx.height();
+  const int IMG = 64;
+  uint16_t *image = (uint16_t *)heap_caps_malloc(IMG * IMG * sizeof(uint16_t), MALLOC_CAP_DMA);
+  auto color = [](uint32_t i) -> uint16_t { return (uint16_t)(i * 0x9E37); };
+
+  _nbrResults = 0;
+  _gfx.fillScreen(0);
+  measure("drawPixel", 20000 * scale, 1, [&](uint32_t i) { _gfx.drawPixel((i * 7) % w, (i * 13) % h, color(i)); });
+  measure("drawFastHLine", 2000 * scale, w, [&](uint32_t i) { _gfx.drawFastHLine(0, i % h, w, color(i)); });
+  measure("drawFastVLine", 2000 * scale, h, [&](uint32_t i) { _gfx.drawFastVLine(i % w, 0, h, color(i)); });
+  measure("fillRect 8x8", 5000 * scale, 8 * 8, [&](uint32_t i) { _gfx.fillRect((i * 8) % (w - 8), (i * 24) % (h - 8), 8, 8, color(i)); });
+  measure("fillRect 32x32", 1000 * scale, 32 * 32, [&](uint32_t i) { _gfx.fillRect((i * 32) % (w - 32), (i * 96) % (h - 32), 32, 32, color(i)); });
+  measure("fillRect 100x100", 200 * scale, 100 * 100, [&](uint32_t i) { _gfx.fillRect((i * 50) % (w - 100), (i * 30) % (h - 100), 100, 100, color(i)); });
+  measure("fillScreen", 20 * scale, w * h, [&](uint32_t i) { _gfx.fillScreen(color(i)); });
+  measure("drawLine", 2000 * scale, max(w, h), [&](uint32_t i) { _gfx.drawLine(0, i % h, w - 1, h - 1 - i % h, color(i)); });
+  measure("fillCircle r20", 1000 * scale, 1257, [&](uint32_t i) { _gfx.fillCircle(20 + (i * 17) % (w - 40), 20 + (i * 11) % (h - 40), 20, color(i)); });
+  measure("fillTriangle", 1000 * scale, 50 * 50 / 2, [&](uint32_t i) { int x = (i * 17) % (w - 50), y = (i * 11) % (h - 50); _gfx.fillTriangle(x, y, x + 50, y, x, y + 50, color(i)); });
+
+  static const char *fontNames[] = {"", "text font 1", "text font 2", "", "text font 4", "", "", "text font 7"};
+  for (int font : {1, 2, 4, 7})
+  {
+    _gfx.setTextFont(font);
+    _gfx.setTextColor((uint16_t)0xFFFF, (uint16_t)0);
+    uint32_t pixels = _gfx.textWidth("0123456789") * _gfx.fontHeight();
+    measure(fontNames[font], 200 * scale, pixels, [&](uint32_t i) { _gfx.drawString("0123456789", (i * 7) % (w / 2), (i * 29) % (h - _gfx.fontHeight())); });
+  }
+
+  if (image != nullptr)
+  {
+    for (int i = 0; i < IMG * IMG; i++) image[i] = color(i);
+    measure("pushImage 64x64", 500 * scale, IMG * IMG, [&](uint32_t i) { _gfx.pushImage((i * IMG) % (w - IMG), (i * 3 * IMG) % (h - IMG), IMG, IMG, image); });
+    measure("pushImageDMA 64x64", 500 * scale, IMG * IMG, [&](uint32_t i) 
+    { 
+      _gfx.pushImageDMA((i * IMG) % (w - IMG), (i * 3 * IMG) % (h - IMG), IMG, IMG, image); 
+    });
+    measure("readRect 64x64", 200 * scale, IMG * IMG, [&](uint32_t i) { _gfx.readRect((i * IMG) % (w - IMG), (i * 3 * IMG) % (h - IMG), IMG, IMG, image); });
+    free(image);
+  }
+  return _nbrResults;
+}
+
+/**
+ * Show the results as a table, one line per test
+*/
+template <class GFX>
+void Benchmark<GFX>::showResults()
+{
+  char s[64];
+
+  _gfx.fillScreen(0);
+  _gfx.setTextFont(1);
+  _gfx.setTextColor((uint16_t)0xFFE0, (uint16_t)0);
+  _gfx.drawString("test                    ops/s    MB/s", 2, 2);
+  _gfx.setTextColor((uint16_t)0xFFFF, (uint16_t)0);
+  for (int i = 0; i < _nbrResults; i++)
+  {
+    const BenchResult &r = _results[i];
+    snprintf(s, sizeof(s), "%-20s %9.0f %7.2f", r.name, r.opsPerSec, r.mbPerSec);
+    _gfx.drawString(s, 2, 14 + i * (_gfx.fontHeight() + 2));
+  }
+}
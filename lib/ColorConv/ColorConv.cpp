@@ -0,0 +1,151 @@
+/**
+ * Module       ColorConv
+ * 
+ * Purpose      Converts HSV to RGB with integer math only. The float version 
+ *              HSVtoRGB() needs a division, floor() and a switch per color.
+ *              - The hue is a fixed point number: the upper bits are the 
+ *                sector 0 .. 5, the lower 8 bits the fraction f.
+ *              - With p = v * (1 - s) one channel is v, one is p and one 
+ *                ramps up (p + x) or down (v - x) with x = v * s * f.
+ *              - The batch function prepares a plan per sector, which tells
+ *                which channel ramps in which direction and holds the two 
+ *                constant channels already packed into rgb565. 
+ *              - Two fractions are packed into the 16 bit halves of one 
+ *                word, so one 32 bit multiplication computes x for two 
+ *                pixels (v * s / 255 * f < 2^16).
+ *              - The ordered dither adds the threshold of a 4 x 4 Bayer matrix
+ *                before the channels are truncated to 5 / 6 / 5 bits, which 
+ *                turns the bands of a gradient into a fine pattern. The three
+ *                channels are spread to 10 bit lanes of one word, so adding
+ *                the thresholds and saturating at 255 are one operation each
+ *                for all channels. The thresholds of a row are a table of 4 
+ *                such words.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The rgb565 results differ from the float version by at most
+ *              1 LSB per channel.
+ * References   https://en.wikipedia.org/wiki/HSL_and_HSV#HSV_to_RGB
+ *              https://en.wikipedia.org/wiki/SWAR
+ *              https://en.wikipedia.org/wiki/Ordered_dithering
+ */
+#include "ColorConv.h"
+
+static inline uint32_t div255(uint32_t x) { return (x + 1 + (x >> 8)) >> 8; }
+
+static inline uint16_t pack565(uint32_t r, uint32_t g, uint32_t b) 
+{ 
+  return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3); 
+}
+
+/**
+ * Returns the color as 0x00RRGGBB
+*/
+uint32_t hsvToRgb888(uint16_t hue, uint8_t s, uint8_t v)
+{
+  if (hue >= HUE_MAX) hue %= HUE_MAX;
+  uint32_t vs = div255(v * s);
+  uint32_t p  = v - vs;
+  uint32_t x  = (vs * (hue & 0xFF)) >> 8;
+  uint32_t t  = p + x;    // rising
+  uint32_t q  = v - x;    // falling
+
+  switch (hue >> 8)
+  {
+    case 0:  return (v << 16) | (t << 8) | p;
+    case 1:  return (q << 16) | (v << 8) | p;
+    case 2:  return (p << 16) | (v << 8) | t;
+    case 3:  return (p << 16) | (q << 8) | v;
+    case 4:  return (t << 16) | (p << 8) | v;
+    default: return (v << 16) | (p << 8) | q;
+  }
+}
+
+uint16_t hsvToRgb565(uint16_t hue, uint8_t s, uint8_t v)
+{
+  uint32_t rgb = hsvToRgb888(hue, s, v);
+  return pack565(rgb >> 16, (rgb >> 8) & 0xFF, rgb & 0xFF);
+}
+
+/**
+ * Convert n hues with the same saturation and value
+*/
+void hsvToRgb565(const uint16_t *hues, uint16_t *colors, int n, uint8_t s, uint8_t v, bool byteSwapped)
+{
+  struct SectorPlan 
+  { 
+    uint16_t base;    // the constant channels as rgb565
+    int16_t  start;   // value of the ramping channel at f = 0
+    int16_t  sign;    // +1 rising, -1 falling
+    uint8_t  drop;    // 3 for red and blue, 2 for green
+    uint8_t  shift;   // position of the ramping channel
+  };
+  const int16_t vs = div255(v * s);
+  const int16_t p  = v - vs;
+  const SectorPlan plans[6] =
+  {
+    {pack565(v, 0, p), p,  1, 2,  5},   // g = t
+    {pack565(0, v, p), v, -1, 3, 11},   // r = q
+    {pack565(p, v, 0), p,  1, 3,  0},   // b = t
+    {pack565(p, 0, v), v, -1, 2,  5},   // g = q
+    {pack565(0, p, v), p,  1, 3, 11},   // r = t
+    {pack565(v, p, 0), v, -1, 3,  0},   // b = q
+  };
+
+  auto convert = [&](uint16_t hue, uint32_t x) -> uint16_t
+  {
+    const SectorPlan &plan = plans[hue >> 8];
+    uint16_t c = plan.base | ((uint32_t)(plan.start + plan.sign * (int32_t)x) >> plan.drop) << plan.shift;
+    return byteSwapped ? (c >> 8) | (c << 8) : c;
+  };
+
+  int i = 0;
+  for ( ; i + 1 < n; i += 2)
+  {
+    uint16_t h0 = hues[i]     < HUE_MAX ? hues[i]     : hues[i]     % HUE_MAX;
+    uint16_t h1 = hues[i + 1] < HUE_MAX ? hues[i + 1] : hues[i + 1] % HUE_MAX;
+    uint32_t x2 = ((h0 & 0xFF) | (uint32_t)(h1 & 0xFF) << 16) * (uint32_t)vs;
+    colors[i]     = convert(h0, (x2 >> 8) & 0xFF);
+    colors[i + 1] = convert(h1, x2 >> 24);
+  }
+  if (i < n)
+  {
+    uint16_t h = hues[i] % HUE_MAX;
+    colors[i] = convert(h, ((h & 0xFF) * vs) >> 8);
+  }
+}
+
+/**
+ * Bayer thresholds spread to the lanes r << 20 | g << 10 | b, 
+ * 0 .. 7 for the 5 bit channels and 0 .. 3 for green
+*/
+static constexpr uint8_t BAYER[4][4] = 
+{
+  { 0,  8,  2, 10},
+  {12,  4, 14,  6},
+  { 3, 11,  1,  9},
+  {15,  7, 13,  5},
+};
+
+static constexpr uint32_t lanes(uint32_t m) { return (m >> 1) << 20 | (m >> 2) << 10 | (m >> 1); }
+
+static constexpr uint32_t DITHER[4][4] =
+{
+  {lanes(BAYER[0][0]), lanes(BAYER[0][1]), lanes(BAYER[0][2]), lanes(BAYER[0][3])},
+  {lanes(BAYER[1][0]), lanes(BAYER[1][1]), lanes(BAYER[1][2]), lanes(BAYER[1][3])},
+  {lanes(BAYER[2][0]), lanes(BAYER[2][1]), lanes(BAYER[2][2]), lanes(BAYER[2][3])},
+  {lanes(BAYER[3][0]), lanes(BAYER[3][1]), lanes(BAYER[3][2]), lanes(BAYER[3][3])},
+};
+
+void ditherToRgb565(const uint32_t *rgb888, uint16_t *colors, int n, int y, bool byteSwapped)
+{
+  const uint32_t *thresholds = DITHER[y & 3];
+
+  for (int i = 0; i < n; i++)
+  {
+    uint32_t c = rgb888[i];
+    uint32_t sum = ((c & 0xFF0000) << 4 | (c & 0xFF00) << 2 | (c & 0xFF)) + thresholds[i & 3];
+    sum |= ((sum >> 8) & 0x00100401) * 0xFF;     // saturate the lanes above 255
+    uint16_t c565 = ((sum >> 23) & 0x1F) << 11 | ((sum >> 12) & 0x3F) << 5 | ((sum >> 3) & 0x1F);
+    colors[i] = byteSwapped ? (c565 >> 8) | (c565 << 8) : c565;
+  }
+}
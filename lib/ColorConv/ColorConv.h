@@ -0,0 +1,25 @@
+/**
+ * ColorConv.h
+ * 
+ * Integer color conversions. The hue is given in HUE_MAX steps per turn,
+ * 256 steps per 60° sector, saturation and value in 0 .. 255. The batch
+ * function converts an array of hues with the same saturation and value
+ * into rgb565, optionally byte swapped for pushImage() line buffers.
+ * ditherToRgb565() reduces a row of 0x00RRGGBB colors to rgb565 with a
+ * 4 x 4 ordered dither, y is the row on the display.
+ */ 
+#pragma once
+#include <Arduino.h>
+
+constexpr uint16_t HUE_MAX = 6 * 256;
+
+inline uint16_t hueFromDegrees(float degrees) 
+{ 
+  int32_t hue = (int32_t)(degrees * (HUE_MAX / 360.0f)) % HUE_MAX;
+  return hue < 0 ? hue + HUE_MAX : hue; 
+}
+
+uint32_t hsvToRgb888(uint16_t hue, uint8_t s, uint8_t v);
+uint16_t hsvToRgb565(uint16_t hue, uint8_t s, uint8_t v);
+void hsvToRgb565(const uint16_t *hues, uint16_t *colors, int n, uint8_t s, uint8_t v, bool byteSwapped = false);
+void ditherToRgb565(const uint32_t *rgb888, uint16_t *colors, int n, int y, bool byteSwapped = false);
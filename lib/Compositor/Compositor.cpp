@@ -0,0 +1,363 @@
+/**
+ * Class        Compositor
+ *
+ * Purpose      Implements a class Compositor which sends only the changed parts
+ *              of a screen to the panel. The UI code keeps drawing its complete
+ *              screen, but into the compositor instead of the panel:
+ *              - Each drawing call is recorded with its bounding box, the text
+ *                of drawString() is copied.
+ *              - flush() compares the recorded calls one by one with those of
+ *                the previous flush. The bounding boxes of changed, added and
+ *                removed calls are the damage.
+ *              - Overlapping or adjacent damage rectangles are merged until no
+ *                two of them touch.
+ *              - Each merged region is rendered from all recorded calls that
+ *                intersect it into a strip sprite and pushed by DMA, with two
+ *                strips alternating. Every pixel of a region is sent once.
+ *              Without the memory for the lists, the calls are drawn directly.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The screen must be described completely by the calls since the
+ *              last flush, e.g. starting with fillScreen(). After other code has
+ *              drawn on the panel, invalidate() forces a full flush. Text is
+ *              drawn with top left datum. The overlay outlines are drawn on the
+ *              panel and erased by the next flush.
+ * References   https://github.com/lovyan03/LovyanGFX
+ */
+#include "Compositor.h"
+
+static constexpr uint16_t OVERLAY_COLOR = TFT_MAGENTA;
+
+bool Compositor::_showOverlay = false;
+
+bool Compositor::begin(uint16_t maxOps)
+{
+  end();
+  _stripWidth = max(_lcd.width(), _lcd.height());
+  for (int i = 0; i < 2; i++)
+  {
+    _ops[i]  = (CompositorOp *)malloc(maxOps * sizeof(CompositorOp));
+    _text[i] = (char *)malloc(TEXT_POOL);
+    _stripBuffers[i] = (uint16_t *)heap_caps_malloc(STRIP_ROWS * _stripWidth * sizeof(uint16_t), MALLOC_CAP_DMA);
+  }
+  if (_ops[0] == nullptr || _ops[1] == nullptr || _text[0] == nullptr || _text[1] == nullptr ||
+      _stripBuffers[0] == nullptr || _stripBuffers[1] == nullptr)
+  {
+    log_e("Not enough memory for %u operations, drawing directly", maxOps);
+    end();
+    return false;
+  }
+  _maxOps = maxOps;
+  _nbrOps[0] = _nbrOps[1] = 0;
+  _textUsed[0] = _textUsed[1] = 0;
+  _nbrOverlayRects = 0;
+  _stats = {};
+  invalidate();
+  return true;
+}
+
+void Compositor::end()
+{
+  for (int i = 0; i < 2; i++)
+  {
+    free(_ops[i]);
+    free(_text[i]);
+    free(_stripBuffers[i]);
+    _ops[i] = nullptr;
+    _text[i] = nullptr;
+    _stripBuffers[i] = nullptr;
+  }
+  _maxOps = 0;
+}
+
+/**
+ * The panel content is unknown, the next flush sends the whole screen
+*/
+void Compositor::invalidate()
+{
+  _isInvalid = true;
+}
+
+/**
+ * Add an area drawn by other code to the damage of the next flush
+*/
+void Compositor::invalidate(int x, int y, int w, int h)
+{
+  if (w > 0 && h > 0) addDamage(x, y, x + w - 1, y + h - 1);
+}
+
+void Compositor::setTextFont(int font)
+{
+  _strip.setTextFont(font);
+  _font = _strip.getFont();
+}
+
+int Compositor::textWidth(const char *text)
+{
+  _strip.setFont(_font);
+  _strip.setTextSize(_textScale);
+  return _strip.textWidth(text);
+}
+
+int Compositor::fontHeight()
+{
+  _strip.setFont(_font);
+  _strip.setTextSize(_textScale);
+  return _strip.fontHeight();
+}
+
+void Compositor::fillScreen(uint16_t color)
+{
+  CompositorOp op = { CO_FILL_SCREEN };
+  op.color = color;
+  record(op, 0, 0, width() - 1, height() - 1);
+}
+
+void Compositor::fillRect(int x, int y, int w, int h, uint16_t color)
+{
+  CompositorOp op = { CO_FILL_RECT, false, color, 0, { (int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h } };
+  record(op, x, y, x + w - 1, y + h - 1);
+}
+
+void Compositor::drawRect(int x, int y, int w, int h, uint16_t color)
+{
+  CompositorOp op = { CO_RECT, false, color, 0, { (int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h } };
+  record(op, x, y, x + w - 1, y + h - 1);
+}
+
+void Compositor::drawLine(int x0, int y0, int x1, int y1, uint16_t color)
+{
+  CompositorOp op = { CO_LINE, false, color, 0, { (int16_t)x0, (int16_t)y0, (int16_t)x1, (int16_t)y1 } };
+  record(op, min(x0, x1), min(y0, y1), max(x0, x1), max(y0, y1));
+}
+
+void Compositor::drawCircle(int x, int y, int r, uint16_t color)
+{
+  CompositorOp op = { CO_CIRCLE, false, color, 0, { (int16_t)x, (int16_t)y, (int16_t)r } };
+  record(op, x - r, y - r, x + r, y + r);
+}
+
+void Compositor::fillCircle(int x, int y, int r, uint16_t color)
+{
+  CompositorOp op = { CO_FILL_CIRCLE, false, color, 0, { (int16_t)x, (int16_t)y, (int16_t)r } };
+  record(op, x - r, y - r, x + r, y + r);
+}
+
+void Compositor::drawArc(int x, int y, int r0, int r1, float angle0, float angle1, uint16_t color)
+{
+  CompositorOp op = { CO_ARC, false, color, 0, { (int16_t)x, (int16_t)y, (int16_t)r0, (int16_t)r1 }, { angle0, angle1 } };
+  int r = max(r0, r1);
+  record(op, x - r, y - r, x + r, y + r);
+}
+
+/**
+ * Record the text with the current font, size and colors,
+ * the text is copied to the text pool
+*/
+void Compositor::drawString(const char *text, int x, int y)
+{
+  CompositorOp op = { CO_TEXT, _hasTextBg, _textColor, _textBgColor, { (int16_t)x, (int16_t)y }, { _textScale } };
+  op.font = _font;
+  op.text = text;
+  record(op, x, y, x + textWidth(text) - 1, y + fontHeight() - 1);
+}
+
+/**
+ * Append the operation to the current list, or draw it
+ * on the panel if the compositor has no memory
+*/
+void Compositor::record(CompositorOp &op, int x0, int y0, int x1, int y1)
+{
+  op.x0 = x0; op.y0 = y0; op.x1 = x1; op.y1 = y1;
+  if (_maxOps == 0)
+  {
+    draw(_lcd, op, 0, 0);
+    return;
+  }
+  if (_nbrOps[_cur] >= _maxOps || (op.text != nullptr && _textUsed[_cur] + strlen(op.text) + 1 > TEXT_POOL))
+  {
+    if (! _hasOverflow) log_e("More than %u operations or %u characters, ignored", _maxOps, TEXT_POOL);
+    _hasOverflow = true;
+    return;
+  }
+  if (op.text != nullptr)
+  {
+    char *copy = _text[_cur] + _textUsed[_cur];
+    strcpy(copy, op.text);
+    _textUsed[_cur] += strlen(copy) + 1;
+    op.text = copy;
+  }
+  _ops[_cur][_nbrOps[_cur]++] = op;
+  _stats.ops++;
+  int w = min(x1, width() - 1) - max(x0, 0) + 1;
+  int h = min(y1, height() - 1) - max(y0, 0) + 1;
+  if (w > 0 && h > 0) _stats.pixelsDrawn += w * h;
+}
+
+bool Compositor::isEqual(const CompositorOp &a, const CompositorOp &b)
+{
+  if (a.type != b.type || a.color != b.color || a.x0 != b.x0 || a.y0 != b.y0 || a.x1 != b.x1 || a.y1 != b.y1) return false;
+  if (memcmp(a.a, b.a, sizeof(a.a)) != 0 || memcmp(a.f, b.f, sizeof(a.f)) != 0) return false;
+  if (a.type != CO_TEXT) return true;
+  return a.hasBg == b.hasBg && (! a.hasBg || a.bgColor == b.bgColor) && a.font == b.font && strcmp(a.text, b.text) == 0;
+}
+
+/**
+ * Add a rectangle to the damage, clipped to the screen. When all
+ * slots are used, it is merged into the rectangle which grows least.
+*/
+void Compositor::addDamage(int x0, int y0, int x1, int y1)
+{
+  x0 = max(x0, 0); y0 = max(y0, 0);
+  x1 = min(x1, width() - 1); y1 = min(y1, height() - 1);
+  if (x0 > x1 || y0 > y1) return;
+
+  if (_nbrRects < MAX_RECTS)
+  {
+    _rects[_nbrRects++] = { (int16_t)x0, (int16_t)y0, (int16_t)x1, (int16_t)y1 };
+    return;
+  }
+  int best = 0;
+  int32_t bestGrowth = INT32_MAX;
+  for (int i = 0; i < _nbrRects; i++)
+  {
+    DamageRect &r = _rects[i];
+    int32_t area  = (int32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+    int32_t merged = (int32_t)(max(x1, (int)r.x1) - min(x0, (int)r.x0) + 1) * (max(y1, (int)r.y1) - min(y0, (int)r.y0) + 1);
+    if (merged - area < bestGrowth) { bestGrowth = merged - area; best = i; }
+  }
+  DamageRect &r = _rects[best];
+  r = { (int16_t)min(x0, (int)r.x0), (int16_t)min(y0, (int)r.y0), (int16_t)max(x1, (int)r.x1), (int16_t)max(y1, (int)r.y1) };
+}
+
+/**
+ * Merge rectangles which overlap or touch, until no two of them do
+*/
+void Compositor::mergeRects()
+{
+  bool isMerged = true;
+  while (isMerged)
+  {
+    isMerged = false;
+    for (int i = 0; i < _nbrRects; i++)
+    {
+      for (int j = i + 1; j < _nbrRects; j++)
+      {
+        DamageRect &a = _rects[i];
+        DamageRect &b = _rects[j];
+        if (a.x0 <= b.x1 + 1 && b.x0 <= a.x1 + 1 && a.y0 <= b.y1 + 1 && b.y0 <= a.y1 + 1)
+        {
+          a = { min(a.x0, b.x0), min(a.y0, b.y0), max(a.x1, b.x1), max(a.y1, b.y1) };
+          b = _rects[--_nbrRects];
+          isMerged = true;
+          j--;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Render the region strip by strip from the operations which
+ * intersect the strip, and push each strip by DMA
+*/
+void Compositor::renderRegion(const DamageRect &r, int &buf)
+{
+  const CompositorOp *ops = _ops[_cur];
+  int w = r.x1 - r.x0 + 1;
+
+  for (int y0 = r.y0; y0 <= r.y1; y0 += STRIP_ROWS)
+  {
+    int y1 = min(y0 + STRIP_ROWS - 1, (int)r.y1);
+    _strip.setBuffer(_stripBuffers[buf], w, y1 - y0 + 1, lgfx::rgb565_2Byte);
+    for (int i = 0; i < _nbrOps[_cur]; i++)
+    {
+      const CompositorOp &op = ops[i];
+      if (op.x0 > r.x1 || op.x1 < r.x0 || op.y0 > y1 || op.y1 < y0) continue;
+      draw(_strip, op, -r.x0, -y0);
+    }
+    _lcd.pushImageDMA(r.x0, y0, w, y1 - y0 + 1, (lgfx::swap565_t *)_stripBuffers[buf]);
+    buf ^= 1;  // the DMA of the other strip has finished
+  }
+}
+
+/**
+ * Send the damage of the operations since the last flush to the panel
+*/
+void Compositor::flush()
+{
+  if (_maxOps == 0) return;   // everything is drawn already
+
+  uint32_t usStart = micros();
+  const CompositorOp *cur  = _ops[_cur];
+  const CompositorOp *prev = _ops[_cur ^ 1];
+  int nbrCur  = _nbrOps[_cur];
+  int nbrPrev = _nbrOps[_cur ^ 1];
+
+  if (_isInvalid || _hasOverflow)
+  {
+    _nbrRects = 0;
+    addDamage(0, 0, width() - 1, height() - 1);
+  }
+  else
+  {
+    for (int i = 0; i < max(nbrCur, nbrPrev); i++)
+    {
+      if (i >= nbrPrev)                      addDamage(cur[i]);
+      else if (i >= nbrCur)                  addDamage(prev[i]);
+      else if (! isEqual(cur[i], prev[i])) { addDamage(cur[i]); addDamage(prev[i]); }
+    }
+  }
+  for (int i = 0; i < _nbrOverlayRects; i++)  // erase the outlines of the last flush
+  {
+    const DamageRect &o = _overlayRects[i];
+    addDamage(o.x0, o.y0, o.x1, o.y1);
+  }
+  mergeRects();
+
+  int buf = 0;
+  _lcd.startWrite();
+  for (int i = 0; i < _nbrRects; i++)
+  {
+    renderRegion(_rects[i], buf);
+    _stats.pixelsFlushed += (_rects[i].x1 - _rects[i].x0 + 1) * (_rects[i].y1 - _rects[i].y0 + 1);
+  }
+  _lcd.waitDMA();
+  _nbrOverlayRects = 0;
+  if (_showOverlay)
+  {
+    for (int i = 0; i < _nbrRects; i++)
+    {
+      const DamageRect &r = _rects[i];
+      _lcd.drawRect(r.x0, r.y0, r.x1 - r.x0 + 1, r.y1 - r.y0 + 1, OVERLAY_COLOR);
+      _overlayRects[_nbrOverlayRects++] = r;
+    }
+  }
+  _lcd.endWrite();
+
+  _stats.frames++;
+  _stats.regions += _nbrRects;
+  _stats.usFlush += micros() - usStart;
+  _nbrRects    = 0;
+  _isInvalid   = false;
+  _hasOverflow = false;
+  _cur ^= 1;                   // the current list becomes the previous one
+  _nbrOps[_cur]   = 0;
+  _textUsed[_cur] = 0;
+}
+
+void Compositor::printStats(const char *name)
+{
+  const CompositorStats &s = _stats;
+  Serial.printf(R"(
+Compositor %s
+-------------------------
+frames         %8u
+operations     %8u
+regions        %8u
+pixels drawn   %8u
+pixels flushed %8u  (%.1f %% of drawn)
+flush time     %8u us per frame
+)", name, s.frames, s.ops, s.regions, s.pixelsDrawn, s.pixelsFlushed,
+    100.0f * s.pixelsFlushed / max(s.pixelsDrawn, (uint32_t)1), s.usFlush / max(s.frames, (uint32_t)1));
+}
@@ -0,0 +1,150 @@
+/**
+ * Compositor.h
+ *
+ * Declaration of the class Compositor, a damage tracking layer between
+ * the UI code and the panel. The UI draws its complete screen into the
+ * compositor, which records the drawing calls. flush() compares them
+ * with the calls of the previous flush, merges the bounding boxes of
+ * the changed calls into dirty regions and sends each region once to
+ * the panel, rendered in strips off-screen. A debug overlay outlines
+ * the flushed regions.
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+enum CompositorOpType : uint8_t
+{
+  CO_FILL_SCREEN, CO_FILL_RECT, CO_RECT, CO_LINE, CO_CIRCLE, CO_FILL_CIRCLE, CO_ARC, CO_TEXT
+};
+
+struct CompositorOp
+{
+  CompositorOpType   type;
+  bool               hasBg;           // text with background color
+  uint16_t           color;
+  uint16_t           bgColor;
+  int16_t            a[6];            // coordinates, sizes and radii
+  float              f[2];            // arc angles, text size
+  const lgfx::IFont *font;
+  const char         *text;           // copy in the text pool of the list
+  int16_t            x0, y0, x1, y1;  // bounding box, inclusive
+};
+
+struct DamageRect
+{
+  int16_t x0, y0, x1, y1;             // inclusive
+};
+
+struct CompositorStats
+{
+  uint32_t frames;
+  uint32_t ops;
+  uint32_t regions;
+  uint32_t pixelsDrawn;               // bounding boxes of all drawing calls
+  uint32_t pixelsFlushed;             // pixels sent to the panel
+  uint32_t usFlush;
+};
+
+class Compositor
+{
+  public:
+    static constexpr int MAX_RECTS  = 16;
+    static constexpr int STRIP_ROWS = 8;
+    static constexpr int TEXT_POOL  = 512;
+
+    Compositor(LGFX &lcd) : _lcd(lcd) {}
+    ~Compositor() { end(); }
+    bool begin(uint16_t maxOps);
+    void end();
+    void invalidate();
+    void invalidate(int x, int y, int w, int h);
+    void flush();
+
+    void fillScreen(uint16_t color);
+    void fillRect(int x, int y, int w, int h, uint16_t color);
+    void drawRect(int x, int y, int w, int h, uint16_t color);
+    void drawLine(int x0, int y0, int x1, int y1, uint16_t color);
+    void drawCircle(int x, int y, int r, uint16_t color);
+    void fillCircle(int x, int y, int r, uint16_t color);
+    void drawArc(int x, int y, int r0, int r1, float angle0, float angle1, uint16_t color);
+    void drawString(const char *text, int x, int y);
+
+    void setFont(const lgfx::IFont *font) { _font = font; }
+    void setTextFont(int font);
+    void setTextSize(float size)          { _textScale = size; }
+    void setTextColor(uint16_t color)     { _textColor = color; _hasTextBg = false; }
+    void setTextColor(uint16_t color, uint16_t bgColor) { _textColor = color; _textBgColor = bgColor; _hasTextBg = true; }
+    int  textWidth(const char *text);
+    int  fontHeight();
+    int  width()                          { return _lcd.width(); }
+    int  height()                         { return _lcd.height(); }
+
+    const CompositorStats &getStats()     { return _stats; }
+    void resetStats()                     { _stats = {}; }
+    void printStats(const char *name);
+    static void setOverlay(bool isOn)     { _showOverlay = isOn; }
+    static bool isOverlay()               { return _showOverlay; }
+
+  private:
+    LGFX             &_lcd;
+    lgfx::LGFX_Sprite _strip;            // renders a strip of a region, measures text
+    uint16_t        *_stripBuffers[2] = { nullptr, nullptr };
+    int              _stripWidth = 0;
+    CompositorOp    *_ops[2]  = { nullptr, nullptr };   // current and previous list
+    char            *_text[2] = { nullptr, nullptr };
+    uint16_t         _nbrOps[2] = { 0, 0 };
+    uint16_t         _textUsed[2] = { 0, 0 };
+    uint16_t         _maxOps = 0;
+    uint8_t          _cur = 0;
+    bool             _isInvalid = true;
+    bool             _hasOverflow = false;
+    const lgfx::IFont *_font = &fonts::Font0;
+    float            _textScale = 1.0f;
+    uint16_t         _textColor = 0xFFFF;
+    uint16_t         _textBgColor = 0;
+    bool             _hasTextBg = false;
+    DamageRect       _rects[MAX_RECTS];
+    int              _nbrRects = 0;
+    DamageRect       _overlayRects[MAX_RECTS];
+    int              _nbrOverlayRects = 0;
+    CompositorStats  _stats = {};
+    static bool      _showOverlay;
+
+    void record(CompositorOp &op, int x0, int y0, int x1, int y1);
+    void addDamage(int x0, int y0, int x1, int y1);
+    void addDamage(const CompositorOp &op) { addDamage(op.x0, op.y0, op.x1, op.y1); }
+    void mergeRects();
+    void renderRegion(const DamageRect &r, int &buf);
+    static bool isEqual(const CompositorOp &a, const CompositorOp &b);
+
+    template <class GFX>
+    static void draw(GFX &gfx, const CompositorOp &op, int dx, int dy);
+};
+
+/**
+ * Draw the operation shifted by dx, dy
+*/
+template <class GFX>
+void Compositor::draw(GFX &gfx, const CompositorOp &op, int dx, int dy)
+{
+  const int16_t *a = op.a;
+  switch (op.type)
+  {
+    case CO_FILL_SCREEN: gfx.fillScreen(op.color); break;
+    case CO_FILL_RECT:   gfx.fillRect(a[0] + dx, a[1] + dy, a[2], a[3], op.color); break;
+    case CO_RECT:        gfx.drawRect(a[0] + dx, a[1] + dy, a[2], a[3], op.color); break;
+    case CO_LINE:        gfx.drawLine(a[0] + dx, a[1] + dy, a[2] + dx, a[3] + dy, op.color); break;
+    case CO_CIRCLE:      gfx.drawCircle(a[0] + dx, a[1] + dy, a[2], op.color); break;
+    case CO_FILL_CIRCLE: gfx.fillCircle(a[0] + dx, a[1] + dy, a[2], op.color); break;
+    case CO_ARC:         gfx.drawArc(a[0] + dx, a[1] + dy, a[2], a[3], op.f[0], op.f[1], op.color); break;
+    case CO_TEXT:
+      gfx.setFont(op.font);
+      gfx.setTextSize(op.f[0]);
+      gfx.setTextDatum(lgfx::textdatum::TL_DATUM);
+      if (op.hasBg) gfx.setTextColor(op.color, op.bgColor);
+      else          gfx.setTextColor(op.color);
+      gfx.drawString(op.text, a[0] + dx, a[1] + dy);
+      break;
+  }
+}
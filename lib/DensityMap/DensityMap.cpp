@@ -0,0 +1,99 @@
+/**
+ * Class        DensityMap
+ * 
+ * Purpose      Implements a class DensityMap which counts how often each pixel
+ *              was hit by a chaos game or a random walk. Plotting solid pixels
+ *              saturates the image after a few thousand points, the counts show
+ *              the visit frequency instead.
+ *              - add() only increments a saturating 8 bit counter, the caller 
+ *                can run millions of points at full speed and flush() the map
+ *                a few times a second.
+ *              - flush() finds the maximum count and maps the counts through a
+ *                256 entry LUT with log(1 + n) / log(1 + max) to the palette. 
+ *                The strips are converted by a StripPipeline while the previous
+ *                one is pushed by DMA.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      Pixels that were never hit are black, the palette starts at the
+ *              color for a single hit.
+ * References   https://en.wikipedia.org/wiki/Tone_mapping
+ */
+#include "DensityMap.h"
+
+/**
+ * Allocate the counters for the current rotation of the 
+ * display. Returns false if there is not enough memory.
+*/
+bool DensityMap::begin(const Palette &palette)
+{
+  _palette = &palette;
+  _width   = _lcd.width();
+  _height  = _lcd.height();
+  _counts  = (uint8_t *)calloc(_width * _height, 1);
+  if (_counts == nullptr || ! _pipeline.begin(STRIP_ROWS, 2, false))
+  {
+    log_e("Not enough memory for the %u x %u density map", _width, _height);
+    end();
+    return false;
+  }
+  _maxCount = 0;
+  buildToneLUT();
+  return true;
+}
+
+void DensityMap::end()
+{
+  free(_counts);
+  _counts = nullptr;
+  _pipeline.end();
+}
+
+void DensityMap::clear()
+{
+  memset(_counts, 0, _width * _height);
+  _maxCount = 0;
+  buildToneLUT();
+}
+
+void DensityMap::buildToneLUT()
+{
+  float scale = (Palette::SIZE - 1) / logf(1.0f + max(_maxCount, (uint8_t)1));
+
+  _toneLUT[0] = 0;  // black
+  for (int n = 1; n < 256; n++)
+    _toneLUT[n] = _palette->swapped(min((int)(logf(1.0f + n) * scale), Palette::SIZE - 1));
+}
+
+/**
+ * Tone map all counters and push them to the display
+*/
+void DensityMap::flush()
+{
+  const uint32_t *words = (const uint32_t *)_counts;
+  uint32_t nbrWords = _width * _height / 4;
+  uint8_t maxCount = 0;
+
+  for (uint32_t i = 0; i < nbrWords && maxCount < 255; i++)
+  {
+    uint32_t w = words[i];
+    if (w == 0) continue;
+    maxCount = max(maxCount, (uint8_t)max(max(w & 0xFF, (w >> 8) & 0xFF), max((w >> 16) & 0xFF, w >> 24)));
+  }
+  if (maxCount != _maxCount)
+  {
+    _maxCount = maxCount;
+    buildToneLUT();
+  }
+
+  _pipeline.run(renderStrip, this);
+}
+
+/**
+ * StripRenderer of flush()
+*/
+void DensityMap::renderStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  DensityMap *d = (DensityMap *)context;
+  const uint8_t *counts = d->_counts + y0 * d->_width;
+  for (uint32_t j = 0; j < rows * d->_width; j++) strip[j] = d->_toneLUT[counts[j]];
+}
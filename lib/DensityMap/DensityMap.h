@@ -0,0 +1,42 @@
+/**
+ * DensityMap.h
+ * 
+ * Declaration of the class DensityMap, a hit counter per pixel for 
+ * chaos games and random walks. The counters saturate at 255, so the
+ * map of a 320 x 240 screen needs 76.8 kB and fits into DRAM. flush() 
+ * maps the counts on a log scale to the colors of a palette and pushes
+ * the whole screen. The constructor needs a reference to the LGFX object.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+#include "Palette.h"
+#include "StripPipeline.h"
+
+class DensityMap
+{
+  public:
+    DensityMap(LGFX &lcd) : _lcd(lcd), _pipeline(lcd) {}
+    bool begin(const Palette &palette);
+    void end();
+    void clear();
+    void flush();
+    void add(uint32_t x, uint32_t y) 
+    { 
+      if (x < _width && y < _height) { uint8_t &c = _counts[y * _width + x]; c += (c != 255); }
+    }
+    uint8_t getMaxCount() { return _maxCount; }
+
+  private:
+    static constexpr int STRIP_ROWS = 8;
+
+    LGFX     &_lcd;
+    const Palette *_palette = nullptr;
+    uint8_t  *_counts = nullptr;
+    StripPipeline _pipeline;           // strips of flush()
+    uint16_t _toneLUT[256];            // count --> byte swapped rgb565
+    uint32_t _width = 0, _height = 0;
+    uint8_t  _maxCount = 0;
+
+    void buildToneLUT();
+    static void renderStrip(void *context, uint16_t *strip, int y0, int rows);
+};
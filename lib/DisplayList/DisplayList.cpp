@@ -0,0 +1,96 @@
+/**
+ * Class        DisplayList
+ * 
+ * Purpose      Implements a class DisplayList which records a stream of drawing
+ *              primitives once and replays it any number of times. A record is
+ *              the opcode followed by its arguments, all int16_t, so a line 
+ *              needs 12 bytes.
+ *              - Horizontal and vertical lines are recorded as filled 
+ *                rectangles. A filled rectangle of the same color which 
+ *                continues the previous one in x or y is merged into it,
+ *                which saves the address window setups.
+ *              - replayUntil() keeps the SPI bus within startWrite() / endWrite()
+ *                for all primitives it draws instead of one transaction per 
+ *                primitive and measures the primitives per second.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The capacity is fixed by begin(), add() returns false and sets
+ *              the overflow flag when the list is full.
+ * References   https://en.wikipedia.org/wiki/Display_list
+ */
+#include "DisplayList.h"
+
+static constexpr int FILL_RECT_WORDS = 6;
+
+bool DisplayList::begin(uint32_t capacityWords)
+{
+  end();
+  _words = (int16_t *)malloc(capacityWords * sizeof(int16_t));
+  if (_words == nullptr)
+  {
+    log_e("Not enough memory for a display list of %u words", capacityWords);
+    return false;
+  }
+  _capacity = capacityWords;
+  clear();
+  return true;
+}
+
+void DisplayList::end()
+{
+  free(_words);
+  _words = nullptr;
+  _capacity = 0;
+  _size = 0;
+}
+
+void DisplayList::clear()
+{
+  rewind();
+  _size = 0;
+  _nbrPrimitives = 0;
+  _last = -1;
+  _hasOverflow = false;
+}
+
+bool DisplayList::add(DisplayOp op, std::initializer_list<int> args)
+{
+  if (_size + 1 + args.size() > _capacity)
+  {
+    _hasOverflow = true;
+    return false;
+  }
+  if (op != DL_FRAME)
+  {
+    _last = _size;
+    _nbrPrimitives++;
+  }
+  _words[_size++] = op;
+  for (int a : args) _words[_size++] = a;
+  return true;
+}
+
+bool DisplayList::line(int x0, int y0, int x1, int y1, uint16_t color)
+{
+  if (y0 == y1) return fillRect(min(x0, x1), y0, abs(x1 - x0) + 1, 1, color);
+  if (x0 == x1) return fillRect(x0, min(y0, y1), 1, abs(y1 - y0) + 1, color);
+  return add(DL_LINE, {x0, y0, x1, y1, color});
+}
+
+/**
+ * Merge the rectangle into the previous one if both have the same
+ * color and together form a rectangle
+*/
+bool DisplayList::fillRect(int x, int y, int w, int h, uint16_t color)
+{
+  if (_last >= 0 && _words[_last] == DL_FILL_RECT && _last + FILL_RECT_WORDS == (int32_t)_size)
+  {
+    int16_t *r = _words + _last + 1;   // x, y, w, h, color
+    if ((uint16_t)r[4] == color)
+    {
+      if (r[0] == x && r[2] == w && r[1] + r[3] == y) { r[3] += h; return true; }
+      if (r[1] == y && r[3] == h && r[0] + r[2] == x) { r[2] += w; return true; }
+    }
+  }
+  return add(DL_FILL_RECT, {x, y, w, h, color});
+}
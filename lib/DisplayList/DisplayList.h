@@ -0,0 +1,159 @@
+/**
+ * DisplayList.h
+ * 
+ * Declaration of the class DisplayList, which records drawing primitives
+ * as opcodes with packed int16_t coordinates and a rgb565 color, and 
+ * replays them. frame() marks the end of an animation step, replay() 
+ * calls the frame callback there. replayUntil() draws the frames up to
+ * a frame number, which lets a frame scheduler catch up after a late 
+ * frame. Replay is a template, so a list can be replayed on the LGFX
+ * panel, on an LGFX_Sprite or on any other class with the same drawing
+ * methods, e.g. a framebuffer on the host.
+ */ 
+#pragma once
+#include <Arduino.h>
+#include <initializer_list>
+
+using FrameCallback = void (*)();
+
+enum DisplayOp : int16_t 
+{ 
+  DL_LINE,           // x0, y0, x1, y1, color
+  DL_RECT,           // x, y, w, h, color
+  DL_FILL_RECT,      // x, y, w, h, color
+  DL_ROUND_RECT,     // x, y, w, h, r, color
+  DL_CIRCLE,         // x, y, r, color
+  DL_FILL_CIRCLE,    // x, y, r, color
+  DL_TRIANGLE,       // x0, y0, x1, y1, x2, y2, color
+  DL_FILL_TRIANGLE,  // x0, y0, x1, y1, x2, y2, color
+  DL_FILL_SCREEN,    // color
+  DL_FRAME,          // end of a frame
+};
+
+struct DisplayListStats
+{
+  uint32_t primitives;
+  uint32_t frames;
+  uint32_t usDraw;          // without the time spent in the frame callback
+  uint32_t primitivesPerSec;
+};
+
+class DisplayList
+{
+  public:
+    ~DisplayList() { end(); }
+    bool begin(uint32_t capacityWords);
+    void end();
+    void clear();
+
+    bool line(int x0, int y0, int x1, int y1, uint16_t color);
+    bool rect(int x, int y, int w, int h, uint16_t color)     { return add(DL_RECT, {x, y, w, h, color}); }
+    bool fillRect(int x, int y, int w, int h, uint16_t color);
+    bool roundRect(int x, int y, int w, int h, int r, uint16_t color) { return add(DL_ROUND_RECT, {x, y, w, h, r, color}); }
+    bool circle(int x, int y, int r, uint16_t color)          { return add(DL_CIRCLE, {x, y, r, color}); }
+    bool fillCircle(int x, int y, int r, uint16_t color)      { return add(DL_FILL_CIRCLE, {x, y, r, color}); }
+    bool triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color)     { return add(DL_TRIANGLE, {x0, y0, x1, y1, x2, y2, color}); }
+    bool fillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) { return add(DL_FILL_TRIANGLE, {x0, y0, x1, y1, x2, y2, color}); }
+    bool fillScreen(uint16_t color)                           { return add(DL_FILL_SCREEN, {color}); }
+    bool frame()                                              { _last = -1; return add(DL_FRAME, {}); }
+
+    uint32_t getSize() { return _size; }
+    uint32_t getNbrPrimitives() { return _nbrPrimitives; }
+    bool hasOverflow() { return _hasOverflow; }
+
+    template <class GFX>
+    const DisplayListStats &replay(GFX &gfx, FrameCallback onFrame = nullptr);
+    template <class GFX>
+    bool replayUntil(GFX &gfx, uint32_t frame);
+    void rewind() { _cursor = 0; _cursorFrame = 0; _stats = {}; }
+    const DisplayListStats &getStats() { return _stats; }
+
+  private:
+    int16_t  *_words = nullptr;
+    uint32_t _capacity = 0;
+    uint32_t _size = 0;
+    uint32_t _nbrPrimitives = 0;
+    int32_t  _last = -1;        // index of the last primitive, -1 after a frame
+    bool     _hasOverflow = false;
+    uint32_t _cursor = 0;       // next record of replayUntil()
+    uint32_t _cursorFrame = 0;  // frame of the next record
+    DisplayListStats _stats;
+
+    bool add(DisplayOp op, std::initializer_list<int> args);
+    template <class GFX>
+    static const int16_t *draw(GFX &gfx, const int16_t *p);
+};
+
+/**
+ * Draw the primitive at p and return the next record,
+ * nullptr for an invalid opcode
+*/
+template <class GFX>
+const int16_t *DisplayList::draw(GFX &gfx, const int16_t *p)
+{
+  switch (*p++)
+  {
+    case DL_LINE:          gfx.drawLine(p[0], p[1], p[2], p[3], (uint16_t)p[4]); return p + 5;
+    case DL_RECT:          gfx.drawRect(p[0], p[1], p[2], p[3], (uint16_t)p[4]); return p + 5;
+    case DL_FILL_RECT:     gfx.fillRect(p[0], p[1], p[2], p[3], (uint16_t)p[4]); return p + 5;
+    case DL_ROUND_RECT:    gfx.drawRoundRect(p[0], p[1], p[2], p[3], p[4], (uint16_t)p[5]); return p + 6;
+    case DL_CIRCLE:        gfx.drawCircle(p[0], p[1], p[2], (uint16_t)p[3]); return p + 4;
+    case DL_FILL_CIRCLE:   gfx.fillCircle(p[0], p[1], p[2], (uint16_t)p[3]); return p + 4;
+    case DL_TRIANGLE:      gfx.drawTriangle(p[0], p[1], p[2], p[3], p[4], p[5], (uint16_t)p[6]); return p + 7;
+    case DL_FILL_TRIANGLE: gfx.fillTriangle(p[0], p[1], p[2], p[3], p[4], p[5], (uint16_t)p[6]); return p + 7;
+    case DL_FILL_SCREEN:   gfx.fillScreen((uint16_t)p[0]); return p + 1;
+    default:
+      log_e("Invalid opcode %d", p[-1]);
+      return nullptr;
+  }
+}
+
+/**
+ * Draw the records from the cursor up to the end of the given frame,
+ * all within one startWrite() / endWrite(). Returns false at the end 
+ * of the list.
+*/
+template <class GFX>
+bool DisplayList::replayUntil(GFX &gfx, uint32_t frame)
+{
+  uint32_t usStart = micros();
+
+  gfx.startWrite();
+  while (_cursor < _size && _cursorFrame <= frame)
+  {
+    const int16_t *p = _words + _cursor;
+    if (*p == DL_FRAME)
+    {
+      _cursor++;
+      _cursorFrame++;
+      _stats.frames++;
+      continue;
+    }
+    const int16_t *next = draw(gfx, p);
+    _cursor = next != nullptr ? next - _words : _size;
+    if (next != nullptr) _stats.primitives++;
+  }
+  gfx.endWrite();
+  _stats.usDraw += micros() - usStart;
+  _stats.primitivesPerSec = (uint32_t)(1000000ULL * _stats.primitives / max(_stats.usDraw, (uint32_t)1));
+  return _cursor < _size;
+}
+
+/**
+ * Replay the whole list, the frame callback is called after 
+ * each frame, the last one included
+*/
+template <class GFX>
+const DisplayListStats &DisplayList::replay(GFX &gfx, FrameCallback onFrame)
+{
+  bool hasMore = true;
+
+  rewind();
+  for (uint32_t frame = 0; hasMore; frame++)
+  {
+    uint32_t cursor = _cursor;
+    hasMore = replayUntil(gfx, frame);
+    if (onFrame != nullptr && _cursor > cursor) onFrame();
+  }
+  return _stats;
+}
@@ -0,0 +1,337 @@
+/**
+ * Class        EscapeTime
+ * 
+ * Purpose      Implements a class EscapeTime which renders escape-time fractals
+ *              with the Mariani-Silver algorithm. Large parts of these images 
+ *              consist of areas with the same iteration count, in particular 
+ *              the inside of the set, where every pixel costs maxIteration.
+ *              The algorithm uses the fact that these areas are simply connected:
+ *              - Calculate the border of a rectangle.
+ *              - If all border pixels have the same iteration count, fill the 
+ *                interior with one fillRect() without calculating it.
+ *              - Otherwise split the rectangle along its longer side into two 
+ *                halves, calculate the dividing line and continue with both 
+ *                halves. The halves get the already calculated border parts 
+ *                passed, so no pixel is calculated twice.
+ *              - Rectangles below MAX_LEAF_AREA are calculated pixel by pixel.
+ *              The fractal is defined by an EscapeKernel, which makes it easy to
+ *              plug in Julia sets and other escape-time fractals.
+ *              renderBruteForce() calculates every pixel and pushes row by row,
+ *              both renders report iterations, calculated pixels and SPI bytes.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The SPI bytes are counted as pixel data plus ADDR_WINDOW_BYTES for
+ *              the commands that set the address window of each transfer.
+ * References   https://mrob.com/pub/muency/marianisilveralgorithm.html
+ */
+#include "EscapeTime.h"
+
+static constexpr int     MAX_LEAF_AREA     = 16 * 16;
+static constexpr int     ADDR_WINDOW_BYTES = 11;  // CASET + 4, RASET + 4, RAMWR
+static constexpr int64_t FOUR = 4LL << (2 * Mandelbrot::FRAC_BITS);  // 4.0 in Q56
+
+static inline uint16_t swapBytes(uint16_t c) { return (c >> 8) | (c << 8); }
+
+uint16_t IRAM_ATTR EscapeTime::mandelbrot(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration,
+                                          uint32_t &iterations)
+{
+  if (Mandelbrot::isInMainBulbs(re, im)) return maxIteration;
+  uint16_t n = Mandelbrot::iterate(re, im, maxIteration);
+  iterations += n;
+  return n;
+}
+
+/**
+ * z = z^2 + c with z0 = re + i*im and a constant c = cRe + i*cIm
+*/
+uint16_t IRAM_ATTR EscapeTime::julia(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration,
+                                          uint32_t &iterations)
+{
+  int32_t x = re, y = im;
+  for (uint16_t i = 0; i < maxIteration; i++)
+  {
+    int64_t x2 = (int64_t)x * x;
+    int64_t y2 = (int64_t)y * y;
+    if (x2 + y2 > FOUR)
+    {
+      iterations += i;
+      return i;
+    }
+    int32_t xy2 = (int32_t)(((int64_t)x * y) >> (Mandelbrot::FRAC_BITS - 1));
+    x = (int32_t)((x2 - y2) >> Mandelbrot::FRAC_BITS) + cRe;
+    y = xy2 + cIm;
+  }
+  iterations += maxIteration;
+  return maxIteration;
+}
+
+/**
+ * z = (|Re(z)| + i*|Im(z)|)^2 + c with z0 = 0 and c = re + i*im
+*/
+uint16_t IRAM_ATTR EscapeTime::burningShip(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration,
+                                          uint32_t &iterations)
+{
+  int32_t x = 0, y = 0;
+  for (uint16_t i = 0; i < maxIteration; i++)
+  {
+    int64_t x2 = (int64_t)x * x;
+    int64_t y2 = (int64_t)y * y;
+    if (x2 + y2 > FOUR)
+    {
+      iterations += i;
+      return i;
+    }
+    int32_t xy2 = (int32_t)(((int64_t)abs(x) * abs(y)) >> (Mandelbrot::FRAC_BITS - 1));
+    x = (int32_t)((x2 - y2) >> Mandelbrot::FRAC_BITS) + re;
+    y = xy2 + im;
+  }
+  iterations += maxIteration;
+  return maxIteration;
+}
+
+/**
+ * Set the fractal and its constant, e.g. c of a Julia set
+*/
+void EscapeTime::setKernel(EscapeKernel kernel, double cRe, double cIm)
+{
+  _kernel = kernel;
+  _cRe = Mandelbrot::toFixed(cRe);
+  _cIm = Mandelbrot::toFixed(cIm);
+}
+
+/**
+ * Set the displayed section of the complex plane
+*/
+void EscapeTime::setView(double reCenter, double imCenter, double reWidth, double imHeight)
+{
+  _reStep = Mandelbrot::toFixed(reWidth  / _lcd.width());
+  _imStep = Mandelbrot::toFixed(imHeight / _lcd.height());
+  _re0    = Mandelbrot::toFixed(reCenter) - _reStep * (_lcd.width()  / 2);
+  _im0    = Mandelbrot::toFixed(imCenter) - _imStep * (_lcd.height() / 2);
+}
+
+void EscapeTime::setMaxIteration(uint16_t maxIteration)
+{
+  _maxIteration = maxIteration;
+  buildColorLUT();
+}
+
+/**
+ * A point escaping after n < nbrColors iterations gets colors[n], 
+ * after more iterations the outsideColor. Points of the set get 
+ * the insideColor.
+*/
+void EscapeTime::setColors(const int *colors, int nbrColors, uint16_t outsideColor, uint16_t insideColor)
+{
+  _colors       = colors;
+  _nbrColors    = nbrColors;
+  _outsideColor = outsideColor;
+  _insideColor  = insideColor;
+  buildColorLUT();
+}
+
+/**
+ * Color the iteration count n with the palette entry n * stepsPerIteration.
+ * The subdivision compares iteration counts, therefore the coloring is not 
+ * smoothed here. Pass nullptr to use the colors of setColors() again.
+*/
+void EscapeTime::setPalette(const Palette *palette, uint16_t stepsPerIteration)
+{
+  _palette = palette;
+  _stepsPerIteration = stepsPerIteration;
+  buildColorLUT();
+}
+
+bool EscapeTime::buildColorLUT()
+{
+  free(_colorLUT);
+  _colorLUT = (uint16_t *)malloc((_maxIteration + 1) * sizeof(uint16_t));
+  if (_colorLUT == nullptr)
+  {
+    log_e("Not enough memory for %u colors", _maxIteration + 1);
+    return false;
+  }
+  for (int i = 0; i < _maxIteration; i++)
+  {
+    if (_palette != nullptr)
+      _colorLUT[i] = _palette->swapped(i * _stepsPerIteration);
+    else
+      _colorLUT[i] = swapBytes(i < _nbrColors ? _colors[i] : _outsideColor);
+  }
+  _colorLUT[_maxIteration] = swapBytes(_insideColor);
+  return true;
+}
+
+uint16_t IRAM_ATTR EscapeTime::count(int x, int y)
+{
+  uint16_t n = _kernel(_re0 + x * _reStep, _im0 + y * _imStep, _cRe, _cIm, _maxIteration, _stats.iterations);
+  _stats.pixels++;
+  return n;
+}
+
+/**
+ * Color the w x h iteration counts and push them to the panel
+*/
+void EscapeTime::drawCounts(int x, int y, int w, int h, const uint16_t *counts)
+{
+  for (int i = 0; i < w * h; i++) _line[i] = _colorLUT[counts[i]];
+  _lcd.pushImage(x, y, w, h, (lgfx::swap565_t *)_line);
+  _stats.spiBytes += ADDR_WINDOW_BYTES + 2 * w * h;
+}
+
+void EscapeTime::fill(int x, int y, int w, int h, uint16_t count)
+{
+  _lcd.fillRect(x, y, w, h, swapBytes(_colorLUT[count]));
+  _stats.spiBytes += ADDR_WINDOW_BYTES + 2 * w * h;
+}
+
+/**
+ * Calculate every pixel, one row after the other
+*/
+const EscapeStats &EscapeTime::renderBruteForce()
+{
+  int w = _lcd.width();
+  uint16_t *counts = (uint16_t *)malloc(w * sizeof(uint16_t));
+  uint32_t msStart = millis();
+
+  memset(&_stats, 0, sizeof(_stats));
+  _line = (uint16_t *)malloc(w * sizeof(uint16_t));
+  if (counts == nullptr || _line == nullptr || (_colorLUT == nullptr && ! buildColorLUT()))
+  {
+    log_e("Not enough memory to render");
+    free(_line);
+    free(counts);
+    _line = nullptr;
+    return _stats;
+  }
+  _lcd.startWrite();
+  for (int y = 0; y < _lcd.height(); y++)
+  {
+    for (int x = 0; x < w; x++) counts[x] = count(x, y);
+    drawCounts(0, y, w, 1, counts);
+  }
+  _lcd.endWrite();
+  free(_line);
+  free(counts);
+  _line = nullptr;
+  _stats.msRender = millis() - msStart;
+  log_i("Brute force: %u pixels, %u iterations, %u SPI bytes, %u ms", 
+        _stats.pixels, _stats.iterations, _stats.spiBytes, _stats.msRender);
+  return _stats;
+}
+
+/**
+ * Calculate the border of the screen and subdivide
+*/
+const EscapeStats &EscapeTime::renderSubdivided()
+{
+  int w = _lcd.width();
+  int h = _lcd.height();
+  uint16_t *top    = (uint16_t *)malloc(w * sizeof(uint16_t));
+  uint16_t *bottom = (uint16_t *)malloc(w * sizeof(uint16_t));
+  uint16_t *left   = (uint16_t *)malloc(h * sizeof(uint16_t));
+  uint16_t *right  = (uint16_t *)malloc(h * sizeof(uint16_t));
+  uint32_t msStart = millis();
+
+  memset(&_stats, 0, sizeof(_stats));
+  _line = (uint16_t *)malloc(max(max(w, h), MAX_LEAF_AREA) * sizeof(uint16_t));
+  if (top == nullptr || bottom == nullptr || left == nullptr || right == nullptr || _line == nullptr ||
+      (_colorLUT == nullptr && ! buildColorLUT()))
+  {
+    log_e("Not enough memory to render");
+    free(_line);
+    free(top); free(bottom); free(left); free(right);
+    _line = nullptr;
+    return _stats;
+  }
+  _lcd.startWrite();
+  for (int x = 0; x < w; x++)
+  {
+    top[x]    = count(x, 0);
+    bottom[x] = count(x, h - 1);
+  }
+  left[0]      = top[0];
+  left[h - 1]  = bottom[0];
+  right[0]     = top[w - 1];
+  right[h - 1] = bottom[w - 1];
+  for (int y = 1; y < h - 1; y++)
+  {
+    left[y]  = count(0, y);
+    right[y] = count(w - 1, y);
+  }
+  drawCounts(0, 0, w, 1, top);
+  drawCounts(0, h - 1, w, 1, bottom);
+  drawCounts(0, 1, 1, h - 2, left + 1);
+  drawCounts(w - 1, 1, 1, h - 2, right + 1);
+
+  if (! subdivide(0, 0, w, h, top, bottom, left, right)) log_e("Not enough memory to subdivide");
+  _lcd.endWrite();
+
+  free(_line);
+  free(top); free(bottom); free(left); free(right);
+  _line = nullptr;
+  _stats.msRender = millis() - msStart;
+  log_i("Mariani-Silver: %u pixels, %u iterations, %u SPI bytes, %u ms", 
+        _stats.pixels, _stats.iterations, _stats.spiBytes, _stats.msRender);
+  return _stats;
+}
+
+/**
+ * The border of the w x h rectangle at x, y is calculated and drawn. 
+ * top and bottom hold the w counts of the first and last row, left and 
+ * right the h counts of the first and last column, corners included.
+ * Returns false if a dividing line could not be allocated.
+*/
+bool EscapeTime::subdivide(int x, int y, int w, int h, const uint16_t *top, const uint16_t *bottom, const uint16_t *left, const uint16_t *right)
+{
+  if (w <= 2 || h <= 2) return true;  // no interior
+
+  uint16_t n = top[0];
+  bool isUniform = true;
+  for (int i = 0; i < w && isUniform; i++) isUniform = top[i] == n && bottom[i] == n;
+  for (int i = 0; i < h && isUniform; i++) isUniform = left[i] == n && right[i] == n;
+  if (isUniform)
+  {
+    fill(x + 1, y + 1, w - 2, h - 2, n);
+    return true;
+  }
+
+  if (w * h <= MAX_LEAF_AREA)
+  { // small, calculate all interior pixels
+    uint16_t counts[MAX_LEAF_AREA];
+    int i = 0;
+    for (int yi = y + 1; yi < y + h - 1; yi++)
+      for (int xi = x + 1; xi < x + w - 1; xi++) counts[i++] = count(xi, yi);
+    drawCounts(x + 1, y + 1, w - 2, h - 2, counts);
+    return true;
+  }
+
+  bool isOk;
+  if (w >= h)
+  { // split with a vertical line at x + m
+    int m = w / 2;
+    uint16_t *mid = (uint16_t *)malloc(h * sizeof(uint16_t));
+    if (mid == nullptr) return false;
+    mid[0]     = top[m];
+    mid[h - 1] = bottom[m];
+    for (int i = 1; i < h - 1; i++) mid[i] = count(x + m, y + i);
+    drawCounts(x + m, y + 1, 1, h - 2, mid + 1);
+    isOk = subdivide(x, y, m + 1, h, top, bottom, left, mid) &&
+           subdivide(x + m, y, w - m, h, top + m, bottom + m, mid, right);
+    free(mid);
+  }
+  else
+  { // split with a horizontal line at y + m
+    int m = h / 2;
+    uint16_t *mid = (uint16_t *)malloc(w * sizeof(uint16_t));
+    if (mid == nullptr) return false;
+    mid[0]     = left[m];
+    mid[w - 1] = right[m];
+    for (int i = 1; i < w - 1; i++) mid[i] = count(x + i, y + m);
+    drawCounts(x + 1, y + m, w - 2, 1, mid + 1);
+    isOk = subdivide(x, y, w, m + 1, top, mid, left, right) &&
+           subdivide(x, y + m, w, h - m, mid, bottom, left + m, right + m);
+    free(mid);
+  }
+  return isOk;
+}
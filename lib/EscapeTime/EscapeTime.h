@@ -0,0 +1,68 @@
+/**
+ * EscapeTime.h
+ * 
+ * Declaration of the class EscapeTime, a renderer for escape-time fractals 
+ * like the Mandelbrot set, Julia sets or the Burning Ship. The fractal is
+ * given by an EscapeKernel, which returns the iteration count of a pixel.
+ * The constructor needs a reference to the LGFX object.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+#include "Mandelbrot.h"
+
+// Iteration count for the point re + i*im of the complex plane. cRe, cIm 
+// is the constant of the fractal, e.g. c of a Julia set. All in Q3.28.
+// The iterations actually run are added to iterations, a point found in
+// the set by a shortcut costs none.
+using EscapeKernel = uint16_t (*)(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration,
+                                  uint32_t &iterations);
+
+struct EscapeStats
+{
+  uint32_t iterations;     // iterations run for all calculated pixels
+  uint32_t pixels;         // number of calculated pixels
+  uint32_t spiBytes;       // pixel data and address windows sent to the panel
+  uint32_t msRender;
+};
+
+class EscapeTime
+{
+  public:
+    EscapeTime(LGFX &lcd) : _lcd(lcd) {}
+    ~EscapeTime() { free(_colorLUT); }
+    void setKernel(EscapeKernel kernel, double cRe = 0.0, double cIm = 0.0);
+    void setView(double reCenter, double imCenter, double reWidth, double imHeight);
+    void setMaxIteration(uint16_t maxIteration);
+    void setColors(const int *colors, int nbrColors, uint16_t outsideColor, uint16_t insideColor);
+    void setPalette(const Palette *palette, uint16_t stepsPerIteration = 16);
+    const EscapeStats &renderBruteForce();
+    const EscapeStats &renderSubdivided();
+    const EscapeStats &getStats() { return _stats; }
+
+    static uint16_t mandelbrot(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration, uint32_t &iterations);
+    static uint16_t julia(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration, uint32_t &iterations);
+    static uint16_t burningShip(int32_t re, int32_t im, int32_t cRe, int32_t cIm, uint16_t maxIteration, uint32_t &iterations);
+
+  private:
+    LGFX &_lcd;
+    EscapeKernel _kernel = mandelbrot;
+    int32_t  _cRe = 0, _cIm = 0;
+    int32_t  _re0, _im0;                  // upper left corner
+    int32_t  _reStep, _imStep;            // size of a pixel
+    uint16_t _maxIteration = 1000;
+    const int *_colors = nullptr;
+    int      _nbrColors = 0;
+    uint16_t _outsideColor = TFT_WHITE;
+    uint16_t _insideColor  = TFT_BLACK;
+    const Palette *_palette = nullptr;
+    uint16_t _stepsPerIteration = 16;     // palette entries per iteration
+    uint16_t *_colorLUT = nullptr;        // iteration count --> rgb565
+    uint16_t *_line = nullptr;            // scratch buffer for a row, column or block
+    EscapeStats _stats;
+
+    bool buildColorLUT();
+    uint16_t count(int x, int y);
+    void drawCounts(int x, int y, int w, int h, const uint16_t *counts);
+    void fill(int x, int y, int w, int h, uint16_t count);
+    bool subdivide(int x, int y, int w, int h, const uint16_t *top, const uint16_t *bottom, const uint16_t *left, const uint16_t *right);
+};
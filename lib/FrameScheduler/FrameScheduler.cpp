@@ -0,0 +1,87 @@
+/**
+ * Class        FrameScheduler
+ * 
+ * Purpose      Implements a class FrameScheduler which paces an animation by 
+ *              frame deadlines instead of delay() calls.
+ *              - Frame n is due at start + n * period. A frame starts within
+ *                startWrite() and ends with the wait for the outstanding DMA
+ *                transfers, the time is split into render, transfer and idle.
+ *              - The time left until the next deadline is given to other 
+ *                tasks with vTaskDelay(), the last fraction of a tick is
+ *                spent waiting.
+ *              - A frame that finishes after one or more later deadlines
+ *                drops these frames: the next call gets the number of the 
+ *                frame that is due now.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      Animations that draw on top of the previous frames must draw
+ *              the dropped frames too, e.g. with DisplayList::replayUntil().
+ *              The frame done callback runs after the transfer of each frame,
+ *              its time counts against the deadline of the next frame.
+ * References   https://gameprogrammingpatterns.com/game-loop.html
+ */
+#include "FrameScheduler.h"
+
+FrameDoneCallback FrameScheduler::_frameDoneCb = nullptr;
+
+/**
+ * Render frames until the callback returns false or
+ * the abort callback returns true
+*/
+const FrameStats &FrameScheduler::run(RenderCallback render, AbortCallback isAborted)
+{
+  uint32_t usStart = micros();
+  uint32_t usDue = usStart;    // deadline of the current frame
+  uint32_t frame = 0;
+  bool     hasMore = true;
+
+  _stats = {};
+  while (hasMore)
+  {
+    uint32_t usFrame = micros();
+    _lcd.startWrite();
+    hasMore = render(frame);
+    uint32_t usRendered = micros();
+    _lcd.waitDMA();
+    _lcd.endWrite();
+    uint32_t usTransferred = micros();
+    _stats.usRender   += usRendered - usFrame;
+    _stats.usTransfer += usTransferred - usRendered;
+    _stats.frames++;
+    if (_frameDoneCb != nullptr) _frameDoneCb();
+    if (isAborted != nullptr && isAborted()) break;
+
+    usDue += _usPeriod;
+    frame++;
+    int32_t usLate = (int32_t)(micros() - usDue);
+    if (usLate >= 0)
+    { // skip the frames whose deadlines have passed
+      uint32_t missed = usLate / _usPeriod;
+      _stats.dropped += missed;
+      frame += missed;
+      usDue += missed * _usPeriod;
+      continue;
+    }
+    uint32_t usIdleStart = micros();
+    if (-usLate >= 1000) vTaskDelay(-usLate / 1000 / portTICK_PERIOD_MS);
+    while ((int32_t)(micros() - usDue) < 0) {}
+    _stats.usIdle += micros() - usIdleStart;
+  }
+  _stats.msRun = (micros() - usStart) / 1000;
+  _stats.fps = 1000.0f * _stats.frames / max(_stats.msRun, (uint32_t)1);
+  return _stats;
+}
+
+void FrameScheduler::printStats(const char *name)
+{
+  Serial.printf(R"(
+%s
+frames            %8u
+dropped frames    %8u
+fps               %8.1f  (target %.1f)
+render [ms]       %8u
+transfer [ms]     %8u
+idle [ms]         %8u
+)", name, _stats.frames, _stats.dropped, _stats.fps, 1000000.0f / _usPeriod, 
+    _stats.usRender / 1000, _stats.usTransfer / 1000, _stats.usIdle / 1000);
+}
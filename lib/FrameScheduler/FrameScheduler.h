@@ -0,0 +1,49 @@
+/**
+ * FrameScheduler.h
+ * 
+ * Declaration of the class FrameScheduler, which calls a render callback 
+ * at a target frame rate. The callback gets the number of the frame that
+ * is due, so an animation advances with the time and not with the speed
+ * of the SPI bus. The constructor needs a reference to the LGFX object.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+
+using AbortCallback = bool (*)();
+
+/**
+ * Renders the given frame, returns false after the last frame
+*/
+using RenderCallback = bool (*)(uint32_t frame);
+
+/**
+ * Called after every frame of every scheduler, e.g. to capture the screen
+*/
+using FrameDoneCallback = void (*)();
+
+struct FrameStats
+{
+  uint32_t frames;        // frames rendered
+  uint32_t dropped;       // frames skipped because a frame was late
+  uint32_t msRun;
+  uint32_t usRender;      // time in the render callback
+  uint32_t usTransfer;    // waiting for the DMA transfers after the callback
+  uint32_t usIdle;        // time given to other tasks
+  float    fps;
+};
+
+class FrameScheduler
+{
+  public:
+    FrameScheduler(LGFX &lcd, uint16_t fps = 30) : _lcd(lcd) { setTargetFps(fps); }
+    void setTargetFps(uint16_t fps) { _usPeriod = 1000000 / constrain(fps, (uint16_t)1, (uint16_t)1000); }
+    const FrameStats &run(RenderCallback render, AbortCallback isAborted = nullptr);
+    void printStats(const char *name);
+    static void setFrameDoneCb(FrameDoneCallback cb) { _frameDoneCb = cb; }
+
+  private:
+    static FrameDoneCallback _frameDoneCb;
+    LGFX       &_lcd;
+    uint32_t   _usPeriod;
+    FrameStats _stats;
+};
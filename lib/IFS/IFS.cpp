@@ -0,0 +1,213 @@
+/**
+ * Class        IFS
+ * 
+ * Purpose      Implements a class IFS which renders iterated function systems 
+ *              with the chaos game: starting from any point, one of the affine 
+ *              maps is chosen at random according to its probability and applied 
+ *              to the point, which is then plotted. 
+ *              - The maps are transformed once into screen coordinates and 
+ *                converted to Q16.16 fixed point, so a point costs two 32 x 32 
+ *                --> 64 bit products per coordinate and no float math.
+ *              - The bounding box of the attractor is found with a short float 
+ *                run in begin() and fitted to the screen, so a new IFS is just 
+ *                a table of maps.
+ *              - A xorshift32 generator replaces random(). The map is selected 
+ *                with the alias method in constant time, one random number 
+ *                gives column and threshold.
+ *              - Points are plotted into an IndexedFrame with a 4 bit color
+ *                index per pixel (38.4 kB at 320 x 240) instead of a drawPixel()
+ *                SPI transaction each. The changed rows are converted to rgb565 
+ *                and pushed in strips by DMA every MS_FLUSH ms.
+ *              - With a density palette the hits are counted per pixel in a 
+ *                DensityMap and tone mapped on a log scale, so millions of points
+ *                show the invariant measure instead of a saturated image.
+ *              The number of points per second is reported.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The color index of a pixel is the number of the map that 
+ *              plotted it last, plus 1. Index 0 is the black background.
+ * References   https://en.wikipedia.org/wiki/Iterated_function_system
+ *              https://www.keithschwarz.com/darts-dice-coins/ (alias method)
+ */
+#include "IFS.h"
+
+static constexpr int      FRAC_BITS     = 16;
+static constexpr uint32_t CHECK_POINTS  = 16384;  // points between checks of the flush time
+static constexpr uint32_t MS_FLUSH      = 250;
+static constexpr int      NBR_TRANSIENT = 20;     // first points are not on the attractor
+static constexpr int      NBR_BOUNDS    = 4000;   // points of the float run for the bounding box
+
+/**
+ * Prepare the maps for the current rotation of the display and 
+ * allocate the off-screen frame or the density map. Returns false 
+ * if there is not enough memory.
+*/
+bool IFS::begin(const AffineMap *maps, int nbrMaps, const Palette *densityPalette)
+{
+  _nbrMaps   = min(nbrMaps, MAX_MAPS);
+  _width     = _lcd.width();
+  _height    = _lcd.height();
+  _isDensity = densityPalette != nullptr;
+  if (_isDensity)
+  {
+    if (! _density.begin(*densityPalette)) return false;
+  }
+  else
+  {
+    if (! _frame.begin(4)) return false;
+    _frame.setColor(0, TFT_BLACK);
+    for (int i = 0; i < _nbrMaps; i++) _frame.setColor(i + 1, maps[i].color);
+  }
+
+  fitToScreen(maps, _nbrMaps);
+  buildAliasTable(maps, _nbrMaps);
+  _x = (_width / 2) << FRAC_BITS;
+  _y = (_height / 2) << FRAC_BITS;
+  _yDirtyMin = _height;
+  _yDirtyMax = -1;
+  _lcd.fillScreen(TFT_BLACK);
+  return true;
+}
+
+void IFS::end()
+{
+  if (_isDensity) _density.end();
+  else            _frame.end();
+}
+
+/**
+ * Run a float chaos game to find the bounding box of the attractor,
+ * then transform the maps with X = ox + s*x, Y = oy - s*y into 
+ * screen coordinates, keeping the aspect ratio
+*/
+void IFS::fitToScreen(const AffineMap *maps, int nbrMaps)
+{
+  float pSum = 0;
+  float x = 0, y = 0;
+  float xMin = 1e9, xMax = -1e9, yMin = 1e9, yMax = -1e9;
+  uint32_t rng = 0x9E3779B9;
+
+  for (int i = 0; i < nbrMaps; i++) pSum += maps[i].p;
+  for (int n = 0; n < NBR_BOUNDS; n++)
+  {
+    float r = (xorshift32(rng) >> 8) * (pSum / (1 << 24));
+    int k = 0;
+    while (k < nbrMaps - 1 && r >= maps[k].p) r -= maps[k++].p;
+    const AffineMap &m = maps[k];
+    float xt = m.a * x + m.b * y + m.e;
+    y = m.c * x + m.d * y + m.f;
+    x = xt;
+    if (n < NBR_TRANSIENT) continue;
+    xMin = min(xMin, x); xMax = max(xMax, x);
+    yMin = min(yMin, y); yMax = max(yMax, y);
+  }
+
+  float s  = 0.96f * min(_width / max(xMax - xMin, 1e-6f), _height / max(yMax - yMin, 1e-6f));
+  float ox = _width  / 2 - s * (xMin + xMax) / 2;
+  float oy = _height / 2 + s * (yMin + yMax) / 2;
+  for (int i = 0; i < nbrMaps; i++)
+  {
+    const AffineMap &m = maps[i];
+    _maps[i].a = lroundf( m.a * (1 << FRAC_BITS));
+    _maps[i].b = lroundf(-m.b * (1 << FRAC_BITS));
+    _maps[i].c = lroundf(-m.c * (1 << FRAC_BITS));
+    _maps[i].d = lroundf( m.d * (1 << FRAC_BITS));
+    _maps[i].e = lroundf((ox * (1 - m.a) + m.b * oy + s * m.e) * (1 << FRAC_BITS));
+    _maps[i].f = lroundf((oy * (1 - m.d) + m.c * ox - s * m.f) * (1 << FRAC_BITS));
+  }
+}
+
+/**
+ * Vose's alias method: column i is kept with probability _aliasProb[i],
+ * otherwise the map _alias[i] is taken
+*/
+void IFS::buildAliasTable(const AffineMap *maps, int nbrMaps)
+{
+  float scaled[MAX_MAPS];
+  uint8_t small[MAX_MAPS], large[MAX_MAPS];
+  int nSmall = 0, nLarge = 0;
+  float pSum = 0;
+
+  for (int i = 0; i < nbrMaps; i++) pSum += maps[i].p;
+  for (int i = 0; i < nbrMaps; i++)
+  {
+    scaled[i] = maps[i].p * nbrMaps / pSum;
+    if (scaled[i] < 1.0f) small[nSmall++] = i; else large[nLarge++] = i;
+  }
+  while (nSmall > 0 && nLarge > 0)
+  {
+    uint8_t s = small[--nSmall];
+    uint8_t l = large[--nLarge];
+    _aliasProb[s] = (uint32_t)(scaled[s] * 65536.0f);
+    _alias[s] = l;
+    scaled[l] -= 1.0f - scaled[s];
+    if (scaled[l] < 1.0f) small[nSmall++] = l; else large[nLarge++] = l;
+  }
+  while (nLarge > 0) { uint8_t l = large[--nLarge]; _aliasProb[l] = 65536; _alias[l] = l; }
+  while (nSmall > 0) { uint8_t s = small[--nSmall]; _aliasProb[s] = 65536; _alias[s] = s; }  // rounding leftovers
+}
+
+/**
+ * Plot nbrPoints points and flush the display every MS_FLUSH ms,
+ * the abort callback is polled then
+*/
+const IFSStats &IFS::run(uint32_t nbrPoints, AbortCallback isAborted)
+{
+  int32_t  x = _x, y = _y;
+  uint32_t rng = _rng;
+  uint32_t msStart = millis();
+  uint32_t n;
+
+  _msFlush = msStart;
+  for (n = 0; n < nbrPoints; n++)
+  {
+    uint32_t r = xorshift32(rng);
+    uint32_t col = ((r >> 16) * _nbrMaps) >> 16;
+    uint32_t k = (r & 0xFFFF) < _aliasProb[col] ? col : _alias[col];
+    const FixedMap &m = _maps[k];
+    int32_t xt = (int32_t)(((int64_t)m.a * x + (int64_t)m.b * y) >> FRAC_BITS) + m.e;
+    y = (int32_t)(((int64_t)m.c * x + (int64_t)m.d * y) >> FRAC_BITS) + m.f;
+    x = xt;
+
+    uint32_t px = x >> FRAC_BITS;
+    uint32_t py = y >> FRAC_BITS;
+    if (n < NBR_TRANSIENT) continue;
+    if (_isDensity) 
+    {
+      _density.add(px, py);
+    }
+    else if (px < (uint32_t)_width && py < (uint32_t)_height)
+    {
+      _frame.setIndex(px, py, k + 1);
+      _yDirtyMin = min(_yDirtyMin, (int)py);
+      _yDirtyMax = max(_yDirtyMax, (int)py);
+    }
+    if ((n & (CHECK_POINTS - 1)) == CHECK_POINTS - 1 && millis() - _msFlush >= MS_FLUSH)
+    {
+      flush();
+      if (isAborted != nullptr && isAborted()) { n++; break; }
+    }
+  }
+  flush();
+  _x = x; _y = y; _rng = rng;
+
+  _stats.points = n;
+  _stats.msRun  = millis() - msStart;
+  _stats.pointsPerSec = (uint32_t)(1000ULL * n / max(_stats.msRun, (uint32_t)1));
+  log_i("IFS: %u points in %u ms, %u points/s", _stats.points, _stats.msRun, _stats.pointsPerSec);
+  return _stats;
+}
+
+/**
+ * Convert the changed rows to rgb565 and push them in strips by DMA
+*/
+void IFS::flush()
+{
+  _msFlush = millis();
+  if (_isDensity) return _density.flush();
+  if (_yDirtyMax < _yDirtyMin) return;
+
+  _frame.push(_yDirtyMin, _yDirtyMax + 1 - _yDirtyMin);
+  _yDirtyMin = _height;
+  _yDirtyMax = -1;
+}
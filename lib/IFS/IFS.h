@@ -0,0 +1,62 @@
+/**
+ * IFS.h
+ * 
+ * Declaration of the class IFS, a renderer for iterated function systems
+ * like the Barnsley fern or the Sierpinsky triangle. An IFS is a table of
+ * weighted affine maps x' = a*x + b*y + e, y' = c*x + d*y + f, each with
+ * a probability p and a color. With a density palette the points are
+ * counted in a DensityMap instead, which shows how often each pixel is
+ * visited. The constructor needs a reference to the LGFX object.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+#include "DensityMap.h"
+#include "IndexedFrame.h"
+
+struct AffineMap
+{
+  float a, b, c, d, e, f;
+  float p;          // probability, need not be normalized
+  uint16_t color;   // rgb565
+};
+
+struct IFSStats
+{
+  uint32_t points;
+  uint32_t msRun;
+  uint32_t pointsPerSec;
+};
+
+class IFS
+{
+  public:
+    IFS(LGFX &lcd) : _lcd(lcd), _frame(lcd), _density(lcd) {}
+    bool begin(const AffineMap *maps, int nbrMaps, const Palette *densityPalette = nullptr);
+    const IFSStats &run(uint32_t nbrPoints, AbortCallback isAborted = nullptr);
+    void end();
+
+    static constexpr int MAX_MAPS = 15;
+    static uint32_t xorshift32(uint32_t &state) { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; }
+
+  private:
+    struct FixedMap { int32_t a, b, c, d, e, f; };  // Q16.16 in screen coordinates
+
+    LGFX     &_lcd;
+    FixedMap _maps[MAX_MAPS];
+    int      _nbrMaps = 0;
+    uint32_t _aliasProb[MAX_MAPS];       // Q16 probability to keep the column
+    uint8_t  _alias[MAX_MAPS];           // map taken otherwise
+    IndexedFrame _frame;                 // 4 bit color index per pixel
+    DensityMap _density;                 // used instead of _frame with a density palette
+    bool     _isDensity = false;
+    int      _width, _height;
+    int      _yDirtyMin, _yDirtyMax;     // rows changed since the last flush
+    uint32_t _msFlush;
+    int32_t  _x = 0, _y = 0;             // current point, Q16.16 screen coordinates
+    uint32_t _rng = 0x12345678;
+    IFSStats _stats;
+
+    void fitToScreen(const AffineMap *maps, int nbrMaps);
+    void buildAliasTable(const AffineMap *maps, int nbrMaps);
+    void flush();
+};
@@ -0,0 +1,595 @@
+/**
+ * Class        ChunkReader, ByteWriter, ByteBuffer, Rle565Encoder, Rle565Decoder,
+ *              QoiEncoder, QoiDecoder, ImageDecoder
+ *
+ * Purpose      Implements a run length code for rgb565 screens which can be
+ *              encoded while the screen is read strip by strip and decoded
+ *              directly into the DMA buffers of a StripPipeline, a streaming
+ *              encoder and decoder of QOI images and the header of BMP files:
+ *              - Runs of 3 to 130 equal pixels take 3 bytes, all other pixels
+ *                are collected into literals of up to 128 pixels with a one
+ *                byte header, so the worst case is 1 % larger than raw.
+ *              - The encoders collect their output in the ByteWriter and pass
+ *                it to the sink in blocks, e.g. a ByteBuffer or a file.
+ *              - The decoders keep their position between calls, decode() can
+ *                stop and resume anywhere, also within a run or a literal. A
+ *                streamed image is read by the ChunkReader in chunks of the
+ *                size of its buffer, so an image of any size needs only the
+ *                buffer and the state of the decoder.
+ *              - QOI chunks are expanded into runs of one color, a single pixel
+ *                is a run of length 1, so decode() converts each color to rgb565
+ *                only once.
+ *              - The QOI encoder compares the rgb565 values for runs, only a new
+ *                color is converted to rgb888 and looked up in the index.
+ *              - ImageDecoder tells the formats apart by their magic.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The pixels passed to add() and returned by decode() are byte
+ *              swapped rgb565 values as in the DMA buffers. A truncated stream
+ *              ends the decoding early, isCorrupt() tells a truncated run or
+ *              literal from the regular end of the stream. No input makes a
+ *              decoder write more than the n pixels requested, so the decoders
+ *              can be fed with arbitrary bytes, see src/native/runHeadless.cpp.
+ * References   https://en.wikipedia.org/wiki/PackBits
+ *              https://qoiformat.org/qoi-specification.pdf
+ */
+#include "ImageCodec.h"
+
+void ByteWriter::begin(ByteSink sink, void *context)
+{
+  _sink     = sink;
+  _context  = context;
+  _isOk     = true;
+  _outUsed  = 0;
+  _bytesOut = 0;
+}
+
+void ByteWriter::write(const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  while (len > 0)
+  {
+    size_t n = min(len, sizeof(_out) - _outUsed);
+    memcpy(_out + _outUsed, p, n);
+    _outUsed += n;
+    p   += n;
+    len -= n;
+    if (_outUsed == sizeof(_out)) flush();
+  }
+}
+
+/**
+ * Pass the collected bytes to the sink, after the first
+ * failure of the sink the output is dropped
+*/
+void ByteWriter::flush()
+{
+  if (_outUsed == 0) return;
+  if (_isOk) _isOk = _sink(_context, _out, _outUsed);
+  _bytesOut += _outUsed;
+  _outUsed = 0;
+}
+
+/**
+ * ByteSink appending to the buffer
+*/
+bool ByteBuffer::append(void *context, const uint8_t *data, size_t len)
+{
+  ByteBuffer *b = (ByteBuffer *)context;
+  if (b->_used + len > b->_size)
+  {
+    size_t size = b->_size + max(len, b->_growStep);
+    uint8_t *grown = size <= b->_limit ? (uint8_t *)realloc(b->_data, size) : nullptr;
+    if (grown == nullptr) return false;
+    b->_data = grown;
+    b->_size = size;
+  }
+  memcpy(b->_data + b->_used, data, len);
+  b->_used += len;
+  return true;
+}
+
+/**
+ * Hand the content over to the caller, shrunk to its size,
+ * the caller has to free() it. The buffer is empty afterwards.
+*/
+uint8_t *ByteBuffer::release()
+{
+  uint8_t *data = _data;
+  if (_used == 0)
+  {
+    free(_data);
+    data = nullptr;
+  }
+  else if (_used < _size)
+  {
+    uint8_t *shrunk = (uint8_t *)realloc(_data, _used);
+    if (shrunk != nullptr) data = shrunk;
+  }
+  _data = nullptr;
+  _used = _size = 0;
+  return data;
+}
+
+void ByteBuffer::swap(ByteBuffer &other)
+{
+  std::swap(_data, other._data);
+  std::swap(_used, other._used);
+  std::swap(_size, other._size);
+}
+
+void Rle565Encoder::begin(ByteSink sink, void *context)
+{
+  _out.begin(sink, context);
+  _runLength   = 0;
+  _nbrLiterals = 0;
+}
+
+/**
+ * Encode n pixels, returns false once the sink has failed
+*/
+bool Rle565Encoder::add(const uint16_t *pixels, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    uint16_t p = pixels[i];
+    if (_runLength > 0 && p == _runColor && _runLength < MAX_RUN)
+    {
+      _runLength++;
+    }
+    else
+    {
+      endRun();
+      _runColor  = p;
+      _runLength = 1;
+    }
+  }
+  return _out.isOk();
+}
+
+/**
+ * Write the pending run and literal, returns false if the sink has failed
+*/
+bool Rle565Encoder::finish()
+{
+  endRun();
+  flushLiterals();
+  _out.flush();
+  return _out.isOk();
+}
+
+/**
+ * Runs shorter than 3 pixels are cheaper as literals
+*/
+void Rle565Encoder::endRun()
+{
+  if (_runLength >= 3)
+  {
+    flushLiterals();
+    _out.writeByte(_runLength + RUN_BIAS);
+    _out.write(&_runColor, 2);
+  }
+  else
+  {
+    for (int i = 0; i < _runLength; i++)
+    {
+      _literals[_nbrLiterals++] = _runColor;
+      if (_nbrLiterals == MAX_LITERAL) flushLiterals();
+    }
+  }
+  _runLength = 0;
+}
+
+void Rle565Encoder::flushLiterals()
+{
+  if (_nbrLiterals == 0) return;
+  _out.writeByte(_nbrLiterals - 1);
+  _out.write(_literals, _nbrLiterals * sizeof(uint16_t));
+  _nbrLiterals = 0;
+}
+
+/**
+ * Read an image held in memory
+*/
+void ChunkReader::begin(const uint8_t *data, size_t len)
+{
+  _source  = nullptr;
+  _chunk   = _in = data;
+  _inEnd   = data + len;
+  _bytesIn = 0;
+}
+
+/**
+ * Read an image through source in chunks of bufferSize bytes
+*/
+void ChunkReader::begin(ByteSource source, void *context, uint8_t *buffer, size_t bufferSize)
+{
+  _source     = source;
+  _context    = context;
+  _buffer     = buffer;
+  _bufferSize = bufferSize;
+  _chunk = _in = _inEnd = buffer;
+  _bytesIn    = 0;
+}
+
+bool ChunkReader::refill()
+{
+  if (_source == nullptr) return false;
+  size_t n = _source(_context, _buffer, _bufferSize);
+  if (n == 0) return false;
+  _bytesIn += _inEnd - _chunk;
+  _chunk = _in = _buffer;
+  _inEnd = _buffer + n;
+  return true;
+}
+
+/**
+ * Read len bytes, returns false at the end of the stream
+*/
+bool ChunkReader::read(void *data, size_t len)
+{
+  uint8_t *p = (uint8_t *)data;
+  while (len > 0)
+  {
+    if (_in == _inEnd && ! refill()) return false;
+    size_t n = min(len, (size_t)(_inEnd - _in));
+    memcpy(p, _in, n);
+    _in += n;
+    p   += n;
+    len -= n;
+  }
+  return true;
+}
+
+void Rle565Decoder::begin(const ChunkReader &in)
+{
+  _in = in;
+  _runLeft = _literalsLeft = 0;
+  _isCorrupt = false;
+}
+
+/**
+ * Decode up to n pixels, returns the number of pixels decoded,
+ * which is less than n at the end of the stream
+*/
+uint32_t Rle565Decoder::decode(uint16_t *pixels, uint32_t n)
+{
+  uint32_t done = 0;
+
+  while (done < n)
+  {
+    if (_runLeft > 0)
+    {
+      uint32_t m = min(n - done, (uint32_t)_runLeft);
+      for (uint32_t i = 0; i < m; i++) pixels[done++] = _runColor;
+      _runLeft -= m;
+    }
+    else if (_literalsLeft > 0)
+    {
+      uint32_t m = min(n - done, (uint32_t)_literalsLeft);
+      if (! _in.read(pixels + done, m * sizeof(uint16_t)))
+      {
+        _isCorrupt = true;
+        break;
+      }
+      done += m;
+      _literalsLeft -= m;
+    }
+    else
+    {
+      uint8_t header;
+      if (! _in.readByte(header)) break;   // end of the stream
+      if (header < Rle565Encoder::MAX_LITERAL)
+      {
+        _literalsLeft = header + 1;
+      }
+      else if (_in.read(&_runColor, sizeof(_runColor)))
+      {
+        _runLeft = header - Rle565Encoder::RUN_BIAS;
+      }
+      else
+      {
+        _isCorrupt = true;
+        break;
+      }
+    }
+  }
+  return done;
+}
+
+static constexpr uint8_t QOI_OP_INDEX = 0x00;
+static constexpr uint8_t QOI_OP_DIFF  = 0x40;
+static constexpr uint8_t QOI_OP_LUMA  = 0x80;
+static constexpr uint8_t QOI_OP_RUN   = 0xC0;
+static constexpr uint8_t QOI_OP_RGB   = 0xFE;
+static constexpr uint8_t QOI_OP_RGBA  = 0xFF;
+
+static bool isSameColor(const void *a, const void *b) { return memcmp(a, b, 4) == 0; }
+static uint8_t qoiHash(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return (r * 3 + g * 5 + b * 7 + a * 11) % 64; }
+
+/**
+ * Start a QOI image, the header is written at once
+*/
+void QoiEncoder::begin(ByteSink sink, void *context, uint32_t width, uint32_t height)
+{
+  uint8_t h[14] = {'q', 'o', 'i', 'f',
+                   (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+                   (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+                   3, 0};
+  _out.begin(sink, context);
+  _out.write(h, sizeof(h));
+  _px = {0, 0, 0, 255};
+  memset(_index, 0, sizeof(_index));
+  _color = 0;
+  _runLength = 0;
+}
+
+/**
+ * Encode n byte swapped rgb565 pixels, returns false once the sink
+ * has failed. Equal rgb565 values are compared before the conversion.
+*/
+bool QoiEncoder::add(const uint16_t *pixels, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    uint16_t p = pixels[i];
+    if (p == _color)
+    {
+      if (++_runLength == 62)
+      {
+        _out.writeByte(QOI_OP_RUN | 61);
+        _runLength = 0;
+      }
+      continue;
+    }
+    if (_runLength > 0)
+    {
+      _out.writeByte(QOI_OP_RUN | (_runLength - 1));
+      _runLength = 0;
+    }
+    _color = p;
+    uint16_t c = (p >> 8) | (p << 8);
+    uint8_t r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    encode({(uint8_t)((r << 3) | (r >> 2)), (uint8_t)((g << 2) | (g >> 4)), (uint8_t)((b << 3) | (b >> 2)), 255});
+  }
+  return _out.isOk();
+}
+
+void QoiEncoder::encode(Rgba px)
+{
+  uint8_t h = qoiHash(px.r, px.g, px.b, px.a);
+  if (isSameColor(&_index[h], &px))
+  {
+    _out.writeByte(QOI_OP_INDEX | h);
+  }
+  else
+  {
+    _index[h] = px;
+    int8_t dr = px.r - _px.r;
+    int8_t dg = px.g - _px.g;
+    int8_t db = px.b - _px.b;
+    int8_t drg = dr - dg;
+    int8_t dbg = db - dg;
+    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+    {
+      _out.writeByte(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+    }
+    else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+    {
+      _out.writeByte(QOI_OP_LUMA | (dg + 32));
+      _out.writeByte(((drg + 8) << 4) | (dbg + 8));
+    }
+    else
+    {
+      uint8_t rgb[4] = {QOI_OP_RGB, px.r, px.g, px.b};
+      _out.write(rgb, sizeof(rgb));
+    }
+  }
+  _px = px;
+}
+
+/**
+ * Write the pending run and the end marker
+*/
+bool QoiEncoder::finish()
+{
+  static const uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  if (_runLength > 0) _out.writeByte(QOI_OP_RUN | (_runLength - 1));
+  _runLength = 0;
+  _out.write(END_MARKER, sizeof(END_MARKER));
+  _out.flush();
+  return _out.isOk();
+}
+
+void QoiDecoder::begin(const ChunkReader &in)
+{
+  _in = in;
+  _px = {0, 0, 0, 255};
+  memset(_index, 0, sizeof(_index));
+  _runLeft = 0;
+  _isCorrupt = false;
+}
+
+/**
+ * Decode up to n pixels, returns the number of pixels decoded, which
+ * is less than n if the stream ends before the last pixel
+*/
+uint32_t QoiDecoder::decode(uint16_t *pixels, uint32_t n)
+{
+  uint32_t done = 0;
+
+  while (done < n)
+  {
+    if (_runLeft > 0)
+    {
+      uint32_t m = min(n - done, (uint32_t)_runLeft);
+      for (uint32_t i = 0; i < m; i++) pixels[done++] = _color;
+      _runLeft -= m;
+      continue;
+    }
+
+    uint8_t b1, b2 = 0;
+    bool isOk = _in.readByte(b1);
+    _runLeft = 1;
+    if (! isOk)
+    {
+      _runLeft = 0;
+    }
+    else if (b1 == QOI_OP_RGB)
+    {
+      isOk = _in.read(&_px, 3);
+    }
+    else if (b1 == QOI_OP_RGBA)
+    {
+      isOk = _in.read(&_px, 4);
+    }
+    else if ((b1 & 0xC0) == QOI_OP_INDEX)
+    {
+      _px = _index[b1];
+    }
+    else if ((b1 & 0xC0) == QOI_OP_DIFF)
+    {
+      _px.r += ((b1 >> 4) & 0x03) - 2;
+      _px.g += ((b1 >> 2) & 0x03) - 2;
+      _px.b += ( b1       & 0x03) - 2;
+    }
+    else if ((b1 & 0xC0) == QOI_OP_LUMA)
+    {
+      isOk = _in.readByte(b2);
+      int dg = (b1 & 0x3F) - 32;
+      _px.r += dg - 8 + ((b2 >> 4) & 0x0F);
+      _px.g += dg;
+      _px.b += dg - 8 + (b2 & 0x0F);
+    }
+    else
+    {
+      _runLeft = (b1 & 0x3F) + 1;
+    }
+    if (! isOk)
+    {
+      _isCorrupt = true;
+      break;
+    }
+    _index[qoiHash(_px.r, _px.g, _px.b, _px.a)] = _px;
+    uint16_t c = ((_px.r & 0xF8) << 8) | ((_px.g & 0xFC) << 3) | (_px.b >> 3);
+    _color = (c >> 8) | (c << 8);
+  }
+  return done;
+}
+
+static constexpr char RLE565_MAGIC[4] = {'R', '5', '6', '5'};
+static constexpr char QOI_MAGIC[4]    = {'q', 'o', 'i', 'f'};
+static constexpr uint32_t MAX_IMAGE_SIDE = 16384;
+
+bool ImageDecoder::begin(const uint8_t *data, size_t len)
+{
+  _in.begin(data, len);
+  return readHeader();
+}
+
+bool ImageDecoder::begin(ByteSource source, void *context, uint8_t *buffer, size_t bufferSize)
+{
+  _in.begin(source, context, buffer, bufferSize);
+  return readHeader();
+}
+
+/**
+ * Read the magic and the size, returns false for an unknown
+ * format or a size of 0 or more than MAX_IMAGE_SIDE
+*/
+bool ImageDecoder::readHeader()
+{
+  uint8_t h[14];
+  uint32_t w = 0, hgt = 0;
+
+  _format = IMG_UNKNOWN;
+  _width = _height = 0;
+  if (! _in.read(h, 8)) return false;
+  if (memcmp(h, RLE565_MAGIC, 4) == 0)
+  {
+    w   = h[4] | (h[5] << 8);
+    hgt = h[6] | (h[7] << 8);
+    _format = IMG_RLE565;
+    _rle.begin(_in);
+  }
+  else if (memcmp(h, QOI_MAGIC, 4) == 0 && _in.read(h + 8, 6))
+  {
+    w   = ((uint32_t)h[4] << 24) | (h[5] << 16) | (h[6] << 8) | h[7];
+    hgt = ((uint32_t)h[8] << 24) | (h[9] << 16) | (h[10] << 8) | h[11];
+    _format = IMG_QOI;
+    _qoi.begin(_in);
+  }
+  if (w == 0 || hgt == 0 || w > MAX_IMAGE_SIDE || hgt > MAX_IMAGE_SIDE) _format = IMG_UNKNOWN;
+  if (_format == IMG_UNKNOWN) return false;
+  _width  = w;
+  _height = hgt;
+  return true;
+}
+
+/**
+ * Decode up to n pixels, rows follow each other without padding
+*/
+uint32_t ImageDecoder::decode(uint16_t *pixels, uint32_t n)
+{
+  switch (_format)
+  {
+    case IMG_RLE565: return _rle.decode(pixels, n);
+    case IMG_QOI:    return _qoi.decode(pixels, n);
+    default:         return 0;
+  }
+}
+
+/**
+ * Write the header of an RLE565 file, the encoded pixels follow
+*/
+bool writeRle565Header(ByteSink sink, void *context, uint16_t width, uint16_t height)
+{
+  uint8_t h[8];
+  memcpy(h, RLE565_MAGIC, 4);
+  h[4] = width & 0xFF;
+  h[5] = width >> 8;
+  h[6] = height & 0xFF;
+  h[7] = height >> 8;
+  return sink(context, h, sizeof(h));
+}
+
+/**
+ * Bytes of a BMP row with 16 bits per pixel, padded to 4 bytes
+*/
+uint32_t bmpRowSize(uint16_t width)
+{
+  return (width * 2 + 3) & ~3u;
+}
+
+static void putLE(uint8_t *p, uint32_t v, int len)
+{
+  for (int i = 0; i < len; i++, v >>= 8) p[i] = v & 0xFF;
+}
+
+/**
+ * Write the header of a top-down BMP with 16 bit rgb565 pixels
+ * (BI_BITFIELDS). Rows of little endian pixels follow, each
+ * padded to bmpRowSize() bytes.
+*/
+bool writeBmpHeader(ByteSink sink, void *context, uint16_t width, uint16_t height)
+{
+  static constexpr uint32_t HEADER_SIZE = 14 + 40 + 12;
+  uint32_t dataSize = bmpRowSize(width) * height;
+  uint8_t h[HEADER_SIZE] = {'B', 'M'};
+
+  putLE(h + 2,  HEADER_SIZE + dataSize, 4);
+  putLE(h + 10, HEADER_SIZE, 4);            // offset of the pixels
+  putLE(h + 14, 40, 4);                     // size of the info header
+  putLE(h + 18, width, 4);
+  putLE(h + 22, (uint32_t)-(int32_t)height, 4);   // negative: top-down
+  putLE(h + 26, 1, 2);                      // planes
+  putLE(h + 28, 16, 2);                     // bits per pixel
+  putLE(h + 30, 3, 4);                      // BI_BITFIELDS
+  putLE(h + 34, dataSize, 4);
+  putLE(h + 38, 2835, 4);                   // 72 dpi
+  putLE(h + 42, 2835, 4);
+  putLE(h + 54, 0xF800, 4);                 // red mask
+  putLE(h + 58, 0x07E0, 4);                 // green mask
+  putLE(h + 62, 0x001F, 4);                 // blue mask
+  return sink(context, h, sizeof(h));
+}
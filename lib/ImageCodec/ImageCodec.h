@@ -0,0 +1,216 @@
+/**
+ * ImageCodec.h
+ *
+ * Declaration of streaming encoders and decoders for screen images. RLE565
+ * is a PackBits run length code of rgb565 pixels: a header byte h < 128 is
+ * followed by h + 1 literal pixels, h >= 128 by one pixel repeated h - 125
+ * times. Pixels are stored big endian, the byte order of the panel, so a
+ * decoded strip can be pushed by DMA without conversion. An RLE565 file
+ * starts with the magic "R565" and the width and height as little endian
+ * 16 bit values. QOI files are decoded to rgb565, the alpha is ignored,
+ * and encoded from rgb565 with the low bits of each channel replicated.
+ * Encoders write through a ByteSink, decoders read from memory or through
+ * a ByteSource in chunks, so no image is ever held in full. ByteBuffer is
+ * a ByteSink which collects the output in a growing heap buffer.
+ */
+#pragma once
+#include <Arduino.h>
+
+using ByteSink   = bool (*)(void *context, const uint8_t *data, size_t len);
+using ByteSource = size_t (*)(void *context, uint8_t *data, size_t len);
+
+enum ImageFormat : uint8_t { IMG_UNKNOWN, IMG_RLE565, IMG_QOI };
+
+/**
+ * Output of the encoders, collects the bytes and passes
+ * them to the sink in blocks of up to 256 bytes
+*/
+class ByteWriter
+{
+  public:
+    void begin(ByteSink sink, void *context);
+    void write(const void *data, size_t len);
+    void writeByte(uint8_t b)
+    {
+      _out[_outUsed++] = b;
+      if (_outUsed == sizeof(_out)) flush();
+    }
+    void flush();
+    bool isOk() { return _isOk; }
+    uint32_t getBytesOut() { return _bytesOut + _outUsed; }
+
+  private:
+    ByteSink _sink = nullptr;
+    void     *_context = nullptr;
+    bool     _isOk = true;
+    uint8_t  _out[256];
+    uint16_t _outUsed = 0;
+    uint32_t _bytesOut = 0;              // passed to the sink
+};
+
+/**
+ * ByteSink which appends to a heap buffer growing in steps
+ * of growStep bytes, it fails once limit bytes are exceeded
+*/
+class ByteBuffer
+{
+  public:
+    ByteBuffer(size_t limit, size_t growStep = 8192) : _limit(limit), _growStep(growStep) {}
+    ~ByteBuffer() { free(_data); }
+    static bool append(void *context, const uint8_t *data, size_t len);
+    void clear() { _used = 0; }
+    uint8_t *release();
+    void swap(ByteBuffer &other);
+    const uint8_t *data() { return _data; }
+    size_t size() { return _used; }
+
+  private:
+    uint8_t *_data = nullptr;
+    size_t  _used = 0;
+    size_t  _size = 0;
+    size_t  _limit;
+    size_t  _growStep;
+};
+
+/**
+ * Input of the decoders, either an image in memory or a
+ * stream read through a ByteSource into a buffer
+*/
+class ChunkReader
+{
+  public:
+    void begin(const uint8_t *data, size_t len);
+    void begin(ByteSource source, void *context, uint8_t *buffer, size_t bufferSize);
+    bool read(void *data, size_t len);
+    bool readByte(uint8_t &b)
+    {
+      if (_in == _inEnd && ! refill()) return false;
+      b = *_in++;
+      return true;
+    }
+    uint32_t getBytesIn() { return _bytesIn + (_in - _chunk); }
+
+  private:
+    ByteSource    _source = nullptr;
+    void          *_context = nullptr;
+    uint8_t       *_buffer = nullptr;      // chunk of a streamed image
+    size_t        _bufferSize = 0;
+    const uint8_t *_chunk = nullptr;       // start of the current chunk
+    const uint8_t *_in = nullptr;          // unread bytes of the chunk
+    const uint8_t *_inEnd = nullptr;
+    uint32_t      _bytesIn = 0;            // of the previous chunks
+
+    bool refill();
+};
+
+class Rle565Encoder
+{
+  public:
+    static constexpr int MAX_LITERAL = 128;
+    static constexpr int MAX_RUN     = 130;
+    static constexpr int RUN_BIAS    = MAX_LITERAL - 3;   // header = run length + RUN_BIAS
+
+    void begin(ByteSink sink, void *context);
+    bool add(const uint16_t *pixels, uint32_t n);
+    bool finish();
+    uint32_t getBytesOut() { return _out.getBytesOut(); }
+
+  private:
+    ByteWriter _out;
+    uint16_t   _runColor = 0;
+    uint16_t   _runLength = 0;
+    uint16_t   _literals[MAX_LITERAL];
+    uint16_t   _nbrLiterals = 0;
+
+    void endRun();
+    void flushLiterals();
+};
+
+class Rle565Decoder
+{
+  public:
+    void begin(const uint8_t *data, size_t len) { _in.begin(data, len); begin(_in); }
+    void begin(ByteSource source, void *context, uint8_t *buffer, size_t bufferSize)
+    {
+      _in.begin(source, context, buffer, bufferSize);
+      begin(_in);
+    }
+    void begin(const ChunkReader &in);
+    uint32_t decode(uint16_t *pixels, uint32_t n);
+    bool isCorrupt() { return _isCorrupt; }
+
+  private:
+    ChunkReader _in;
+    uint16_t    _runColor = 0;
+    uint16_t    _runLeft = 0;              // pixels left of the current run
+    uint16_t    _literalsLeft = 0;         // pixels left of the current literal
+    bool        _isCorrupt = false;
+};
+
+class QoiEncoder
+{
+  public:
+    void begin(ByteSink sink, void *context, uint32_t width, uint32_t height);
+    bool add(const uint16_t *pixels, uint32_t n);
+    bool finish();
+    uint32_t getBytesOut() { return _out.getBytesOut(); }
+
+  private:
+    struct Rgba { uint8_t r, g, b, a; };
+
+    ByteWriter _out;
+    Rgba       _px;
+    Rgba       _index[64];
+    uint16_t   _color;                   // _px as swapped rgb565
+    uint8_t    _runLength = 0;
+
+    void encode(Rgba px);
+};
+
+class QoiDecoder
+{
+  public:
+    void begin(const ChunkReader &in);
+    uint32_t decode(uint16_t *pixels, uint32_t n);
+    bool isCorrupt() { return _isCorrupt; }
+
+  private:
+    struct Rgba { uint8_t r, g, b, a; };
+
+    ChunkReader _in;
+    Rgba        _px;
+    Rgba        _index[64];
+    uint16_t    _color;                    // _px as swapped rgb565
+    uint8_t     _runLeft = 0;
+    bool        _isCorrupt = false;
+};
+
+/**
+ * Reads the header of an RLE565 or QOI image and decodes
+ * its pixels row by row in the format of the panel
+*/
+class ImageDecoder
+{
+  public:
+    bool begin(const uint8_t *data, size_t len);
+    bool begin(ByteSource source, void *context, uint8_t *buffer, size_t bufferSize);
+    uint32_t decode(uint16_t *pixels, uint32_t n);
+    bool isCorrupt() { return _format == IMG_RLE565 ? _rle.isCorrupt() : _qoi.isCorrupt(); }
+    ImageFormat getFormat() { return _format; }
+    int width() { return _width; }
+    int height() { return _height; }
+
+  private:
+    ChunkReader   _in;
+    ImageFormat   _format = IMG_UNKNOWN;
+    int           _width = 0;
+    int           _height = 0;
+    Rle565Decoder _rle;
+    QoiDecoder    _qoi;
+
+    bool readHeader();
+};
+
+bool writeRle565Header(ByteSink sink, void *context, uint16_t width, uint16_t height);
+bool writeBmpHeader(ByteSink sink, void *context, uint16_t width, uint16_t height);
+uint32_t bmpRowSize(uint16_t width);
@@ -0,0 +1,119 @@
+/**
+ * Class        IndexedFrame
+ *
+ * Purpose      Implements a class IndexedFrame, which makes full screen double
+ *              buffering possible without a 150 kB rgb565 sprite. A 320 x 240
+ *              rgb565 frame does not fit into the largest free block of DRAM
+ *              once WiFi is running, a frame of palette indices does:
+ *              - The pixels are stored in a LovyanGFX palette sprite with 8 bit
+ *                (256 colors) or 4 bit (16 colors) per pixel, so all drawing
+ *                functions of LovyanGFX can be used off-screen.
+ *              - The colors are kept in a table of byte swapped rgb565 values.
+ *                push() converts the indices to rgb565 strip by strip with this
+ *                table, a StripPipeline converts the next strip while the DMA
+ *                sends the previous one. No rgb565 copy of the frame exists.
+ *              - Changing a color of the table and pushing again recolors the
+ *                whole screen without redrawing it.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      4 bit frames hold two pixels per byte, the left one in the high
+ *              nibble like LovyanGFX. The width of the display must be even,
+ *              so the rows of a 4 bit frame follow each other without padding.
+ *              The palette of the sprite is updated as well, so readPixel() of
+ *              the canvas returns the same colors as the panel.
+ * References   https://github.com/lovyan03/LovyanGFX/blob/master/examples/Sprite
+ */
+#include "IndexedFrame.h"
+
+/**
+ * Allocate a frame of the size of the display in the current rotation
+ * with 8 or 4 bits per pixel. All indices are 0, index 0 is black and
+ * the other colors are gray levels. Returns false if there is not
+ * enough memory.
+*/
+bool IndexedFrame::begin(uint8_t bitsPerPixel)
+{
+  end();
+  _bpp    = bitsPerPixel == 4 ? 4 : 8;
+  _width  = _lcd.width();
+  _height = _lcd.height();
+
+  _canvas.setPsram(false);
+  _canvas.setColorDepth(_bpp == 4 ? lgfx::palette_4bit : lgfx::palette_8bit);
+  if (_canvas.createSprite(_width, _height) == nullptr || ! _canvas.createPalette() ||
+      ! _pipeline.begin(STRIP_ROWS, 2, false))
+  {
+    log_e("Not enough memory for a %d x %d frame with %u bits per pixel", _width, _height, _bpp);
+    end();
+    return false;
+  }
+  _buffer = (uint8_t *)_canvas.getBuffer();
+  for (int i = 0; i < getNbrColors(); i++)
+  {
+    uint8_t v = i * 255 / (getNbrColors() - 1);
+    setColor(i, _lcd.color565(v, v, v));
+  }
+  _canvas.fillScreen(0);
+  return true;
+}
+
+void IndexedFrame::end()
+{
+  _canvas.deleteSprite();
+  _pipeline.end();
+  _buffer = nullptr;
+  _bpp = 0;
+}
+
+void IndexedFrame::setColor(uint8_t index, uint16_t rgb565)
+{
+  _colors[index] = (rgb565 >> 8) | (rgb565 << 8);
+  _canvas.setPaletteColor(index, (rgb565 >> 8) & 0xF8, (rgb565 >> 3) & 0xFC, (rgb565 << 3) & 0xF8);
+}
+
+/**
+ * Spread the colors of the palette over the indices
+ * first .. first + nbrColors - 1
+*/
+void IndexedFrame::setColors(const Palette &palette, uint8_t first, uint8_t nbrColors)
+{
+  for (int i = 0; i < nbrColors && first + i < getNbrColors(); i++)
+  {
+    setColor(first + i, palette.rgb565(i * Palette::SIZE / nbrColors));
+  }
+}
+
+/**
+ * Convert rows y0 .. y0 + rows - 1 to rgb565 and push them to the panel
+*/
+void IndexedFrame::push(int y0, int rows)
+{
+  if (_buffer == nullptr) return;
+  _pipeline.run(y0, rows, renderStrip, this);
+}
+
+/**
+ * StripRenderer of push(), one table lookup per pixel
+*/
+void IndexedFrame::renderStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  IndexedFrame *f = (IndexedFrame *)context;
+  const uint16_t *colors = f->_colors;
+  uint32_t n = rows * f->_width;
+
+  if (f->_bpp == 8)
+  {
+    const uint8_t *src = f->_buffer + y0 * f->_width;
+    for (uint32_t j = 0; j < n; j++) strip[j] = colors[src[j]];
+  }
+  else
+  {
+    const uint8_t *src = f->_buffer + y0 * f->_width / 2;
+    for (uint32_t j = 0; j < n / 2; j++)
+    {
+      uint8_t cell = src[j];
+      *strip++ = colors[cell >> 4];
+      *strip++ = colors[cell & 0x0F];
+    }
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ * IndexedFrame.h
+ *
+ * Declaration of the class IndexedFrame, an off-screen framebuffer of
+ * the size of the display with 8 or 4 bit palette indices per pixel
+ * (76.8 kB or 38.4 kB at 320 x 240 instead of 150 kB in rgb565). It is
+ * drawn with the LovyanGFX functions of canvas(), using palette indices
+ * as colors, and converted to rgb565 strip by strip when pushed.
+ * The constructor needs a reference to the LGFX object.
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+#include "Palette.h"
+#include "StripPipeline.h"
+
+class IndexedFrame
+{
+  public:
+    static constexpr int STRIP_ROWS = 8;
+
+    IndexedFrame(LGFX &lcd) : _lcd(lcd), _pipeline(lcd) {}
+    ~IndexedFrame() { end(); }
+    bool begin(uint8_t bitsPerPixel);
+    void end();
+    lgfx::LGFX_Sprite &canvas() { return _canvas; }
+    uint8_t getBitsPerPixel()   { return _bpp; }
+    int  getNbrColors()         { return 1 << _bpp; }
+    void setColor(uint8_t index, uint16_t rgb565);
+    void setColors(const Palette &palette, uint8_t first, uint8_t nbrColors);
+    uint16_t getColor(uint8_t index) { return (_colors[index] >> 8) | (_colors[index] << 8); }
+    void clear(uint8_t index = 0) { _canvas.fillScreen(index); }
+    void push() { push(0, _height); }
+    void push(int y0, int rows);
+    const PipelineStats &getPushStats() { return _pipeline.getStats(); }
+    static size_t frameSize(int width, int height, uint8_t bitsPerPixel) { return (width * bitsPerPixel + 7) / 8 * height; }
+
+    /**
+     * Fast path for plotting single points, no bounds check
+    */
+    void setIndex(uint32_t x, uint32_t y, uint8_t index)
+    {
+      if (_bpp == 8)
+      {
+        _buffer[y * _width + x] = index;
+      }
+      else
+      {
+        uint8_t &cell = _buffer[(y * _width + x) >> 1];
+        cell = (x & 1) ? (cell & 0xF0) | index : (cell & 0x0F) | (index << 4);
+      }
+    }
+
+  private:
+    LGFX              &_lcd;
+    lgfx::LGFX_Sprite _canvas;
+    StripPipeline     _pipeline;
+    uint8_t           *_buffer = nullptr;   // buffer of the canvas
+    uint16_t          _colors[256];         // index --> byte swapped rgb565
+    uint8_t           _bpp = 0;
+    int               _width = 0, _height = 0;
+
+    static void renderStrip(void *context, uint16_t *strip, int y0, int rows);
+};
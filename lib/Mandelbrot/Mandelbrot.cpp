@@ -0,0 +1,378 @@
+/**
+ * Class        Mandelbrot
+ * 
+ * Purpose      Implements a class Mandelbrot which renders the Mandelbrot set
+ *              considerably faster than the straightforward float version:
+ *              - The iteration is done in Q3.28 fixed point with 32 x 32 --> 64 bit
+ *                products, which the ESP32 executes in a few cycles.
+ *              - Points inside the main cardioid and the period-2 bulb are 
+ *                recognized with a closed-form test and not iterated at all.
+ *                These points would otherwise cost the full maxIteration.
+ *              - The screen is rendered in strips by a StripPipeline. Both cores
+ *                take the next strip of 4 rows, a worker task on core 0 and the
+ *                calling task on core 1.
+ *              - A finished strip is sent to the panel with a single DMA transfer
+ *                instead of one drawPixel() per pixel. The next strip is 
+ *                calculated while the DMA is running.
+ *              The render time is returned by render() and printed over serial.
+ * 
+ *              renderProgressive() shows a first coarse image after a fraction of
+ *              the time. It renders 8x8 blocks first and refines them to 4x4, 2x2
+ *              and finally 1x1. Each pass calculates only the new pixels, the 
+ *              colors of the previous pass are kept in a grid of (w/b) x (h/b) 
+ *              entries. All passes run on both cores like render().
+ *              Both renders can be interrupted by the abort callback, e.g. when 
+ *              a new gesture arrives.
+ * 
+ *              With a palette set, the pixels are colored with the normalized 
+ *              iteration count mu = n + 1 - log2(log2|z|) instead of n, which 
+ *              removes the bands between iteration counts. The fractional part
+ *              only depends on |z|^2 at the escape and is taken from a table, 
+ *              so the color of a pixel costs two lookups and no float math.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The strip buffers hold byte swapped rgb565 values, the byte order
+ *              of the panel, so pushImageDMA() needs no conversion.
+ * References   https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set
+ */
+#include "Mandelbrot.h"
+
+static constexpr int     ROWS_PER_STRIP = 4;
+static constexpr int     NBR_STRIPS     = 4;
+static constexpr int64_t FOUR    = 4LL << (2 * Mandelbrot::FRAC_BITS);  // 4.0 in Q56
+static constexpr int32_t QUARTER = 1 << (Mandelbrot::FRAC_BITS - 2);    // 0.25 in Q28
+static constexpr int32_t ONE     = 1 << Mandelbrot::FRAC_BITS;
+
+static constexpr int     NBR_FRACS  = 64 * 16;                       // |z|^2 < 64 after the escape
+static int16_t *fracLUT = nullptr;  // |z|^2 * 16 --> 1 - log2(log2|z|) in Q8
+
+static inline uint16_t swapBytes(uint16_t c) { return (c >> 8) | (c << 8); }
+
+/**
+ * Set the displayed section of the complex plane,
+ * this is the view with zoom factor 1
+*/
+void Mandelbrot::setView(double reCenter, double imCenter, double reWidth, double imHeight)
+{
+  _reCenter = reCenter;
+  _imCenter = imCenter;
+  _reWidth  = reWidth;
+  _imHeight = imHeight;
+  _reWidthStart = reWidth;
+  updateFixedView();
+}
+
+/**
+ * Move the point at pixel (x, y) to the center and
+ * magnify by factor, factors < 1 zoom out
+*/
+void Mandelbrot::zoom(int x, int y, double factor)
+{
+  _reCenter += (x - _lcd.width()  / 2) * _reWidth  / _lcd.width();
+  _imCenter += (y - _lcd.height() / 2) * _imHeight / _lcd.height();
+  _reWidth  /= factor;
+  _imHeight /= factor;
+  updateFixedView();
+}
+
+/**
+ * Move the image by dx, dy pixels
+*/
+void Mandelbrot::pan(int dx, int dy)
+{
+  _reCenter -= dx * _reWidth  / _lcd.width();
+  _imCenter -= dy * _imHeight / _lcd.height();
+  updateFixedView();
+}
+
+void Mandelbrot::updateFixedView()
+{
+  _reStep = max((int32_t)1, toFixed(_reWidth  / _lcd.width()));  // limit of the Q3.28 resolution
+  _imStep = max((int32_t)1, toFixed(_imHeight / _lcd.height()));
+  _re0    = toFixed(_reCenter) - _reStep * (_lcd.width()  / 2);
+  _im0    = toFixed(_imCenter) - _imStep * (_lcd.height() / 2);
+}
+
+void Mandelbrot::setMaxIteration(uint16_t maxIteration)
+{
+  _maxIteration = maxIteration;
+  buildColorLUT();
+}
+
+/**
+ * A point escaping after n < nbrColors iterations gets colors[n], 
+ * after more iterations the outsideColor. Points of the set get 
+ * the insideColor.
+*/
+void Mandelbrot::setColors(const int *colors, int nbrColors, uint16_t outsideColor, uint16_t insideColor)
+{
+  _colors       = colors;
+  _nbrColors    = nbrColors;
+  _outsideColor = outsideColor;
+  _insideColor  = insideColor;
+  buildColorLUT();
+}
+
+/**
+ * Color with the normalized iteration count through the palette, 
+ * stepsPerIteration is the distance of two iteration counts in
+ * the palette. Pass nullptr to use the colors of setColors() again.
+*/
+void Mandelbrot::setPalette(const Palette *palette, uint16_t stepsPerIteration)
+{
+  _palette = palette;
+  _stepsPerIteration = stepsPerIteration;
+  if (fracLUT == nullptr)
+  { // built once, shared by all instances
+    fracLUT = (int16_t *)malloc(NBR_FRACS * sizeof(int16_t));
+    if (fracLUT == nullptr)
+    {
+      log_e("Not enough memory for the palette, using the colors");
+      _palette = nullptr;
+      return;
+    }
+    for (int i = 0; i < NBR_FRACS; i++)
+    {
+      float mag2 = max(4.0f, (i + 0.5f) / 16.0f);
+      fracLUT[i] = (int16_t)lroundf(256.0f * (1.0f - log2f(0.5f * log2f(mag2))));
+    }
+  }
+}
+
+bool Mandelbrot::buildColorLUT()
+{
+  free(_colorLUT);
+  _colorLUT = (uint16_t *)malloc((_maxIteration + 1) * sizeof(uint16_t));
+  if (_colorLUT == nullptr)
+  {
+    log_e("Not enough memory for %u colors", _maxIteration + 1);
+    return false;
+  }
+  for (int i = 0; i < _maxIteration; i++)
+  {
+    _colorLUT[i] = swapBytes(i < _nbrColors ? _colors[i] : _outsideColor);
+  }
+  _colorLUT[_maxIteration] = swapBytes(_insideColor);
+  return true;
+}
+
+/**
+ * Number of iterations until z = z^2 + c escapes the circle |z| = 2,
+ * or maxIteration if it does not. c = cr + i*ci in Q3.28.
+*/
+uint16_t IRAM_ATTR Mandelbrot::iterate(int32_t cr, int32_t ci, uint16_t maxIteration)
+{
+  int32_t x = 0, y = 0;
+  for (uint16_t i = 0; i < maxIteration; i++)
+  {
+    int64_t x2 = (int64_t)x * x;   // Q56
+    int64_t y2 = (int64_t)y * y;
+    if (x2 + y2 > FOUR) return i;
+    int32_t xy2 = (int32_t)(((int64_t)x * y) >> (FRAC_BITS - 1));  // 2xy in Q28
+    x = (int32_t)((x2 - y2) >> FRAC_BITS) + cr;
+    y = xy2 + ci;
+  }
+  return maxIteration;
+}
+
+/**
+ * Same as above, additionally returns |z|^2 at the escape in Q26 
+*/
+uint16_t IRAM_ATTR Mandelbrot::iterate(int32_t cr, int32_t ci, uint16_t maxIteration, uint32_t &mag2)
+{
+  int32_t x = 0, y = 0;
+  for (uint16_t i = 0; i < maxIteration; i++)
+  {
+    int64_t x2 = (int64_t)x * x;
+    int64_t y2 = (int64_t)y * y;
+    if (x2 + y2 > FOUR) 
+    {
+      mag2 = (uint32_t)((x2 + y2) >> (2 * FRAC_BITS - 26));
+      return i;
+    }
+    int32_t xy2 = (int32_t)(((int64_t)x * y) >> (FRAC_BITS - 1));
+    x = (int32_t)((x2 - y2) >> FRAC_BITS) + cr;
+    y = xy2 + ci;
+  }
+  return maxIteration;
+}
+
+/**
+ * Closed-form test for the main cardioid and the period-2 bulb
+ * q = (x - 1/4)^2 + y^2,  cardioid: q * (q + (x - 1/4)) <= y^2 / 4 
+ * bulb: (x + 1)^2 + y^2 <= 1/16
+*/
+bool IRAM_ATTR Mandelbrot::isInMainBulbs(int32_t cr, int32_t ci)
+{
+  int64_t y2 = ((int64_t)ci * ci) >> FRAC_BITS;          // Q28
+  int64_t xq = cr - QUARTER;
+  int64_t q  = ((xq * xq) >> FRAC_BITS) + y2;
+  if (((q * (q + xq)) >> FRAC_BITS) <= (y2 >> 2)) return true;
+  int64_t x1 = cr + ONE;
+  return ((x1 * x1) >> FRAC_BITS) + y2 <= (ONE >> 4);
+}
+
+/**
+ * Byte swapped color of the point c = cr + i*ci
+*/
+uint16_t IRAM_ATTR Mandelbrot::color(int32_t cr, int32_t ci)
+{
+  if (isInMainBulbs(cr, ci)) return _colorLUT[_maxIteration];
+  if (_palette == nullptr) return _colorLUT[iterate(cr, ci, _maxIteration)];
+
+  uint32_t mag2;
+  uint16_t n = iterate(cr, ci, _maxIteration, mag2);
+  if (n == _maxIteration) return _colorLUT[_maxIteration];
+  int32_t mu = (n << 8) + fracLUT[min(mag2 >> (26 - 4), (uint32_t)NBR_FRACS - 1)];  // Q8
+  return _palette->swapped((mu * _stepsPerIteration) >> 8);
+}
+
+uint16_t IRAM_ATTR Mandelbrot::colorAt(int x, int y)
+{
+  return color(_re0 + x * _reStep, _im0 + y * _imStep);
+}
+
+/**
+ * Render a row into line. If the colors of the 2x2 pass are known,
+ * the pixels with even row and column are taken from there.
+*/
+void IRAM_ATTR Mandelbrot::renderRow(int row, uint16_t *line)
+{
+  int32_t ci = _im0 + row * _imStep;
+  int32_t cr = _re0;
+  int     step = 1;
+
+  if (_knownColors != nullptr && (row & 1) == 0)
+  {
+    const uint16_t *known = &_knownColors[(row / 2) * ((_width + 1) / 2)];
+    for (int col = 0; col < _width; col += 2) line[col] = known[col / 2];
+    cr += _reStep;
+    step = 2;
+  }
+  for (int col = step - 1; col < _width; col += step, cr += step * _reStep)
+  {
+    line[col] = color(cr, ci);
+  }
+}
+
+/**
+ * StripRenderer of the pipeline, called on both cores
+*/
+void Mandelbrot::renderRowStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  Mandelbrot *m = (Mandelbrot *)context;
+  for (int r = 0; r < rows; r++) m->renderRow(y0 + r, strip + r * m->_width);
+}
+
+/**
+ * Render the full screen and return the render time in ms
+*/
+uint32_t Mandelbrot::render()
+{
+  uint32_t msStart = millis();
+
+  if (_colorLUT == nullptr && ! buildColorLUT()) return 0;
+  _width  = _lcd.width();
+  _height = _lcd.height();
+  _knownColors = nullptr;
+  renderRows();
+  _msRender = millis() - msStart;
+  log_i("Mandelbrot %d x %d rendered in %u ms, overlap %.0f %%", _width, _height, _msRender, 100.0f * _pipeline.getStats().overlap);
+  return _msRender;
+}
+
+/**
+ * Render the full screen in passes with block sizes 8, 4, 2 and 1.
+ * Returns false if the render was aborted.
+*/
+bool Mandelbrot::renderProgressive()
+{
+  uint16_t *prevColors = nullptr;
+  uint16_t *colors;
+  bool     isComplete = true;
+  uint32_t msStart = millis();
+
+  if (_colorLUT == nullptr && ! buildColorLUT()) return false;
+  _width  = _lcd.width();
+  _height = _lcd.height();
+
+  for (int b = 8; b >= 2 && isComplete; b /= 2)
+  {
+    colors = (uint16_t *)malloc(((_width + b - 1) / b) * ((_height + b - 1) / b) * sizeof(uint16_t));
+    if (colors == nullptr)
+    {
+      log_e("Not enough memory for the %dx%d blocks", b, b);
+      free(prevColors);
+      return false;
+    }
+    isComplete = renderBlocks(b, prevColors, colors);
+    free(prevColors);
+    prevColors = colors;
+    log_i("Pass %dx%d done after %u ms", b, b, millis() - msStart);
+  }
+  if (isComplete)
+  {
+    _knownColors = prevColors;
+    isComplete = renderRows();
+    _knownColors = nullptr;
+  }
+  free(prevColors);
+
+  _msRender = millis() - msStart;
+  log_i("Mandelbrot zoom %.0f, %u iterations %s after %u ms", getZoom(), _maxIteration, isComplete ? "done" : "aborted", _msRender);
+  return isComplete;
+}
+
+/**
+ * One coarse pass: every blockSize x blockSize block gets the color of 
+ * its upper left pixel. Blocks whose upper left pixel was calculated in 
+ * the previous pass (prevColors, blocks twice as large) are not calculated 
+ * again. The colors of the pass are stored in colors for the next pass.
+ * A strip of blockSize rows is pushed with one DMA transfer.
+*/
+bool Mandelbrot::renderBlocks(int blockSize, const uint16_t *prevColors, uint16_t *colors)
+{
+  _blockSize   = blockSize;
+  _prevColors  = prevColors;
+  _blockColors = colors;
+  if (! _pipeline.begin(blockSize, NBR_STRIPS)) return false;
+  bool isComplete = _pipeline.run(renderBlockStrip, this, _abortCb);
+  _pipeline.end();
+  return isComplete;
+}
+
+/**
+ * StripRenderer of a coarse pass, a strip is one row of blocks
+*/
+void Mandelbrot::renderBlockStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  Mandelbrot *m = (Mandelbrot *)context;
+  int b   = m->_blockSize;
+  int w   = m->_width;
+  int gy  = y0 / b;
+  int gw  = (w + b - 1) / b;
+  int pgw = (gw + 1) / 2;
+
+  for (int gx = 0; gx < gw; gx++)
+  {
+    uint16_t c;
+    if (m->_prevColors != nullptr && (gx & 1) == 0 && (gy & 1) == 0)
+      c = m->_prevColors[(gy / 2) * pgw + gx / 2];
+    else
+      c = m->colorAt(gx * b, y0);
+    m->_blockColors[gy * gw + gx] = c;
+    for (int x = gx * b; x < min((gx + 1) * b, w); x++) strip[x] = c;
+  }
+  for (int r = 1; r < rows; r++) memcpy(&strip[r * w], strip, w * sizeof(uint16_t));
+}
+
+/**
+ * Render all rows with both cores, returns false if aborted
+*/
+bool Mandelbrot::renderRows()
+{
+  if (! _pipeline.begin(ROWS_PER_STRIP, NBR_STRIPS)) return false;
+  bool isComplete = _pipeline.run(renderRowStrip, this, _abortCb);
+  _pipeline.end();
+  return isComplete;
+}
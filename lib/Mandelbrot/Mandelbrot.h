@@ -0,0 +1,78 @@
+/**
+ * Mandelbrot.h
+ * 
+ * Declaration of the class Mandelbrot. The constructor needs a reference 
+ * to the LGFX object. The view is given by the center and the size of the
+ * displayed section of the complex plane. A render can be interrupted by
+ * an abort callback, which is polled after every strip.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+#include "Palette.h"
+#include "StripPipeline.h"
+
+class Mandelbrot
+{
+  public:
+    Mandelbrot(LGFX &lcd) : _lcd(lcd), _pipeline(lcd) {}
+    void setView(double reCenter, double imCenter, double reWidth, double imHeight);
+    void zoom(int x, int y, double factor);
+    void pan(int dx, int dy);
+    double getZoom() { return _reWidthStart / _reWidth; }
+    void getView(double &reCenter, double &imCenter, double &reWidth, double &imHeight)
+    {
+      reCenter = _reCenter; imCenter = _imCenter; reWidth = _reWidth; imHeight = _imHeight;
+    }
+    void setMaxIteration(uint16_t maxIteration);
+    uint16_t getMaxIteration() { return _maxIteration; }
+    void setColors(const int *colors, int nbrColors, uint16_t outsideColor, uint16_t insideColor);
+    void setPalette(const Palette *palette, uint16_t stepsPerIteration = 16);
+    void setAbortCb(AbortCallback cb) { _abortCb = cb; }
+    uint32_t render();
+    bool renderProgressive();
+    uint32_t getMsRender() { return _msRender; }
+    const PipelineStats &getPipelineStats() { return _pipeline.getStats(); }
+
+    static constexpr int FRAC_BITS = 28;  // Q3.28 fixed point, range -8 .. +8
+    static int32_t toFixed(double v) { return (int32_t)llround(v * (1 << FRAC_BITS)); }
+    static uint16_t iterate(int32_t cr, int32_t ci, uint16_t maxIteration);
+    static uint16_t iterate(int32_t cr, int32_t ci, uint16_t maxIteration, uint32_t &mag2);
+    static bool isInMainBulbs(int32_t cr, int32_t ci);
+
+  private:
+    LGFX &_lcd;
+    double   _reCenter = 0.0, _imCenter = 0.0;
+    double   _reWidth = 4.0, _imHeight = 4.0;
+    double   _reWidthStart = 4.0;         // width set by setView(), zoom = 1
+    int32_t  _re0, _im0;                  // upper left corner
+    int32_t  _reStep, _imStep;            // size of a pixel
+    uint16_t _maxIteration = 1000;
+    const int *_colors = nullptr;
+    int      _nbrColors = 0;
+    uint16_t _outsideColor = TFT_WHITE;
+    uint16_t _insideColor  = TFT_BLACK;
+    uint16_t *_colorLUT = nullptr;        // iteration count --> byte swapped rgb565
+    const Palette *_palette = nullptr;    // smooth coloring if set
+    uint16_t _stepsPerIteration = 16;     // palette entries per iteration
+    uint32_t _msRender = 0;
+    AbortCallback _abortCb = nullptr;
+
+    StripPipeline _pipeline;
+
+    // Read by the strip renderers on both cores
+    int           _height, _width;
+    const uint16_t *_knownColors  = nullptr;  // colors of the previous pass or nullptr
+    int           _blockSize;
+    const uint16_t *_prevColors   = nullptr;  // colors of the previous block pass or nullptr
+    uint16_t     *_blockColors    = nullptr;  // colors of the current block pass
+
+    void updateFixedView();
+    bool buildColorLUT();
+    uint16_t colorAt(int x, int y);
+    uint16_t color(int32_t cr, int32_t ci);
+    void renderRow(int row, uint16_t *line);
+    bool renderRows();
+    bool renderBlocks(int blockSize, const uint16_t *prevColors, uint16_t *colors);
+    static void renderRowStrip(void *context, uint16_t *strip, int y0, int rows);
+    static void renderBlockStrip(void *context, uint16_t *strip, int y0, int rows);
+};
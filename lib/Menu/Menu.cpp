@@ -10,6 +10,9 @@
  *              missing in the constructor, it takes the value 0 and the only menu page 
  *              shows all defined menuitems. The user must then ensure that nbrDisplayedMenuItems 
  *              is not larger than the number of possible lines on the display. 
+ *              The page is drawn into a compositor, which flushes only the lines
+ *              that changed since the last show(). A swipe left or right toggles
+ *              the outlines of the flushed regions and prints the statistics.
  *              
  * Board        ESP32 / Touch display, e.g. CYD cheap Yellow Display
  * Library      LovyanGFX 
@@ -21,34 +24,58 @@
 void Menu::setup()
 {
   if (_nbrDisplayedMenuItems == 0) _nbrDisplayedMenuItems = _nbrMenuItems;
+  if (_selectedMenuItem < 0 || _selectedMenuItem >= _nbrMenuItems) _selectedMenuItem = 0;
 
-  _menuPage = _selectedMenuItem / _nbrDisplayedMenuItems;
+  // keep a restored page, otherwise show the page of the selected menuitem
+  if (_menuPage < 0 || _menuPage * _nbrDisplayedMenuItems >= _nbrMenuItems)
+    _menuPage = _selectedMenuItem / _nbrDisplayedMenuItems;
   _startMenuItem = _menuPage * _nbrDisplayedMenuItems;
   _stopMenuItem = _startMenuItem + _nbrDisplayedMenuItems;
+  if (_stopMenuItem >= _nbrMenuItems) _stopMenuItem = _nbrMenuItems;
   
+  _compositor.begin(2 * _nbrDisplayedMenuItems + 4);
   show();
 }
 
+/**
+ * Set the selected menuitem and the menu page, e.g. after 
+ * a wake up from deep sleep. Must be called before setup().
+*/
+void Menu::restore(int selectedMenuItem, int menuPage)
+{
+  _selectedMenuItem = selectedMenuItem;
+  _menuPage = menuPage;
+}
+
 
-// Show the menu
-void Menu::show(bool clearScreen)
+/**
+ * Show the menu. With fullRedraw the whole screen is sent to the panel,
+ * e.g. after an action has drawn on it, otherwise only the changed lines
+*/
+void Menu::show(bool fullRedraw)
 {
-  if (clearScreen) _lcd.fillScreen(TFT_BLACK);
+  int y = 0;
+
+  _lcd.setRotation(1);
   _lcd.setTextColor(TFT_GREEN, TFT_BLACK);
-  _lcd.setTextFont(4);
+  _lcd.setTextFont(4);   // touched() calculates the menuitem from the font height
   _lcd.setTextSize(1);
-  _lcd.setCursor(0,0);
-  _lcd.setRotation(1);
+  if (fullRedraw) _compositor.invalidate();
 
+  _compositor.fillScreen(TFT_BLACK);
+  _compositor.setTextFont(4);
+  _compositor.setTextSize(1);
   for(int i = _startMenuItem; i < _stopMenuItem; i++)
   {
     if (i == _selectedMenuItem)
-      _lcd.setTextColor(TFT_RED, TFT_GREEN); // highlight the selected menuitem
+      _compositor.setTextColor(TFT_RED, TFT_GREEN); // highlight the selected menuitem
     else
-      _lcd.setTextColor(TFT_GREEN, TFT_BLACK);
+      _compositor.setTextColor(TFT_GREEN, TFT_BLACK);
       
-    _lcd.println(_menuItems[i].txt);
-  }      
+    _compositor.drawString(_menuItems[i].txt, 0, y);
+    y += _compositor.fontHeight();
+  }
+  _compositor.flush();
 }
 
 /**
@@ -68,7 +95,7 @@ void Menu::onTouch(uint8_t touchedItem)
       else
       { // an unselected menuitem is touched, select it
         _selectedMenuItem = touchedItem  + _nbrDisplayedMenuItems * _menuPage;
-        show();
+        show(false);
       }
     break;
     case 1: // show the menu again
@@ -103,10 +130,14 @@ void Menu::OnSwipe(uint8_t direction)
         _stopMenuItem = _startMenuItem + _nbrDisplayedMenuItems;
       }
     break;
-    case LEFT:  // not handled
-    case RIGHT: // not handled
+    case LEFT:  // toggle the outlines of the flushed regions
+    case RIGHT:
+      Compositor::setOverlay(! Compositor::isOverlay());
+      _compositor.printStats("Menu");
     break;
   }
-  show();
+  // the last screen of an action is not known to the compositor
+  show(_state != 0);
+  _state = 0;
 }
     
@@ -6,9 +6,12 @@
  * as the number of menuitems to be displayed on a menu page. 
  * If the default value 0 is used, an attempt is made to show all menu 
  * lines, which can, however, result in an overflow on the display.
+ * The menu is drawn through a compositor, so a new selection only 
+ * redraws the two changed lines.
  */ 
 #pragma once
 #include "lgfx_ESP32_2432S028.h"
+#include "Compositor.h"
 
 using MenuItem = struct mItem{ const char *txt; void (&action)(); };
 enum direction {LEFT, RIGHT, UP, DOWN};
@@ -18,6 +21,7 @@ class Menu
   public:
     Menu(LGFX &lcd, MenuItem menuItems[], int nbrMenuItems, int nbrDisplayedMenuItems = 0) : 
       _lcd(lcd), 
+      _compositor(lcd),
       _menuItems(menuItems), 
       _nbrMenuItems(nbrMenuItems),
       _nbrDisplayedMenuItems(nbrDisplayedMenuItems)
@@ -25,12 +29,16 @@ class Menu
     }
 
     void setup();
-    void show(bool clearScreen = true);
+    void restore(int selectedMenuItem, int menuPage);
+    void show(bool fullRedraw = true);
     void onTouch(uint8_t touchedItem);
     void OnSwipe(uint8_t direction);
+    int  getSelectedMenuItem() { return _selectedMenuItem; }
+    int  getMenuPage()         { return _menuPage; }
 
   private:
     LGFX &_lcd;
+    Compositor _compositor; // sends only the changed menu lines to the panel
     MenuItem *_menuItems;   // Pointer to the array of menuitems
     uint8_t  _nbrMenuItems;
     int      _selectedMenuItem = 0;
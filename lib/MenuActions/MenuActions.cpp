@@ -1,8 +1,11 @@
 #include "MenuActions.h"
+#include "TouchHandler.h"
 
 extern LGFX tft;
 extern DigitalClock digitalClock;
 extern AnalogClock  analogClock;
+extern WiFiScanner  wifiScanner;
+extern SpiTuner     spiTuner;
 
 
 int TFTcolor[] = {  TFT_BLACK,
@@ -33,6 +36,65 @@ int TFTcolor[] = {  TFT_BLACK,
 
 constexpr int nbrTFTcolors = sizeof(TFTcolor) / sizeof(TFTcolor[0]);
 
+Mandelbrot mandelbrot(lcd);
+ScreenCache screenCache(lcd, 64 * 1024);   // results of the fractal actions
+
+static bool isTouched()
+{
+  int x, y;
+  return lcd.getTouch(&x, &y);
+}
+
+/**
+ * Gestures for the interactive actions. A local TouchHandler reports
+ * the gesture through the callbacks below, isGesturePending() polls
+ * it and serves as abort callback for long running renders.
+*/
+enum Gesture { NO_GESTURE, TAP, HOLD, SWIPE_LEFT, SWIPE_RIGHT, SWIPE_UP, SWIPE_DOWN };
+static Gesture gesture = NO_GESTURE;
+static int gestureX, gestureY;
+static TouchHandler *gestureTouch = nullptr;
+
+static void setGesture(Gesture g, int x, int y) { gesture = g; gestureX = x; gestureY = y; }
+static void onGestureTap(int x, int y)        { setGesture(TAP, x, y); }
+static void onGestureHold(int x, int y)       { setGesture(HOLD, x, y); }
+static void onGestureSwipeLeft(int x, int y)  { setGesture(SWIPE_LEFT, x, y); }
+static void onGestureSwipeRight(int x, int y) { setGesture(SWIPE_RIGHT, x, y); }
+static void onGestureSwipeUp(int x, int y)    { setGesture(SWIPE_UP, x, y); }
+static void onGestureSwipeDown(int x, int y)  { setGesture(SWIPE_DOWN, x, y); }
+
+static void beginGestures(TouchHandler &touch)
+{
+  touch.addShortClickCb(onGestureTap);
+  touch.addLongClickCb(onGestureHold);
+  touch.addSwipeLeftCb(onGestureSwipeLeft);
+  touch.addSwipeRightCb(onGestureSwipeRight);
+  touch.addSwipeUpCb(onGestureSwipeUp);
+  touch.addSwipeDownCb(onGestureSwipeDown);
+  gestureTouch = &touch;
+  gesture = NO_GESTURE;
+}
+
+// Polls the touch controller at most every 20 ms
+static bool isGesturePending()
+{
+  static uint32_t msLastPoll = 0;
+  if (gestureTouch != nullptr && millis() - msLastPoll >= 20)
+  {
+    msLastPoll = millis();
+    gestureTouch->loop();
+  }
+  return gesture != NO_GESTURE;
+}
+
+static Gesture waitForGesture()
+{
+  Gesture g;
+  while (! isGesturePending()) delay(5);
+  g = gesture;
+  gesture = NO_GESTURE;
+  return g;
+}
 
 /**
  * Convert HSV to RGB color space and return a
@@ -117,46 +179,75 @@ uint16_t rgbToColor565(float r, float g, float b, uint8_t &R, uint8_t &G, uint8_
   return __R | __G | __B;
 }
 
+/**
+ * Shows the 32 x 32 combinations of R (rows) and B (columns) for one
+ * of the 64 values of G. A page is built in strips of one R row and 
+ * pushed by DMA. Swipe left / right steps G by 1, swipe up / down by 
+ * 8, a tap shows the next G and a long click ends the action.
+*/
 void showRGB565palettes()
 {
-  int x = 0;
-  int y = 0;
-  int side = lcd.height() / 32;
-  char s[16];
+  uint8_t savedRot = lcd.getRotation();
+  TouchHandler touch(lcd);
   GFXfont font = fonts::DejaVu12;
-  
-  // Create all 64 color palettes with varying G value between
-  // 0 and 64 (6 bit)
-  for (uint8_t G = 0; G < 64; G++)
+  char s[24];
+  int  G = 0;
+  int  buf = 0;
+  bool isRunning = true;
+
+  lcd.setRotation(1);
+  const int side = lcd.height() / 32;
+  const int w = 32 * side;
+  const int xText = w + 8;
+  uint16_t *strips[2];
+  for (int i = 0; i < 2; i++) strips[i] = (uint16_t *)heap_caps_malloc(w * side * sizeof(uint16_t), MALLOC_CAP_DMA);
+  if (strips[0] == nullptr || strips[1] == nullptr) isRunning = false;
+
+  lcd.fillScreen(TFT_BLACK);
+  lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+  lcd.drawString("rows R 0..31", xText, 4, &font);
+  lcd.drawString("columns B 0..31", xText, 20, &font);
+  beginGestures(touch);
+  while (isRunning)
   {
-    x = 0;
-    y = 0;
-    lcd.fillScreen(TFT_BLACK);
-    sprintf(s, "G = %d", G);  // show G value
-    lcd.drawString(s, 240, 36, &font);
-
-    // Creates a color palette consisting of 32 x 32 square color fields. 
-    // Each color field is colored with a combination of R and B with 
-    // values between 0 and 32 (5 bit) at a constant G value.
-    for (uint8_t R = 0; R < 32; R++)  // vary R in y direction
+    uint32_t usStart = micros();
+    lcd.startWrite();
+    for (int R = 0; R < 32; R++)
     {
-      sprintf(s, "R = %d", R);
-      lcd.drawString(s, 240, 20, &font);  // show R value
-
-      for (uint8_t B = 0; B < 32; B++)  // vary B in x direction
+      uint16_t *strip = strips[buf];
+      for (int B = 0; B < 32; B++)
       {
-        uint16_t rgb565 = ((R >> 3) << 11) | ((G >> 2) << 5) | (B >> 3);
-        lcd.fillRect(x, y, side, side, rgb565);
-        sprintf(s, "B = %d", B);
-        lcd.drawString(s, 240, 52, &font);  // show B value
-        x += side;
+        uint16_t rgb565 = (R << 11) | (G << 5) | B;
+        uint16_t swapped = (rgb565 >> 8) | (rgb565 << 8);
+        for (int i = 0; i < side; i++) strip[B * side + i] = swapped;
       }
-      x = 0;
-      y += side;
+      for (int row = 1; row < side; row++) memcpy(strip + row * w, strip, w * sizeof(uint16_t));
+      lcd.waitDMA();
+      lcd.pushImageDMA(0, R * side, w, side, (lgfx::swap565_t *)strip);
+      buf ^= 1;
+    }
+    lcd.waitDMA();
+    lcd.endWrite();
+    uint32_t usPage = micros() - usStart;
+
+    snprintf(s, sizeof(s), "G = %d   ", G);
+    lcd.drawString(s, xText, 52, &font);
+    snprintf(s, sizeof(s), "%u us   ", usPage);
+    lcd.drawString(s, xText, 68, &font);
+
+    switch (waitForGesture())
+    {
+      case SWIPE_LEFT:  G = (G + 1) & 63;  break;
+      case SWIPE_RIGHT: G = (G + 63) & 63; break;
+      case SWIPE_UP:    G = (G + 8) & 63;  break;
+      case SWIPE_DOWN:  G = (G + 56) & 63; break;
+      case TAP:         G = (G + 1) & 63;  break;
+      default:          isRunning = false; break;
     }
-    delay(1000);
-    if (lcd.getTouch(&x, &y)) break;
   }
+  gestureTouch = nullptr;
+  for (int i = 0; i < 2; i++) free(strips[i]);
+  lcd.setRotation(savedRot);
 }
 
 
@@ -310,278 +401,482 @@ void showTextSizes()
   lcd.setFont(savedFont);    
 }
 
-// Shows text in the 4 directions 0..3
+static uint8_t rotatedTextStart;
+
+static bool renderRotatedText(uint32_t frame)
+{
+  lcd.setRotation((rotatedTextStart + frame) % 4);
+  lcd.fillScreen(TFT_BLACK);
+  lcd.setTextColor(TFT_GREEN, TFT_BLACK);
+  lcd.setTextSize(1);
+  int pos_x = (lcd.width() - lcd.textWidth("Good By! Good By!")) / 2;  // Den ersten Text zentrieren
+  lcd.setCursor(pos_x,0);
+  lcd.println("Good By! Good By!");   // println() setzt den Curser auf 
+                                        // den Anfang der nächsten Zeile
+  
+  lcd.setTextColor(TFT_RED, TFT_BLACK);
+  lcd.setTextSize(2);
+  lcd.println("Good By!");
+
+  lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
+  lcd.setTextSize(3);
+  lcd.println("Good By");
+  return frame < 4;
+}
+
+// Shows text in the 4 directions 0..3, two frames per second
 void showRotatedText()
 {
   uint8_t savedRot = lcd.getRotation();
   uint8_t savedSize = lcd.getTextSizeY();
-  for (int i = savedRot; i < savedRot + 5; i++)
-  {
-    lcd.fillScreen(TFT_BLACK);
-    lcd.setRotation(i % 4); 
-    lcd.setTextColor(TFT_GREEN, TFT_BLACK);
-    lcd.setTextSize(1);
-    int pos_x = (lcd.width() - lcd.textWidth("Good By! Good By!")) / 2;  // Den ersten Text zentrieren
-    lcd.setCursor(pos_x,0);
-    lcd.println("Good By! Good By!");   // println() setzt den Curser auf 
-                                          // den Anfang der nächsten Zeile
-    
-    lcd.setTextColor(TFT_RED, TFT_BLACK);
-    lcd.setTextSize(2);
-    lcd.println("Good By!");
-  
-    lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
-    lcd.setTextSize(3);
-    lcd.println("Good By");
-    delay(500);
-  }
+  FrameScheduler scheduler(lcd, 2);
+
+  rotatedTextStart = savedRot;
+  scheduler.run(renderRotatedText);
+  scheduler.printStats("Rotated text");
   lcd.setTextSize(savedSize);
   lcd.setRotation(savedRot);
 }
 
+// Position of the next digit and timing of the pi digit stream
+static int piX, piY, piTop;
+static uint32_t piMsStart, piMsStatus;
+
+static void showPiStatus(uint32_t nbrDigits)
+{
+  char s[48];
+  uint32_t ms = max(millis() - piMsStart, (uint32_t)1);
+  snprintf(s, sizeof(s), "Pi  %u digits  %u digits/s   ", nbrDigits, (uint32_t)(1000ULL * nbrDigits / ms));
+  lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
+  lcd.drawString(s, 4, 2);
+  lcd.setTextColor(TFT_SKYBLUE, TFT_BLACK);
+  piMsStatus = millis();
+}
+
+static bool onPiDigits(const char *digits, uint32_t nbrDigits)
+{
+  const int cellWidth = lcd.textWidth("0");
+  const int cellHeight = lcd.fontHeight();
+
+  for (const char *p = digits; *p; p++)
+  {
+    if (piX + cellWidth > lcd.width() - 4) { piX = 4; piY += cellHeight; }
+    if (piY + cellHeight > lcd.height())
+    { // next page
+      lcd.fillRect(0, piTop, lcd.width(), lcd.height() - piTop, TFT_BLACK);
+      piY = piTop;
+    }
+    piX += lcd.drawChar(*p, piX, piY);
+    if (nbrDigits == 4 && p == digits) piX += lcd.drawChar('.', piX, piY);
+  }
+  if (millis() - piMsStatus >= 1000) showPiStatus(nbrDigits);
+  return nbrDigits % 100 != 0 || ! isTouched();
+}
+
+/**
+ * Streams the digits of pi page by page as the PiSpigot class
+ * computes them, the status line shows the digits per second.
+ * A touch ends the computation.
+*/
 void showPi()
 {
-  GFXfont font = fonts::FreeSerif12pt7b;
+  PiSpigot pi;
+
   lcd.fillScreen(TFT_BLACK);
-  lcd.setTextColor(TFT_SKYBLUE);
-  lcd.setCursor(10, 100, &font);
-  lcd.printf("Pi < 355 / 113 = %1.8f", 355.0 / 113.0);
+  lcd.setTextFont(2);
+  if (! pi.begin(PiSpigot::MAX_DIGITS)) return;
+  piTop = lcd.fontHeight() + 6;
+  piX = 4;
+  piY = piTop;
+  piMsStart = millis();
+  showPiStatus(0);
+  const PiStats &stats = pi.run(onPiDigits);
+  pi.end();
+  showPiStatus(stats.digits);
+  Serial.printf("Pi: %u digits in %u ms, %u digits/s\n", stats.digits, stats.msRun, stats.digitsPerSec);
+}
+
+/**
+ * The vector demos record their primitives into a display list,
+ * which is then replayed by the frame scheduler at fps frames per 
+ * second. Late frames are drawn together with the next one.
+*/
+static DisplayList *demoList = nullptr;
+static bool renderDemoFrame(uint32_t frame) { return demoList->replayUntil(lcd, frame); }
+
+static void playDemo(const char *name, void (*record)(DisplayList &dl, int w, int h), uint16_t fps)
+{
+  DisplayList dl;
+  FrameScheduler scheduler(lcd, fps);
+
+  if (! dl.begin(4096)) return;
+  record(dl, lcd.width(), lcd.height());
+  if (dl.hasOverflow()) log_w("%s: display list is full", name);
+  demoList = &dl;
+  scheduler.run(renderDemoFrame);
+  demoList = nullptr;
+  scheduler.printStats(name);
+  const DisplayListStats &stats = dl.getStats();
+  Serial.printf("%u primitives, %u words, %u us drawing, %u primitives/s\n", 
+    stats.primitives, dl.getSize(), stats.usDraw, stats.primitivesPerSec);
+}
+
+static void recordShrinkingRectangles(DisplayList &dl, int w, int h)
+{
+  dl.fillScreen(TFT_BLACK);
+  for (int i = 0; i < h/2; i += 5)
+  {
+    dl.rect(i, i, w-2*i, h-2*i, TFTcolor[random(0,nbrTFTcolors)]);
+    dl.frame();
+  }
 }
 
 // Zeichnet kleiner werdende Rechtecke
 void showShrinkingRectangles()
 {
-  int w = lcd.width();
-  int h = lcd.height();
-  
-  lcd.fillScreen(TFT_BLACK);
-  for (int i = 0; i < h/2; i += 5)
+  playDemo("Shrinking rectangles", recordShrinkingRectangles, 10);
+}
+
+static void recordCornerLines(DisplayList &dl, int w, int h)
+{
+  dl.fillScreen(TFT_BLACK);
+  for(int i = 0; i < w; i +=7 )
   {
-    lcd.drawRect(i, i, w-2*i, h-2*i, TFTcolor[random(0,nbrTFTcolors)]);
-    delay(100);  
+    dl.line(0, 0, w, i, TFT_GREEN);
+    dl.frame();
+    dl.line(w, 0, w-i, h, TFT_BLUE);
+    dl.frame();
+    dl.line(w, h, 0, h-i, TFT_RED);
+    dl.frame();
+    dl.line(0, h, i, 0, TFT_YELLOW);
+    dl.frame();
   }
 }
 
 // Zeichnet Linien ausgehend von allen 4 Ecken
 void showCornerLines()
 {
-  int w = lcd.width();
-  int h = lcd.height();
-  
-  lcd.fillScreen(TFT_BLACK);
-  for(int i = 0; i < w; i +=7 )
+  playDemo("Corner lines", recordCornerLines, 20);
+}
+
+static void recordRoundedRectangles(DisplayList &dl, int w, int h)
+{
+  dl.fillScreen(TFT_BLACK);
+  for(int i = 0 ; i < h/2; i+=7) 
   {
-    lcd.drawLine(0, 0, w, i, TFT_GREEN);
-    delay(50);
-    lcd.drawLine(w, 0, w-i, h, TFT_BLUE);
-    delay(50);
-    lcd.drawLine(w, h, 0, h-i, TFT_RED);
-    delay(50);
-    lcd.drawLine(0, h, i, 0, TFT_YELLOW);
-    delay(50); 
+    int rectR = i+1;
+    int rectH = 2 * rectR;
+    dl.roundRect(0, (h-rectH)/2, w, rectH, rectR, TFT_RED);
+    dl.roundRect((w-rectH)/2, 0, rectH, h, rectR, TFT_VIOLET);
+    dl.frame();
   }
 }
 
 // Zeichnet abgerundete Rechtecke mit unterschiedlichen Radien
 void showRoundedRectangles() 
 {
-  lcd.fillScreen(TFT_BLACK);
-  int w = lcd.width();
-  int h = lcd.height();
-  int rectH =40;
-  int rectR = 15;
+  playDemo("Rounded rectangles", recordRoundedRectangles, 10);
+}
 
-  for(int i = 0 ; i < h/2; i+=7) 
+static void recordFilledColorCircles(DisplayList &dl, int w, int h)
+{
+  dl.fillScreen(TFT_BLACK);
+  for(int i = 0; i < h/2; i += 3)
   {
-    rectR = i+1;
-    rectH = 2 * rectR;
-    lcd.drawRoundRect(0, (h-rectH)/2, w, rectH, rectR, TFT_RED);
-    lcd.drawRoundRect((w-rectH)/2, 0, rectH, h, rectR, TFT_VIOLET);
-    delay(100);
+    dl.fillCircle(w/2, h/2, h/2 - 2*i, TFTcolor[random(0,nbrTFTcolors)]); 
+    dl.frame();
   }
 }
 
-
 // Zeichnet gefüllte Farbkreise
 void showFilledColorCircles()
 {
-  int w = lcd.width();
-  int h = lcd.height();
+  playDemo("Filled circles", recordFilledColorCircles, 10);
+}
 
-  lcd.fillScreen(TFT_BLACK);
-  for(int i = 0; i < h/2; i += 3)
+static void recordColoredTriangles(DisplayList &dl, int w, int h)
+{
+  w -= 1;
+  h -= 1;
+  dl.fillScreen(TFT_BLACK);
+  for(int i = 0; i < w/2; i += 5)
   {
-    lcd.fillCircle(w/2, h/2, h/2 - 2*i, TFTcolor[random(0,nbrTFTcolors)]); 
-    delay(100);
+    dl.triangle(w/2, 0, 0, h/2, i, i*h/w, TFT_RED); 
+    dl.frame();
+    dl.triangle(0, h/2, w/2, h, i, h - i*h/w, TFT_BLUE); 
+    dl.frame();
+    dl.triangle(w/2, 0, w, h/2, w-i, i*h/w, TFT_BLUE);  
+    dl.frame();
+    dl.triangle(w, h/2, w/2, h, w-i, h - i*h/w, TFT_RED); 
+    dl.frame();
   }
 }
 
 // Zeichnet blaue und rote Dreiecke
 void showColoredTriangles()
 {
-  int w = lcd.width()-1;
-  int h = lcd.height()-1;
-  lcd.fillScreen(TFT_BLACK);
-  for(int i = 0; i < w/2; i += 5)
+  playDemo("Colored triangles", recordColoredTriangles, 33);
+}
+
+/**
+ * Iterated function systems rendered by the class IFS. Each preset
+ * is a table of affine maps with the display rotation and number of
+ * points it is drawn with. Density presets show the visit frequency
+ * of the pixels instead of the map colors.
+*/
+struct IFSPreset { const char *name; const AffineMap *maps; int nbrMaps; uint8_t rotation; uint32_t points; bool isDensity; };
+
+static const AffineMap sierpinskyMaps[] =
+{
+  {0.5, 0.0, 0.0, 0.5, 0.0,  0.0,   1, TFT_RED},
+  {0.5, 0.0, 0.0, 0.5, 0.5,  0.0,   1, TFT_GREEN},
+  {0.5, 0.0, 0.0, 0.5, 0.25, 0.433, 1, TFT_BLUE},
+};
+
+static const AffineMap fernMaps[] =
+{
+  { 0.00,  0.00,  0.00, 0.16, 0.0, 0.00, 0.02, TFT_BROWN},
+  { 0.20, -0.26,  0.23, 0.22, 0.0, 1.60, 0.07, TFT_GREENYELLOW},
+  {-0.15,  0.28,  0.26, 0.24, 0.0, 0.44, 0.07, TFT_GREENYELLOW},
+  { 0.85,  0.04, -0.04, 0.85, 0.0, 1.60, 0.84, TFT_GREEN},
+};
+
+static const AffineMap dragonMaps[] =
+{
+  { 0.5, -0.5, 0.5,  0.5, 0.0, 0.0, 1, TFT_ORANGE},
+  {-0.5, -0.5, 0.5, -0.5, 1.0, 0.0, 1, TFT_SKYBLUE},
+};
+
+static const AffineMap kochMaps[] =
+{
+  {1.0/3,  0.0,       0.0,      1.0/3, 0.0,   0.0,      1, TFT_CYAN},
+  {1.0/6, -0.288675,  0.288675, 1.0/6, 1.0/3, 0.0,      1, TFT_MAGENTA},
+  {1.0/6,  0.288675, -0.288675, 1.0/6, 0.5,   0.288675, 1, TFT_YELLOW},
+  {1.0/3,  0.0,       0.0,      1.0/3, 2.0/3, 0.0,      1, TFT_CYAN},
+};
+
+static const AffineMap mapleMaps[] =
+{
+  {0.14,  0.01, 0.00, 0.51, -0.08, -1.31, 0.10, TFT_BROWN},
+  {0.43,  0.52, -0.45, 0.50, 1.49, -0.75, 0.35, TFT_RED},
+  {0.45, -0.49, 0.47, 0.47, -1.62, -0.74, 0.35, TFT_ORANGE},
+  {0.49,  0.00, 0.00, 0.51,  0.02,  1.62, 0.20, TFT_GOLD},
+};
+
+#define IFS_MAPS(m) m, sizeof(m) / sizeof(m[0])
+static const IFSPreset sierpinskyPreset = {"Sierpinsky", IFS_MAPS(sierpinskyMaps), 1, 400000, true};
+static const IFSPreset fernPreset       = {"Barnsley Fern", IFS_MAPS(fernMaps), 2, 1000000, true};
+static const IFSPreset ifsPresets[] =
+{
+  {"Heighway Dragon", IFS_MAPS(dragonMaps), 1, 400000, false},
+  {"Koch Curve",      IFS_MAPS(kochMaps),   1, 200000, false},
+  {"Maple Leaf",      IFS_MAPS(mapleMaps),  1, 400000, false},
+};
+
+/**
+ * Render an IFS preset, a touch ends the rendering early. A completed
+ * render is cached and shown from the cache the next time.
+*/
+static void renderIFS(const IFSPreset &preset, AbortCallback isAborted = isTouched)
+{
+  uint8_t savedRot = lcd.getRotation();
+  IFS ifs(lcd);
+  char s[48];
+  uint32_t key = ScreenCache::makeKey(preset.name, &preset.points, sizeof(preset.points));
+
+  lcd.setRotation(preset.rotation);
+  lcd.setTextFont(2);
+  lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+  if (screenCache.restore(key))
   {
-    lcd.drawTriangle(w/2, 0, 0, h/2, i, i*h/w, TFT_RED); 
-    delay(30);
-    lcd.drawTriangle(0, h/2, w/2, h, i, h - i*h/w, TFT_BLUE); 
-    delay(30);
-    lcd.drawTriangle(w/2, 0, w, h/2, w-i, i*h/w, TFT_BLUE);  
-    delay(30);
-    lcd.drawTriangle(w, h/2, w/2, h, w-i, h - i*h/w, TFT_RED); 
-    delay(30);
-    
+    snprintf(s, sizeof(s), "%s  cached", preset.name);
+    lcd.drawString(s, 4, lcd.height() - lcd.fontHeight() - 2);
   }
+  else if (ifs.begin(preset.maps, preset.nbrMaps, preset.isDensity ? &densityPalette() : nullptr))
+  {
+    const IFSStats &stats = ifs.run(preset.points, isAborted);
+    ifs.end();
+    if (stats.points == preset.points) screenCache.store(key);
+    Serial.printf("%s: %u points in %u ms, %u points/s\n", preset.name, stats.points, stats.msRun, stats.pointsPerSec);
+    snprintf(s, sizeof(s), "%s  %u points/s", preset.name, stats.pointsPerSec);
+    lcd.drawString(s, 4, lcd.height() - lcd.fontHeight() - 2);
+  }
+  lcd.setRotation(savedRot);
 }
 
-// Fraktales Sierpinsky-Dreieck
-// 1) Wähle einen beliebigen Anfangspunkt, hier P(20,20)
-// 2) Wähle zufällig eine Ecke, markiere die Mitte der Strecke P-Ecke
-// 3) Die Mitte wird zum neuen Punkt P
-// 4) Wiederhole ab 3)
+/**
+ * Fractal Sierpinsky triangle, the chaos game with three maps
+ * halving the distance to one of the corners
+*/
 void showSierpinskyTriangle()
 {
-  //int ecke[3][2] = {{0,0}, {159,0}, {79,127}};
-  int ecke[3][2] = {{0,0}, {lcd.width(), 0}, {lcd.width()/2, lcd.height()}};
-  int farbe[] = {TFT_RED, TFT_GREEN, TFT_BLUE};
-  int p[] = {20,20};
-  int k, x, y, mx, my;
-  
-  lcd.fillScreen(TFT_BLACK);
-  for(int i = 0; i < 20000; i++)
-  {
-    k = random(0,3);
-    x = ecke[k][0];
-    y = ecke[k][1];
-    mx = (x-p[0])/2 + p[0]; 
-    my = (y-p[1])/2 + p[1];
-    lcd.drawPixel(mx, my, farbe[k]);
-    p[0] = mx;
-    p[1] = my;
-    delayMicroseconds(1000);
-    if (lcd.getTouch(&x, &y)) break;
-  }
-  lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_YELLOW);
+  renderIFS(sierpinskyPreset);
 }
 
 // Mandelbrot-Apfelmännchen darstellen
+// Tap zooms in at the touched point, swipe pans by half a screen,
+// a long click zooms out or ends the action at the initial view.
+// Each view is rendered progressively and a new gesture interrupts it.
 void showMandelbrotSet()
 {
   uint8_t savedRot = lcd.getRotation();
+  TouchHandler touch(lcd);
+  bool isRunning = true;
+  char s[48];
+
   lcd.setRotation(1);
-  int maxIteration = 1000;
-  int w = lcd.width();
-  int h = lcd.height();
-  unsigned int farbe;
-  lcd.fillScreen(TFT_WHITE);
+  beginGestures(touch);
+  mandelbrot.setPalette(&fractalPalette());
+  mandelbrot.setView(0.0, 0.0, 4.0, 4.0);
+  mandelbrot.setAbortCb(isGesturePending);
 
-  for(int zeile = 0; zeile < h; zeile++)
+  while (isRunning)
   {
-    for(int spalte = 0; spalte < w; spalte++)
+    // more detail needs more iterations
+    mandelbrot.setMaxIteration(constrain(1000 + 500 * log2(mandelbrot.getZoom()), 1000.0, 8000.0));
+    double view[5];
+    mandelbrot.getView(view[0], view[1], view[2], view[3]);
+    view[4] = mandelbrot.getMaxIteration();
+    uint32_t key = ScreenCache::makeKey("Mandelbrot Set", view, sizeof(view));
+    bool isCached = screenCache.restore(key);
+    if (isCached || mandelbrot.renderProgressive())
     {
-      float c_re = (spalte - w/2.0) * 4.0 / w;
-      float c_im = (zeile- h/2.0) * 4.0 / h;
-      float x = 0;
-      float y = 0;
-      int iteration = 0;
-      while (x*x + y*y <=4 && iteration < maxIteration)
-      {
-        float x_neu = x*x - y*y + c_re;
-        y = 2*x*y + c_im;
-        x = x_neu;
-        iteration++;
-      }
-      if (iteration < maxIteration)
-      {
-        if (iteration < nbrTFTcolors) farbe = TFTcolor[iteration];
-        else farbe = TFT_WHITE;
-        lcd.drawPixel(spalte, zeile, farbe);
-      }
-      else
-          lcd.drawPixel(spalte, zeile, TFT_BLACK);
+      if (! isCached) screenCache.store(key);   // without the frame and the text
+      lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_BLUE);
+      if (isCached) snprintf(s, sizeof(s), "zoom %.0f  it %u  cached", mandelbrot.getZoom(), mandelbrot.getMaxIteration());
+      else          snprintf(s, sizeof(s), "zoom %.0f  it %u  %u ms", mandelbrot.getZoom(), mandelbrot.getMaxIteration(), mandelbrot.getMsRender());
+      lcd.setTextFont(2);
+      lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+      lcd.drawString(s, 4, lcd.height() - lcd.fontHeight() - 2);
+    }
+
+    switch (waitForGesture())
+    {
+      case TAP:         mandelbrot.zoom(gestureX, gestureY, 2.0); break;
+      case SWIPE_LEFT:  mandelbrot.pan(-lcd.width() / 2, 0); break;
+      case SWIPE_RIGHT: mandelbrot.pan( lcd.width() / 2, 0); break;
+      case SWIPE_UP:    mandelbrot.pan(0, -lcd.height() / 2); break;
+      case SWIPE_DOWN:  mandelbrot.pan(0,  lcd.height() / 2); break;
+      case HOLD:
+        if (mandelbrot.getZoom() > 1.0) mandelbrot.zoom(lcd.width() / 2, lcd.height() / 2, 0.5);
+        else isRunning = false;
+      break;
+      default: break;
     }
   }
-  lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_BLUE);
+  mandelbrot.setAbortCb(nullptr);
+  gestureTouch = nullptr;
+  screenCache.printStats();
   lcd.setRotation(savedRot);
 }
 
 /**
- * Draws a self-similar fractal known as Barnsleys Fern
- * https://en.wikipedia.org/wiki/Barnsley_fern
+ * Renders Mandelbrot set, a Julia set and the Burning Ship with the 
+ * Mariani-Silver subdivision of the class EscapeTime. Each fractal is 
+ * rendered brute force first, then subdivided, and the costs of both 
+ * are compared. A tap shows the next fractal.
 */
-void showBarnsleyFern() 
+void showEscapeTimeFractals()
 {
-  float x = 0;
-  float y = 0;
+  struct Preset { const char *name; EscapeKernel kernel; double cRe, cIm, reCenter, imCenter, reWidth, imHeight; };
+  static const Preset presets[] =
+  {
+    {"Mandelbrot",   EscapeTime::mandelbrot,   0.0,    0.0,    -0.5,  0.0, 3.2, 2.4},
+    {"Julia",        EscapeTime::julia,       -0.8,    0.156,   0.0,  0.0, 3.2, 2.4},
+    {"Julia",        EscapeTime::julia,        0.285,  0.01,    0.0,  0.0, 3.2, 2.4},
+    {"Burning Ship", EscapeTime::burningShip,  0.0,    0.0,    -0.4, -0.6, 3.2, 2.4},
+  };
   uint8_t savedRot = lcd.getRotation();
-  lcd.setRotation(2);
+  TouchHandler touch(lcd);
+  EscapeTime fractal(lcd);
+  char s[64];
 
-  lcd.fillScreen(TFT_BLACK);
-
-  for (unsigned int i = 0; i < 32000; i++) 
+  lcd.setRotation(1);
+  beginGestures(touch);
+  fractal.setPalette(&fractalPalette());
+  fractal.setMaxIteration(1000);
+  for (const Preset &p : presets)
   {
-    float xt = 0;
-    float yt = 0;
- 
-    int r = random(0, 100);
- 
-    if (r <= 1) 
-    {
-      xt = 0;
-      yt = 0.16*y;
-    } else if (r <= 8) 
-    {
-      xt = 0.20*x - 0.26*y;
-      yt = 0.23*x + 0.22*y + 1.60;
-    } else if (r <= 15) 
-    {
-      xt = -0.15*x + 0.28*y;
-      yt =  0.26*x + 0.24*y + 0.44;
-    } else 
-    {
-      xt =  0.85*x + 0.04*y;
-      yt = -0.04*x + 0.85*y + 1.60;
-    }
- 
-    x = xt;
-    y = yt;
- 
-    int m = round(lcd.width()/2 + 30*x);
-    int n = lcd.height()-round(30*y);
- 
-    lcd.drawPixel(m, n, TFT_GREEN);
+    fractal.setKernel(p.kernel, p.cRe, p.cIm);
+    fractal.setView(p.reCenter, p.imCenter, p.reWidth, p.imHeight);
+    EscapeStats brute = fractal.renderBruteForce();
+    EscapeStats sub   = fractal.renderSubdivided();
+    Serial.printf(R"(
+%s c = %.3f %+.3fi
+                  brute force   subdivided
+pixels            %11u  %11u
+iterations        %11u  %11u
+SPI bytes         %11u  %11u
+time [ms]         %11u  %11u
+)", p.name, p.cRe, p.cIm, brute.pixels, sub.pixels, brute.iterations, sub.iterations,
+    brute.spiBytes, sub.spiBytes, brute.msRender, sub.msRender);
+
+    lcd.setTextFont(2);
+    lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+    snprintf(s, sizeof(s), "%s  %u ms / %u ms", p.name, sub.msRender, brute.msRender);
+    lcd.drawString(s, 4, lcd.height() - 2 * lcd.fontHeight() - 2);
+    snprintf(s, sizeof(s), "iterations %u%%", (uint32_t)(100ULL * sub.iterations / max(brute.iterations, (uint32_t)1)));
+    lcd.drawString(s, 4, lcd.height() - lcd.fontHeight() - 2);
+    if (waitForGesture() == HOLD) break;  // long click ends the action
   }
-  lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_GREEN);
+  gestureTouch = nullptr;
   lcd.setRotation(savedRot);
 }
 
 /**
- * Randomly move from the center of the display to
- * one of the 8 neighboring pixels or rest in place.
+ * Draws a self-similar fractal known as Barnsleys Fern
+ * https://en.wikipedia.org/wiki/Barnsley_fern
 */
-void showRandomWalk()
+void showBarnsleyFern() 
 {
-  int x = lcd.width()/2;
-  int y = lcd.height()/2;
-  int color = TFTcolor[random(0,24)];
+  renderIFS(fernPreset);
+}
 
-  lcd.fillScreen(TFT_BLACK);
-  
-  for(int i = 0; i < 32000; i++)
+/**
+ * Cycles through the Heighway dragon, the Koch curve and a maple
+ * leaf. A tap shows the next fractal, a long click ends the action.
+*/
+void showIFSFractals()
+{
+  TouchHandler touch(lcd);
+  bool isRunning = true;
+
+  beginGestures(touch);
+  for (int i = 0; isRunning; i = (i + 1) % (sizeof(ifsPresets) / sizeof(ifsPresets[0])))
   {
-    x += random(0, 3) - 1;  // 0, 1, 2 ==> -1, 0, 1
-    y += random(0, 3) - 1;
-    if (x >= 0 && x < lcd.width() && y >= 0 && y < lcd.height())
-      { 
-        if (i % 500 == 0) color = TFTcolor[random(0,24)]; // change the color after every 500 steps
-        lcd.drawPixel(x, y, color); 
-      }
-    delayMicroseconds(200); // slow down the walk
-    if (lcd.getTouch(&x, &y)) break;
+    renderIFS(ifsPresets[i], isGesturePending);
+    isRunning = waitForGesture() != HOLD;
   }
-  lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_GREEN);
+  gestureTouch = nullptr;
+}
+
+/**
+ * Many walkers start in the center of the display and move
+ * to one of the 8 neighboring pixels in each step. The visits 
+ * are counted in a density map, which is shown after every 
+ * frame. A touch ends the walk.
+*/
+void showRandomWalk()
+{
+  RandomWalk walk(lcd);
+  char s[48];
+
+  if (! walk.begin(2000, densityPalette())) return;
+  const WalkStats &stats = walk.run(10000, 128, isTouched);
+  walk.end();
+  Serial.printf(R"(
+Random walk, 2000 walkers
+frames            %8u
+steps             %8llu
+steps/s           %8u
+step time [ms]    %8u
+flush time [ms]   %8u
+)", stats.frames, stats.steps, stats.stepsPerSec, stats.msStep, stats.msFlush);
+
+  lcd.setTextFont(2);
+  lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+  snprintf(s, sizeof(s), "%u steps/s", stats.stepsPerSec);
+  lcd.drawString(s, 4, lcd.height() - lcd.fontHeight() - 2);
 }
 
 
@@ -605,18 +900,23 @@ void showTFTcolors()
 // Display HSV color circle as a polygon with 360°/alpha sides.
 // The color value (H = Hue) changes from 0 ... 360° in steps of alpha°.
 // Saturation S and brightness (V = Value) are set to 1.0, the maximum.
+// The polygon is drawn into an 8 bit IndexedFrame, one palette index per
+// side, and appears at once. Without the memory it is drawn directly.
 void showHSVcircle()
 {
   constexpr float DEGTORAD = PI/180;
+  constexpr uint8_t BORDER = 255;   // palette index of the frame
   int xm = lcd.width() / 2;
   int ym = lcd.height() /2;
   int xA, yA, xB, yB;
   int alpha = 3; // Change to vary the number of sides of the color polygon
   uint16_t radius = lcd.height() > lcd.width() ? lcd.width()/2 - 10 : lcd.height()/2 -10;
-  uint8_t R, G, B;
   uint16_t color16;
+  IndexedFrame frame(lcd);
+  bool isFramed = frame.begin(8);
+  lgfx::LovyanGFX &gfx = isFramed ? (lgfx::LovyanGFX &)frame.canvas() : (lgfx::LovyanGFX &)lcd;
   
-  lcd.fillScreen(TFT_BLACK);
+  gfx.fillScreen(TFT_BLACK);   // index 0 is black as well
   for( int phi = 0; phi < 360; phi += alpha)
   {
     xA = xm + radius * sin(DEGTORAD * phi);
@@ -624,36 +924,83 @@ void showHSVcircle()
     xB = xm + radius * sin(DEGTORAD * (phi+alpha));
     yB = ym + radius * cos(DEGTORAD * (phi+alpha)); 
 
-    color16 = HSVtoRGB(R, G, B, phi, 0.9, 0.9);
-    lcd.fillTriangle(xm, ym, xA, yA, xB, yB, color16); 
+    color16 = hsvToRgb565(hueFromDegrees(phi), 230, 230);
+    if (isFramed)
+    {
+      frame.setColor(1 + phi / alpha, color16);
+      color16 = 1 + phi / alpha;
+    }
+    gfx.fillTriangle(xm, ym, xA, yA, xB, yB, color16); 
+  }
+  if (isFramed) frame.setColor(BORDER, TFT_BLUE);
+  gfx.drawRect(0, 0, lcd.width(), lcd.height(), isFramed ? BORDER : TFT_BLUE);
+  if (isFramed)
+  {
+    frame.push();
+    frame.end();
   }
-  lcd.drawRect(0, 0, lcd.width(), lcd.height(), TFT_BLUE);
 }
 
-void showHSVcoloredScreen()
+/**
+ * StripRenderer of the gradients, the context holds the 4 dithered rows
+*/
+static void renderGradientStrip(void *context, uint16_t *strip, int y0, int rows)
 {
-  uint8_t R, G, B; 
-  uint16_t color16;
-  lcd.fillScreen(TFT_BLACK);
-  delay(500);
+  const uint16_t *lines = (const uint16_t *)context;
+  int w = lcd.width();
+  for (int r = 0; r < rows; r++) memcpy(strip + r * w, lines + ((y0 + r) & 3) * w, w * sizeof(uint16_t));
+}
+
+/**
+ * Push a full screen gradient, the color depends on the column only.
+ * The row is dithered for the 4 phases of the Bayer matrix, so the 
+ * screen needs 4 conversions. The rows are copied into strips of
+ * 8 rows, each sent with one DMA transfer.
+*/
+static void pushDitheredGradient(const uint32_t *rgb888)
+{
+  int w = lcd.width();
+  uint16_t *lines = (uint16_t *)malloc(4 * w * sizeof(uint16_t));
+  StripPipeline pipeline(lcd);
 
-  for (int phi = 0; phi < lcd.width(); phi++) 
+  if (lines == nullptr || ! pipeline.begin(8, 2, false))
   {
-    color16 = HSVtoRGB(R, G, B, phi, 0.9, 0.9);
-    lcd.drawFastVLine(phi, 0, lcd.height(), color16);
+    free(lines);
+    return;
   }
+  for (int y = 0; y < 4; y++) ditherToRgb565(rgb888, lines + y * w, w, y, true);
+  pipeline.run(renderGradientStrip, lines);
+  pipeline.printStats("Gradient");
+  pipeline.end();
+  free(lines);
+}
+
+/**
+ * Hue from 0° to 320° over the width of the display
+*/
+void showHSVcoloredScreen()
+{
+  int w = lcd.width();
+  uint32_t *rgb888 = (uint32_t *)malloc(w * sizeof(uint32_t));
+
+  lcd.fillScreen(TFT_BLACK);
+  delay(500);
+  if (rgb888 == nullptr) return;
+  for (int phi = 0; phi < w; phi++) rgb888[phi] = hsvToRgb888(hueFromDegrees(phi), 230, 230);
+  pushDitheredGradient(rgb888);
+  free(rgb888);
 }
 
 void showGrayScale()
 {
-  uint16_t g, color16;
+  int w = lcd.width();
+  uint32_t *rgb888 = (uint32_t *)malloc(w * sizeof(uint32_t));
+
   lcd.fillScreen(TFT_BLACK);
-  for (int i = 0; i < lcd.width(); i++)
-  {
-    g = i * 255 / lcd.width();
-    color16 = lcd.color565(g, g, g);
-    lcd.drawFastVLine(i, 0, lcd.height(), color16);
-  }
+  if (rgb888 == nullptr) return;
+  for (int i = 0; i < w; i++) rgb888[i] = (i * 255 / w) * 0x010101;
+  pushDitheredGradient(rgb888);
+  free(rgb888);
 }
 
 // Zeigt die Zeit digital an
@@ -696,4 +1043,136 @@ void showAnalogClock()
   lcd.setRotation(savedRot);
   lcd.setTextSize(savedSize);
   lcd.setFont(savedFont);
-}
\ No newline at end of file
+}
+
+
+// Shows the cached results of the background WiFi scan,
+// the list is redrawn after every completed scan
+void showNearbyNetworks()
+{
+  uint8_t savedRot  = lcd.getRotation();
+  const lgfx::v1::IFont  *savedFont = lcd.getFont();
+  uint32_t shownScanCount = wifiScanner.getScanCount() - 1;  // force the first draw
+  bool     shownScanning  = ! wifiScanner.isScanning();
+  int x, y;
+  char s[48];
+
+  lcd.setRotation(1);
+  lcd.fillScreen(TFT_BLACK);
+  lcd.setTextFont(2);
+  lcd.setTextSize(1);
+
+  while (! lcd.getTouch(&x, &y))
+  {
+    wifiScanner.loop();  // keeps the scan going, never blocks
+    if (wifiScanner.getScanCount() != shownScanCount)
+    {
+      shownScanCount = wifiScanner.getScanCount();
+      lcd.fillRect(0, 0, lcd.width(), lcd.height() - lcd.fontHeight(), TFT_BLACK);
+      lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
+      lcd.drawString("SSID", 0, 0);
+      lcd.drawString("dBm   ch  auth", 220, 0);
+      lcd.setTextColor(TFT_GREEN, TFT_BLACK);
+      y = lcd.fontHeight();
+      for (int i = 0; i < wifiScanner.getNbrNetworks() && y < lcd.height() - 2 * lcd.fontHeight(); i++)
+      {
+        const NetworkInfo &net = wifiScanner.getNetwork(i);
+        snprintf(s, sizeof(s), "%.26s", net.ssid[0] ? net.ssid : "<hidden>");
+        lcd.drawString(s, 0, y);
+        snprintf(s, sizeof(s), "%4d  %2d  %s", net.rssi, net.channel, WiFiScanner::authName(net.auth));
+        lcd.drawString(s, 220, y);
+        y += lcd.fontHeight();
+      }
+      shownScanning = ! wifiScanner.isScanning();
+    }
+    if (wifiScanner.isScanning() != shownScanning)
+    { // status line at the bottom
+      shownScanning = wifiScanner.isScanning();
+      snprintf(s, sizeof(s), "%d networks, %s", wifiScanner.getNbrNetworks(), shownScanning ? "scanning ...  " : "scan done     ");
+      lcd.setTextColor(TFT_SKYBLUE, TFT_BLACK);
+      lcd.drawString(s, 0, lcd.height() - lcd.fontHeight());
+    }
+    delay(10);
+  }
+
+  lcd.setRotation(savedRot);
+  lcd.setFont(savedFont);
+}
+
+/**
+ * Measures the drawing primitives of the panel, shows the 
+ * results and prints them as CSV
+*/
+void showBenchmark()
+{
+  uint8_t savedRot = lcd.getRotation();
+  Benchmark<LGFX> benchmark(lcd);
+
+  lcd.setRotation(1);
+  benchmark.run();
+  printBenchCsv(benchmark.getResults(), benchmark.getNbrResults());
+  benchmark.showResults();
+  lcd.setRotation(savedRot);
+}
+
+
+// Steps the SPI write clock through the divisors of 80 MHz, verifies
+// each step by readback and stores the fastest safe clock in NVS
+void showSpiTuning()
+{
+  uint8_t savedRot = lcd.getRotation();
+  const lgfx::v1::IFont *savedFont = lcd.getFont();
+
+  lcd.setRotation(1);
+  spiTuner.tune();
+  spiTuner.printSteps();
+  spiTuner.showSteps();
+  lcd.setRotation(savedRot);
+  lcd.setFont(savedFont);
+}
+
+
+/**
+ * Shows the .qoi and .rle images of the directory /images on the
+ * SD card one after the other and prints the read and decode times
+ * of each image. A tap shows the next image, a long click ends.
+*/
+void showSdImages()
+{
+  uint8_t savedRot = lcd.getRotation();
+  TouchHandler touch(lcd);
+  SdImages images(lcd);
+  char path[64];
+  int nbrShown = 0;
+  bool isRunning = true;
+
+  lcd.setRotation(1);
+  lcd.fillScreen(TFT_BLACK);
+  beginGestures(touch);
+  if (images.begin() && images.openDir("/images"))
+  {
+    while (isRunning)
+    {
+      if (! images.nextImage(path, sizeof(path)))
+      { // start over
+        if (nbrShown == 0 || ! images.openDir("/images")) break;
+        continue;
+      }
+      ShowResult result = images.show(path, isGesturePending);
+      if (result == IMAGE_FAILED) continue;
+      if (result == IMAGE_SHOWN) images.printStats(path);
+      nbrShown++;
+      isRunning = waitForGesture() != HOLD;    // consumes the gesture which aborted show()
+    }
+  }
+  images.end();
+  if (nbrShown == 0)
+  {
+    lcd.setTextFont(2);
+    lcd.setTextColor(TFT_WHITE, TFT_BLACK);
+    lcd.drawString("No images in /images on the SD card", 4, 4);
+    waitForGesture();
+  }
+  gestureTouch = nullptr;
+  lcd.setRotation(savedRot);
+}
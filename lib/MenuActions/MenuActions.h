@@ -7,6 +7,23 @@
 #include <Arduino.h>
 #include "DigitalClock.h"
 #include "AnalogClock.h"
+#include "WiFiScanner.h"
+#include "Mandelbrot.h"
+#include "EscapeTime.h"
+#include "IFS.h"
+#include "DensityMap.h"
+#include "RandomWalk.h"
+#include "PiSpigot.h"
+#include "ColorConv.h"
+#include "DisplayList.h"
+#include "FrameScheduler.h"
+#include "Benchmark.h"
+#include "SpiTuner.h"
+#include "StripPipeline.h"
+#include "IndexedFrame.h"
+#include "ScreenCache.h"
+#include "SdImages.h"
+#include "ScreenCapture.h"
 
 uint16_t HSVtoRGB( uint8_t &R, uint8_t &G, uint8_t &B, float h, float s, float v );
 uint16_t rgbToColor565(float r, float g, float b, uint8_t &R, uint8_t &G, uint8_t &B);
@@ -23,7 +40,9 @@ void showFilledColorCircles();
 void showColoredTriangles();
 void showSierpinskyTriangle();
 void showMandelbrotSet();
+void showEscapeTimeFractals();
 void showBarnsleyFern();
+void showIFSFractals();
 void showRandomWalk();
 void showTFTcolors();
 void showHSVcircle();
@@ -31,6 +50,10 @@ void showHSVcoloredScreen();
 void showGrayScale();
 void showDigitalClock();
 void showAnalogClock();
+void showNearbyNetworks();
+void showBenchmark();
+void showSpiTuning();
+void showSdImages();
 
 
 
@@ -0,0 +1,90 @@
+/**
+ * Class        Palette
+ * 
+ * Purpose      Implements a class Palette which precomputes a table of SIZE rgb565
+ *              colors from a list of HSV gradient stops. Between two stops h, s and 
+ *              v are interpolated linearly and converted with HSVtoRGB(). The table
+ *              is built once, afterwards a color costs one lookup and no float math.
+ *              The index wraps around, which gives cyclic palettes for the smooth 
+ *              coloring of fractals.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      fractalPalette() and densityPalette() build the shared palettes on 
+ *              the first call.
+ * References   https://en.wikipedia.org/wiki/Plotting_algorithms_for_the_Mandelbrot_set#Continuous_(smooth)_coloring
+ */
+#include "Palette.h"
+
+extern uint16_t HSVtoRGB(uint8_t &R, uint8_t &G, uint8_t &B, float h, float s, float v);
+
+/**
+ * Interpolate the stops, which must be sorted by pos and 
+ * start at 0.0. Two stops at the same position give a hard
+ * change. The last stop should equal the first one for a 
+ * seamless cyclic palette.
+*/
+void Palette::build(const HSVStop *stops, int nbrStops)
+{
+  uint8_t R, G, B;
+  int k = 0;
+
+  for (int i = 0; i < SIZE; i++)
+  {
+    float pos = (float)i / SIZE;
+    while (k < nbrStops - 2 && pos >= stops[k + 1].pos) k++;
+    const HSVStop &a = stops[k];
+    const HSVStop &b = stops[min(k + 1, nbrStops - 1)];
+    float t = b.pos > a.pos ? constrain((pos - a.pos) / (b.pos - a.pos), 0.0f, 1.0f) : 0.0f;
+    float h = fmodf(a.h + t * (b.h - a.h), 360.0f);
+    float s = a.s + t * (b.s - a.s);
+    float v = a.v + t * (b.v - a.v);
+    uint16_t c = HSVtoRGB(R, G, B, h, s, v);
+    _colors[i] = (c >> 8) | (c << 8);
+  }
+}
+
+/**
+ * Dark blue over cyan and white to orange and back
+*/
+const Palette &fractalPalette()
+{
+  static Palette palette;
+  static bool isBuilt = false;
+  static const HSVStop stops[] =
+  {
+    {0.00f, 240.0f, 1.00f, 0.40f},
+    {0.16f, 210.0f, 0.80f, 0.80f},
+    {0.42f, 210.0f, 0.00f, 1.00f},   // white, the hue jumps
+    {0.42f, 400.0f, 0.00f, 1.00f},
+    {0.64f, 400.0f, 1.00f, 1.00f},   // 40°, orange
+    {0.86f, 360.0f, 1.00f, 0.30f},
+    {1.00f, 240.0f, 1.00f, 0.40f},
+  };
+
+  if (! isBuilt)
+  {
+    palette.build(stops, sizeof(stops) / sizeof(stops[0]));
+    isBuilt = true;
+  }
+  return palette;
+}
+
+const Palette &densityPalette()
+{
+  static Palette palette;
+  static bool isBuilt = false;
+  static const HSVStop stops[] =
+  {
+    {0.00f, 250.0f, 1.00f, 0.35f},   // dark blue for rare hits
+    {0.40f, 360.0f, 1.00f, 0.90f},   // red
+    {0.75f, 420.0f, 1.00f, 1.00f},   // 60°, yellow
+    {1.00f, 420.0f, 0.00f, 1.00f},   // white
+  };
+
+  if (! isBuilt)
+  {
+    palette.build(stops, sizeof(stops) / sizeof(stops[0]));
+    isBuilt = true;
+  }
+  return palette;
+}
@@ -0,0 +1,34 @@
+/**
+ * Palette.h
+ * 
+ * Declaration of the class Palette, a lookup table of SIZE rgb565 colors
+ * built from HSV gradients. The colors are stored byte swapped, in the
+ * byte order of the panel, so they can be written into line buffers for 
+ * pushImage() directly. fractalPalette() returns the palette shared by
+ * the fractal actions, densityPalette() the one of the density maps.
+ */ 
+#pragma once
+#include <Arduino.h>
+
+struct HSVStop 
+{ 
+  float pos;      // 0.0 .. 1.0 position in the palette
+  float h, s, v;  // hue in degrees (may exceed 360 to wrap around), saturation, value
+};
+
+class Palette
+{
+  public:
+    static constexpr int SIZE = 1024;
+
+    void build(const HSVStop *stops, int nbrStops);
+    uint16_t swapped(int i) const { return _colors[i & (SIZE - 1)]; }
+    uint16_t rgb565(int i) const  { uint16_t c = _colors[i & (SIZE - 1)]; return (c >> 8) | (c << 8); }
+    const uint16_t *getColors() const { return _colors; }
+
+  private:
+    uint16_t _colors[SIZE];
+};
+
+const Palette &fractalPalette();
+const Palette &densityPalette();
@@ -0,0 +1,187 @@
+/**
+ * Class        PiSpigot
+ * 
+ * Purpose      Implements a class PiSpigot which streams the decimal digits of pi.
+ *              The spigot algorithm of Dik Winter holds the series 
+ *              pi = 2 * (1 + 1/3 * (1 + 2/5 * (1 + 3/7 * (...)))) as an array of
+ *              remainders, one per term, in base 10000. Each pass runs from 
+ *              the last term down to the first, carries d * b / (2b - 1) to the 
+ *              next lower term and produces 4 digits. 14 terms are dropped per 
+ *              pass, because each term gives log10(4) = 0.3 digits.
+ *              - The carry of a pass only flows from higher to lower terms and
+ *                each pass starts at the highest term with carry 0. So a worker
+ *                task on core 0 computes the high terms and sends the carry 
+ *                through a queue to the calling task, which computes the low 
+ *                terms of the same pass, while the worker starts the next one.
+ *              - A pass touches fewer high terms each time. With the split at
+ *                c0 * (1 - 1/sqrt(2)) both cores get the same total work.
+ *              - The two parts are separate allocations, so 10000 digits need
+ *                about 99 kB and 41 kB instead of a block of 140 kB.
+ *              - The working memory uses uint32_t, the carries stay below 
+ *                2^32 up to MAX_DIGITS.
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      A group can exceed 9999. The carry is added to the group held
+ *              back, so the callback always gets final digits. Groups of 9999
+ *              following it are held back as well, a carry turns them into
+ *              0000 and goes on to the group before them.
+ * References   https://crypto.stanford.edu/pbc/notes/pi/code.html
+ *              Rabinowitz, Wagon: A Spigot Algorithm for the Digits of Pi, 
+ *              American Mathematical Monthly 102 (1995)
+ */
+#include "PiSpigot.h"
+
+static constexpr uint32_t BASE = 10000;
+static constexpr uint32_t TERMS_PER_PASS = 14;
+static constexpr int      QUEUE_LENGTH = 8;
+static constexpr uint32_t WORKER_DONE = UINT32_MAX;   // last message of the worker, no carry
+
+/**
+ * Allocate the working memory for nbrDigits digits, fewer if there 
+ * is not enough memory. Returns false if not even 100 digits fit.
+*/
+bool PiSpigot::begin(uint32_t nbrDigits)
+{
+  _nbrDigits = constrain(nbrDigits, (uint32_t)4, MAX_DIGITS);
+  while (true)
+  {
+    _nbrDigits = (_nbrDigits + 3) / 4 * 4;
+    _c0    = _nbrDigits / 4 * TERMS_PER_PASS;
+    _split = _c0 * 293 / 1000;     // 1 - 1/sqrt(2)
+    _fLow  = (uint32_t *)malloc(_split * sizeof(uint32_t));
+    _fHigh = (uint32_t *)malloc((_c0 + 1 - _split) * sizeof(uint32_t));
+    if (_fLow != nullptr && _fHigh != nullptr) break;
+    end();
+    if (_nbrDigits <= 100) 
+    {
+      log_e("Not enough memory for %u digits of pi", _nbrDigits);
+      return false;
+    }
+    _nbrDigits /= 2;
+  }
+  for (uint32_t b = 0; b < _split; b++) _fLow[b] = BASE / 5;
+  for (uint32_t b = _split; b <= _c0; b++) _fHigh[b - _split] = BASE / 5;
+  log_i("Pi: %u digits, %u terms", _nbrDigits, _c0);
+  return true;
+}
+
+void PiSpigot::end()
+{
+  free(_fLow);  _fLow = nullptr;
+  free(_fHigh); _fHigh = nullptr;
+}
+
+/**
+ * Computes the terms _split .. c of every pass on core 0, 
+ * the carry into the lower terms is sent to the queue,
+ * followed by WORKER_DONE when it stops
+*/
+void PiSpigot::workerTask(void *arg)
+{
+  PiSpigot *p = (PiSpigot *)arg;
+  uint32_t *f = p->_fHigh - p->_split;
+
+  for (uint32_t c = p->_c0; c > 0 && ! p->_stop; c -= TERMS_PER_PASS)
+  {
+    uint32_t d = 0;
+    for (uint32_t b = c; b >= p->_split && b > 0; b--)
+    {
+      d = d * b + f[b] * BASE;
+      f[b] = d % (2 * b - 1);
+      d /= 2 * b - 1;
+    }
+    xQueueSend(p->_carries, &d, portMAX_DELAY);
+  }
+  uint32_t done = WORKER_DONE;
+  xQueueSend(p->_carries, &done, portMAX_DELAY);
+  vTaskDelete(NULL);
+}
+
+/**
+ * Compute the digits, the lower terms of each pass are computed
+ * on the calling core
+*/
+const PiStats &PiSpigot::run(DigitsCallback cb)
+{
+  uint32_t msStart = millis();
+  uint32_t *f = _fLow;
+  uint32_t e = 0;
+  int32_t  heldBack = -1;     // previous group below 9999, until the next one is known
+  uint32_t nbrNines = 0;      // groups of 9999 held back after it
+  char     digits[8];
+
+  _stats = {};
+  _stop = false;
+  _carries = xQueueCreate(QUEUE_LENGTH, sizeof(uint32_t));
+  xTaskCreatePinnedToCore(workerTask, "piSpigot", 2048, this, tskIDLE_PRIORITY, &_workerTask, 0);
+
+  auto emit = [&](uint32_t group) -> bool
+  {
+    snprintf(digits, sizeof(digits), "%04u", group);
+    _stats.digits += 4;
+    return cb(digits, _stats.digits);
+  };
+  // Emit the groups held back, the 9999 groups as fill. With keepLast
+  // the last of them stays held back in front of a new 9999 group.
+  auto release = [&](uint32_t fill, bool keepLast) -> bool
+  {
+    if (keepLast && nbrNines == 0) return true;
+    if (heldBack >= 0 && ! emit(heldBack)) return false;
+    for (; nbrNines > (keepLast ? 1 : 0); nbrNines--)
+    {
+      if (! emit(fill)) return false;
+    }
+    if (keepLast) heldBack = fill;
+    nbrNines = 0;
+    return true;
+  };
+
+  for (uint32_t c = _c0; c > 0; c -= TERMS_PER_PASS)
+  {
+    uint32_t d;
+    xQueueReceive(_carries, &d, portMAX_DELAY);
+    for (uint32_t b = min(c, _split - 1); b > 0; b--)
+    {
+      d = d * b + f[b] * BASE;
+      f[b] = d % (2 * b - 1);
+      d /= 2 * b - 1;
+    }
+    uint32_t group = e + d / BASE;
+    e = d % BASE;
+    uint32_t fill = BASE - 1;
+    if (group >= BASE)
+    { // carry through the 9999 groups held back
+      group -= BASE;
+      heldBack++;
+      fill = 0;
+    }
+    else if (group == BASE - 1)
+    {
+      nbrNines++;
+      continue;
+    }
+    bool isNines = group == BASE - 1;
+    if (! release(fill, isNines))
+    {
+      _stop = true;
+      break;
+    }
+    if (isNines)
+      nbrNines = 1;
+    else
+      heldBack = group;
+  }
+  if (! _stop) release(BASE - 1, false);
+
+  uint32_t d;
+  do
+  { // release the worker if it waits for space in the queue
+    xQueueReceive(_carries, &d, portMAX_DELAY);
+  } while (d != WORKER_DONE);
+  _workerTask = nullptr;
+  vQueueDelete(_carries);
+  _stats.msRun = millis() - msStart;
+  _stats.digitsPerSec = (uint32_t)(1000ULL * _stats.digits / max(_stats.msRun, (uint32_t)1));
+  log_i("Pi: %u digits in %u ms, %u digits/s", _stats.digits, _stats.msRun, _stats.digitsPerSec);
+  return _stats;
+}
@@ -0,0 +1,50 @@
+/**
+ * PiSpigot.h
+ * 
+ * Declaration of the class PiSpigot, which computes the decimal digits 
+ * of pi with the base 10000 spigot algorithm of Dik Winter. The working 
+ * memory is allocated by begin() for the requested number of digits. 
+ * run() passes the digits in groups of 4 to a callback as soon as they 
+ * are known.
+ */ 
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Called with each group of 4 digits, the first group is "3141".
+ * Returns false to stop the computation.
+*/
+using DigitsCallback = bool (*)(const char *digits, uint32_t nbrDigits);
+
+struct PiStats
+{
+  uint32_t digits;
+  uint32_t msRun;
+  uint32_t digitsPerSec;
+};
+
+class PiSpigot
+{
+  public:
+    bool begin(uint32_t nbrDigits);
+    const PiStats &run(DigitsCallback cb);
+    void end();
+    uint32_t getNbrDigits() { return _nbrDigits; }
+
+    static constexpr uint32_t MAX_DIGITS = 10000;
+
+  private:
+    uint32_t _nbrDigits = 0;
+    uint32_t _c0;                   // number of terms of the series
+    uint32_t _split;                // terms _split .. _c0 belong to core 0
+    uint32_t *_fLow  = nullptr;     // remainders of the terms 0 .. _split-1
+    uint32_t *_fHigh = nullptr;     // remainders of the terms _split .. _c0
+    PiStats  _stats;
+
+    // Shared with the worker task on core 0
+    volatile bool _stop = false;
+    QueueHandle_t _carries = nullptr;  // carry into term _split-1 for each pass, then WORKER_DONE
+    TaskHandle_t  _workerTask = nullptr;
+
+    static void workerTask(void *arg);
+};
@@ -0,0 +1,162 @@
+/**
+ * Class        RandomWalk
+ * 
+ * Purpose      Implements a class RandomWalk which moves many walkers at the 
+ *              same time. Each step moves a walker to one of its 8 neighbors.
+ *              - The x and y positions are kept in separate uint16_t arrays,
+ *                the inner loop runs over consecutive walkers.
+ *              - A direction needs 3 bits, so one xorshift32 word gives the
+ *                directions of 10 walkers. The offsets -1, 0, +1 of the 8 
+ *                directions are packed with 2 bits each into a constant.
+ *              - The borders are handled with min() / max() instead of 
+ *                branches, a walker stays at the border until it moves away.
+ *              - The first half of the walkers is moved by the calling task,
+ *                the second half by a worker task on core 0. When both have
+ *                finished a frame, the density map is pushed as one batch.
+ *              The number of steps per second is reported. 
+ *             
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      Both cores increment the same counters without locking. If both
+ *              hit the same pixel at the same time, one visit can be lost, which 
+ *              doesn't matter for the picture.
+ * References   https://en.wikipedia.org/wiki/Random_walk
+ *              https://en.wikipedia.org/wiki/Xorshift
+ */
+#include "RandomWalk.h"
+
+// Offsets + 1 of the directions 0 .. 7, 2 bits each: 
+// dx = -1  0 +1 -1 +1 -1  0 +1
+// dy = -1 -1 -1  0  0 +1 +1 +1
+static constexpr uint32_t DX_PACKED = 0x9224;
+static constexpr uint32_t DY_PACKED = 0xA940;
+static constexpr int      DIRECTIONS_PER_WORD = 10;
+
+static inline uint32_t xorshift32(uint32_t &state) 
+{ 
+  state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; 
+}
+
+/**
+ * Allocate the walkers and place them in the center of the display.
+ * Returns false if there is not enough memory.
+*/
+bool RandomWalk::begin(int nbrWalkers, const Palette &palette)
+{
+  _nbrWalkers = constrain(nbrWalkers, 2, MAX_WALKERS);
+  _xMax = _lcd.width() - 1;
+  _yMax = _lcd.height() - 1;
+  _x = (uint16_t *)malloc(_nbrWalkers * sizeof(uint16_t));
+  _y = (uint16_t *)malloc(_nbrWalkers * sizeof(uint16_t));
+  if (_x == nullptr || _y == nullptr || ! _density.begin(palette))
+  {
+    log_e("Not enough memory for %d walkers", _nbrWalkers);
+    end();
+    return false;
+  }
+  for (int i = 0; i < _nbrWalkers; i++)
+  {
+    _x[i] = _lcd.width() / 2;
+    _y[i] = _lcd.height() / 2;
+  }
+
+  _stop = false;
+  _go   = xSemaphoreCreateBinary();
+  _done = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(workerTask, "randomWalk", 2048, this, tskIDLE_PRIORITY, &_workerTask, 0);
+  _lcd.fillScreen(TFT_BLACK);
+  return true;
+}
+
+void RandomWalk::end()
+{
+  if (_workerTask != nullptr)
+  {
+    _stop = true;
+    xSemaphoreGive(_go);
+    xSemaphoreTake(_done, portMAX_DELAY);  // the worker has left its loop
+    _workerTask = nullptr;
+  }
+  if (_go != nullptr)   { vSemaphoreDelete(_go);   _go = nullptr; }
+  if (_done != nullptr) { vSemaphoreDelete(_done); _done = nullptr; }
+  free(_x); _x = nullptr;
+  free(_y); _y = nullptr;
+  _density.end();
+}
+
+/**
+ * Move the walkers first .. last-1 nbrSteps times
+*/
+void IRAM_ATTR RandomWalk::step(int first, int last, uint32_t &rng, uint16_t nbrSteps)
+{
+  uint16_t *xs = _x, *ys = _y;
+  const int xMax = _xMax, yMax = _yMax;
+
+  for (uint16_t s = 0; s < nbrSteps; s++)
+  {
+    for (int i = first; i < last; )
+    {
+      uint32_t r = xorshift32(rng);
+      int groupEnd = min(i + DIRECTIONS_PER_WORD, last);
+      for ( ; i < groupEnd; i++, r >>= 3)
+      {
+        uint32_t shift = (r & 7) << 1;
+        int x = xs[i] + (int)((DX_PACKED >> shift) & 3) - 1;
+        int y = ys[i] + (int)((DY_PACKED >> shift) & 3) - 1;
+        x = min(max(x, 0), xMax);
+        y = min(max(y, 0), yMax);
+        xs[i] = x;
+        ys[i] = y;
+        _density.add(x, y);
+      }
+    }
+  }
+}
+
+/**
+ * Moves the second half of the walkers on core 0,
+ * one frame for each _go. Gives _done when it stops.
+*/
+void RandomWalk::workerTask(void *arg)
+{
+  RandomWalk *w = (RandomWalk *)arg;
+  while (true)
+  {
+    xSemaphoreTake(w->_go, portMAX_DELAY);
+    if (w->_stop) break;
+    w->step(w->_nbrWalkers / 2, w->_nbrWalkers, w->_rng[1], w->_stepsPerFrame);
+    xSemaphoreGive(w->_done);
+  }
+  xSemaphoreGive(w->_done);
+  vTaskDelete(NULL);
+}
+
+/**
+ * Run nbrFrames frames of stepsPerFrame steps for each walker,
+ * the abort callback is polled after every frame
+*/
+const WalkStats &RandomWalk::run(uint32_t nbrFrames, uint16_t stepsPerFrame, AbortCallback isAborted)
+{
+  uint32_t msStart = millis();
+
+  _stats = {};
+  _stepsPerFrame = stepsPerFrame;
+  while (_stats.frames < nbrFrames)
+  {
+    uint32_t ms = millis();
+    xSemaphoreGive(_go);
+    step(0, _nbrWalkers / 2, _rng[0], stepsPerFrame);
+    _stats.msStep += millis() - ms;
+    xSemaphoreTake(_done, portMAX_DELAY);
+
+    ms = millis();
+    _density.flush();
+    _stats.msFlush += millis() - ms;
+    _stats.frames++;
+    _stats.steps += (uint64_t)_nbrWalkers * stepsPerFrame;
+    if (isAborted != nullptr && isAborted()) break;
+  }
+  _stats.msRun = millis() - msStart;
+  _stats.stepsPerSec = (uint32_t)(1000ULL * _stats.steps / max(_stats.msRun, (uint32_t)1));
+  log_i("RandomWalk: %d walkers, %u frames, %u steps/s", _nbrWalkers, _stats.frames, _stats.stepsPerSec);
+  return _stats;
+}
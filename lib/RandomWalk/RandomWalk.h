@@ -0,0 +1,55 @@
+/**
+ * RandomWalk.h
+ * 
+ * Declaration of the class RandomWalk, a simulation of many independent
+ * random walkers. The positions are stored as structure of arrays, the
+ * walkers are split over both cores and their visits are counted in a
+ * DensityMap, which is pushed to the display once per frame. The 
+ * constructor needs a reference to the LGFX object.
+ */ 
+#pragma once
+#include "lgfx_ESP32_2432S028.h"
+#include "DensityMap.h"
+
+using AbortCallback = bool (*)();
+
+struct WalkStats
+{
+  uint32_t frames;
+  uint64_t steps;         // steps of all walkers
+  uint32_t msRun;
+  uint32_t msStep;        // time the calling core spent stepping
+  uint32_t msFlush;       // time spent flushing the density map
+  uint32_t stepsPerSec;
+};
+
+class RandomWalk
+{
+  public:
+    RandomWalk(LGFX &lcd) : _lcd(lcd), _density(lcd) {}
+    bool begin(int nbrWalkers, const Palette &palette);
+    const WalkStats &run(uint32_t nbrFrames, uint16_t stepsPerFrame, AbortCallback isAborted = nullptr);
+    void end();
+
+    static constexpr int MAX_WALKERS = 8192;
+
+  private:
+    LGFX       &_lcd;
+    DensityMap _density;
+    int        _nbrWalkers = 0;
+    uint16_t   *_x = nullptr;              // positions, structure of arrays
+    uint16_t   *_y = nullptr;
+    int        _xMax, _yMax;
+    uint32_t   _rng[2] = { 0x12345678, 0x9E3779B9 };  // one generator per core
+    WalkStats  _stats;
+
+    // Shared with the worker task on core 0
+    uint16_t          _stepsPerFrame = 0;
+    volatile bool     _stop = false;
+    SemaphoreHandle_t _go   = nullptr;      // worker may step its walkers
+    SemaphoreHandle_t _done = nullptr;      // worker has finished the frame or stopped
+    TaskHandle_t      _workerTask = nullptr;
+
+    void step(int first, int last, uint32_t &rng, uint16_t nbrSteps);
+    static void workerTask(void *arg);
+};
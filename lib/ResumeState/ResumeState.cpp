@@ -0,0 +1,158 @@
+/**
+ * Class        ResumeState
+ * 
+ * Purpose      Implements a class ResumeState which keeps the state needed for
+ *              an instant resume in RTC slow memory: the epoch of the last NTP 
+ *              synchronization, the drift estimate of the RTC, the selected 
+ *              menu item and the menu page. RTC slow memory survives deep sleep
+ *              and software resets, but not a power-on reset. Therefore commit() 
+ *              mirrors the data to NVS, from where begin() restores it when the
+ *              RTC memory is empty. Writing to flash is only done on commit(), 
+ *              which is called after a NTP sync and before going to deep sleep,
+ *              the frequent menu updates only touch the RTC memory.
+ * 
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The system time of the ESP32 keeps running in deep sleep, so
+ *              after waking up the clock is valid immediately. After a power-on 
+ *              reset the last synchronized epoch from NVS is set as a preliminary 
+ *              time until the next NTP sync corrects it, isTimeValid() is false
+ *              then, so setup() still waits for NTP.
+ * References   https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/sleep_modes.html
+ */
+#include "ResumeState.h"
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <sys/time.h>
+
+static constexpr uint32_t RESUME_MAGIC = 0x43594452;  // "CYDR"
+static const char *NVS_NAMESPACE = "resume";
+static const char *NVS_KEY       = "data";
+
+RTC_DATA_ATTR static ResumeData _rtcData;
+
+ResumeData &ResumeState::rtcData()
+{
+  return _rtcData;
+}
+
+/**
+ * Validate the RTC memory and fall back to NVS if it is empty
+ * or corrupt. Returns true if a valid state is available.
+*/
+bool ResumeState::begin()
+{
+  _isInRtcMemory = false;
+  if (isSealed(_rtcData))
+  {
+    _isValid = true;
+    _isInRtcMemory = true;
+    log_i("Resume state restored from RTC memory");
+  }
+  else if (restoreFromNvs())
+  {
+    _isValid = true;
+    log_i("Resume state restored from NVS");
+    if (_rtcData.epochSynced >= EPOCH_MIN_VALID && time(nullptr) < (time_t)_rtcData.epochSynced)
+    { // power-on reset, use the last synchronized time until NTP corrects it,
+      // isTimeValid() stays false so the NTP sync is still awaited
+      timeval tv = { (time_t)_rtcData.epochSynced, 0 };
+      settimeofday(&tv, NULL);
+      log_w("RTC set to last synchronized epoch %u, waiting for NTP", _rtcData.epochSynced);
+    }
+  }
+  else
+  {
+    memset(&_rtcData, 0, sizeof(_rtcData));
+    _isValid = false;
+    log_i("No resume state found");
+  }
+  log_i("==> done");
+  return _isValid;
+}
+
+/**
+ * The RTC time is considered valid if the state was kept in RTC memory,
+ * i.e. after a wake up from deep sleep or a software reset, and the time
+ * was synchronized at least once. The epoch restored from NVS after a
+ * power-on reset can be days old and does not count.
+*/
+bool ResumeState::isTimeValid()
+{
+  return _isValid && _isInRtcMemory && _rtcData.epochSynced >= EPOCH_MIN_VALID && time(nullptr) >= (time_t)_rtcData.epochSynced;
+}
+
+/**
+ * Remember the menu position. Only the RTC memory is written, 
+ * call commit() to make it persistent.
+*/
+void ResumeState::saveMenu(int selectedMenuItem, int menuPage)
+{
+  _rtcData.selectedMenuItem = selectedMenuItem;
+  _rtcData.menuPage         = menuPage;
+  seal();
+}
+
+/**
+ * Remember the time of the last NTP synchronization and the 
+ * drift estimate. Only the RTC memory is written, call commit() 
+ * to make it persistent.
+*/
+void ResumeState::saveSync(uint32_t epochSynced, float driftPpm)
+{
+  _rtcData.epochSynced = epochSynced;
+  _rtcData.driftPpm    = driftPpm;
+  seal();
+}
+
+/**
+ * Mirror the RTC memory to NVS
+*/
+void ResumeState::commit()
+{
+  Preferences prefs;
+  if (! _isValid) return;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putBytes(NVS_KEY, &_rtcData, sizeof(_rtcData));
+  prefs.end();
+}
+
+/**
+ * Commit the state and enter deep sleep. The ESP32 wakes up when the 
+ * level at wakeupPin goes low, e.g. by the IRQ of the touch controller.
+ * After waking up the program starts again with setup().
+*/
+void ResumeState::deepSleep(gpio_num_t wakeupPin)
+{
+  commit();
+  log_i("Entering deep sleep, wake up by touch");
+  Serial.flush();
+  esp_sleep_enable_ext0_wakeup(wakeupPin, 0);
+  esp_deep_sleep_start();
+}
+
+void ResumeState::seal()
+{
+  _rtcData.magic = RESUME_MAGIC;
+  _rtcData.crc   = crc32_le(0, (const uint8_t *)&_rtcData, offsetof(ResumeData, crc));
+  _isValid = true;
+}
+
+bool ResumeState::isSealed(const ResumeData &data)
+{
+  return data.magic == RESUME_MAGIC && 
+         data.crc   == crc32_le(0, (const uint8_t *)&data, offsetof(ResumeData, crc));
+}
+
+bool ResumeState::restoreFromNvs()
+{
+  Preferences prefs;
+  ResumeData  data;
+  size_t      len;
+
+  prefs.begin(NVS_NAMESPACE, true);
+  len = prefs.getBytes(NVS_KEY, &data, sizeof(data));
+  prefs.end();
+  if (len != sizeof(data) || ! isSealed(data)) return false;
+  _rtcData = data;
+  return true;
+}
@@ -0,0 +1,46 @@
+/**
+ * ResumeState.h
+ * 
+ * Declaration of the class ResumeState. It keeps the epoch of the last
+ * NTP synchronization, the estimated drift of the RTC and the position 
+ * in the menu in RTC slow memory, which survives deep sleep and software 
+ * resets. A copy is written to NVS as a fallback for power-on resets.
+ */ 
+#pragma once
+#include <Arduino.h>
+
+struct ResumeData
+{
+  uint32_t magic;
+  uint32_t epochSynced;       // time of the last NTP synchronization (UTC)
+  float    driftPpm;          // estimated drift of the RTC in ppm
+  int16_t  selectedMenuItem;
+  int16_t  menuPage;
+  uint32_t crc;               // crc32 over all preceding members
+};
+
+class ResumeState
+{
+  public:
+    bool begin();
+    bool isValid()      { return _isValid; }
+    bool isTimeValid();
+    int  selectedMenuItem() { return _isValid ? rtcData().selectedMenuItem : 0; }
+    int  menuPage()         { return _isValid ? rtcData().menuPage : 0; }
+    uint32_t epochSynced()  { return _isValid ? rtcData().epochSynced : 0; }
+    float    driftPpm()     { return _isValid ? rtcData().driftPpm : 0.0f; }
+    void saveMenu(int selectedMenuItem, int menuPage);
+    void saveSync(uint32_t epochSynced, float driftPpm);
+    void commit();
+    void deepSleep(gpio_num_t wakeupPin);
+
+    static constexpr uint32_t EPOCH_MIN_VALID = 1704067200UL;  // 2024-01-01 00:00:00 UTC
+
+  private:
+    bool _isValid = false;
+    bool _isInRtcMemory = false;  // the state survived in RTC memory, the system time kept running
+    ResumeData &rtcData();
+    void seal();
+    bool isSealed(const ResumeData &data);
+    bool restoreFromNvs();
+};
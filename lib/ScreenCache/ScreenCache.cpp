@@ -0,0 +1,207 @@
+/**
+ * Class        ScreenCache
+ *
+ * Purpose      Implements a class ScreenCache which shows the result of an
+ *              expensive action again without computing it, if the action
+ *              is called with the same parameters:
+ *              - makeKey() hashes the name of the action and its parameters
+ *                with FNV-1a into a 32 bit key.
+ *              - store() reads the panel with readRect() in strips of 8 rows
+ *                and RLE565 encodes each strip at once, so only one strip and
+ *                the compressed screen are in memory. The compressed screen
+ *                grows in steps of 8 kB and is shrunk to its size at the end.
+ *              - restore() decodes the entry strip by strip into the buffers
+ *                of a StripPipeline, which pushes them by DMA.
+ *              - Each access stamps the entry with a counter. Entries with the
+ *                oldest stamp are removed until a new entry fits the budget.
+ *                A screen which compresses to more than half the budget is
+ *                not stored, it would evict everything else.
+ *              Every hit and miss is logged, printStats() prints the totals.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The size of the screen is part of an entry, a screen stored
+ *              in another rotation is not restored. Key collisions of FNV-1a
+ *              are not detected, with a handful of entries they are unlikely.
+ * References   http://www.isthe.com/chongo/tech/comp/fnv/
+ */
+#include "ScreenCache.h"
+
+static constexpr uint32_t FNV_OFFSET = 2166136261u;
+static constexpr uint32_t FNV_PRIME  = 16777619u;
+
+/**
+ * Key of an action with size bytes of parameters
+*/
+uint32_t ScreenCache::makeKey(const char *action, const void *params, size_t size)
+{
+  uint32_t h = FNV_OFFSET;
+  for (const char *s = action; *s != '\0'; s++) h = (h ^ (uint8_t)*s) * FNV_PRIME;
+  const uint8_t *p = (const uint8_t *)params;
+  for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * FNV_PRIME;
+  return h;
+}
+
+/**
+ * Show the screen stored under key, returns false on a miss
+*/
+bool ScreenCache::restore(uint32_t key)
+{
+  Entry *e = find(key);
+  if (e == nullptr || e->width != _lcd.width() || e->height != _lcd.height())
+  {
+    _stats.misses++;
+    log_i("Screen cache miss %08x", key);
+    return false;
+  }
+
+  uint32_t usStart = micros();
+  StripPipeline pipeline(_lcd);
+  if (! pipeline.begin(STRIP_ROWS, 2, false))
+  {
+    _stats.misses++;
+    log_w("Screen cache miss %08x, no memory to restore it", key);
+    return false;
+  }
+  _decoder.begin(e->data, e->size);
+  _pixelsDecoded = 0;
+  pipeline.run(renderStrip, this);
+  pipeline.end();
+  if (_decoder.isCorrupt() || _pixelsDecoded < (uint32_t)e->width * e->height)
+  { // the screen is partly drawn, the caller draws it again
+    _stats.misses++;
+    log_e("Screen cache entry %08x is corrupt", key);
+    return false;
+  }
+  e->lastUse = ++_useCounter;
+  _stats.hits++;
+  _stats.usRestore = micros() - usStart;
+  log_i("Screen cache hit %08x, %u bytes restored in %u us", key, e->size, _stats.usRestore);
+  return true;
+}
+
+/**
+ * StripRenderer of restore()
+*/
+void ScreenCache::renderStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  ScreenCache *c = (ScreenCache *)context;
+  c->_pixelsDecoded += c->_decoder.decode(strip, rows * c->_lcd.width());
+}
+
+/**
+ * Compress the screen and store it under key, an entry
+ * with the same key is replaced
+*/
+bool ScreenCache::store(uint32_t key)
+{
+  uint32_t usStart = micros();
+  int w = _lcd.width();
+  int h = _lcd.height();
+  uint16_t *strip = (uint16_t *)malloc(STRIP_ROWS * w * sizeof(uint16_t));
+  Rle565Encoder encoder;
+  bool isOk = strip != nullptr;
+
+  _grow.clear();
+  encoder.begin(ByteBuffer::append, &_grow);
+  for (int y = 0; y < h && isOk; y += STRIP_ROWS)
+  {
+    int rows = min((int)STRIP_ROWS, h - y);
+    _lcd.readRect(0, y, w, rows, (lgfx::swap565_t *)strip);
+    isOk = encoder.add(strip, rows * w);
+  }
+  isOk = isOk && encoder.finish();
+  free(strip);
+
+  Entry *e = isOk ? find(key) : nullptr;
+  if (e != nullptr) remove(*e);
+  e = isOk ? makeRoom(_grow.size()) : nullptr;
+  if (e == nullptr)
+  {
+    _stats.rejected++;
+    log_w("Screen %08x not cached, %u bytes or more", key, encoder.getBytesOut());
+    free(_grow.release());
+    return false;
+  }
+
+  e->key     = key;
+  e->width   = w;
+  e->height  = h;
+  e->lastUse = ++_useCounter;
+  e->size    = _grow.size();
+  e->data    = _grow.release();
+  _bytesUsed += e->size;
+  _stats.stores++;
+  _stats.usStore = micros() - usStart;
+  log_i("Screen %08x cached, %u bytes (%.1f %%) in %u us", key, e->size,
+        100.0f * e->size / (w * h * sizeof(uint16_t)), _stats.usStore);
+  return true;
+}
+
+ScreenCache::Entry *ScreenCache::find(uint32_t key)
+{
+  for (Entry &e : _entries)
+  {
+    if (e.data != nullptr && e.key == key) return &e;
+  }
+  return nullptr;
+}
+
+void ScreenCache::remove(Entry &e)
+{
+  _bytesUsed -= e.size;
+  free(e.data);
+  e = {};
+}
+
+/**
+ * Remove the least recently used entries until size bytes fit into
+ * the budget, returns a free slot or nullptr if size never fits
+*/
+ScreenCache::Entry *ScreenCache::makeRoom(uint32_t size)
+{
+  if (size > _budget / 2) return nullptr;
+  for (;;)
+  {
+    Entry *freeSlot = nullptr;
+    Entry *oldest   = nullptr;
+    for (Entry &e : _entries)
+    {
+      if (e.data == nullptr) { if (freeSlot == nullptr) freeSlot = &e; }
+      else if (oldest == nullptr || e.lastUse < oldest->lastUse) oldest = &e;
+    }
+    if (freeSlot != nullptr && _bytesUsed + size <= _budget) return freeSlot;
+    if (oldest == nullptr) return nullptr;
+    log_i("Screen %08x evicted", oldest->key);
+    remove(*oldest);
+    _stats.evictions++;
+  }
+}
+
+void ScreenCache::clear()
+{
+  for (Entry &e : _entries)
+  {
+    if (e.data != nullptr) remove(e);
+  }
+}
+
+void ScreenCache::printStats()
+{
+  const CacheStats &s = _stats;
+  int nbrEntries = 0;
+  for (Entry &e : _entries) nbrEntries += e.data != nullptr;
+  Serial.printf(R"(
+Screen Cache
+------------
+entries        %6d of %d
+bytes used     %6u of %u
+hits           %6u  (%.0f %%)
+misses         %6u
+stores         %6u
+evictions      %6u
+rejected       %6u
+last restore   %6u us
+last store     %6u us
+)", nbrEntries, MAX_ENTRIES, _bytesUsed, _budget, s.hits, 100.0f * s.hits / max(s.hits + s.misses, (uint32_t)1),
+    s.misses, s.stores, s.evictions, s.rejected, s.usRestore, s.usStore);
+}
@@ -0,0 +1,70 @@
+/**
+ * ScreenCache.h
+ *
+ * Declaration of the class ScreenCache, which keeps the result screens
+ * of expensive actions RLE565 compressed in the heap. An entry is found
+ * by a key made of the name of the action and a hash of its parameters.
+ * store() reads the panel back in strips and compresses it, restore()
+ * decodes an entry straight to the panel. The least recently used
+ * entries are removed when the byte budget is exceeded.
+ * The constructor needs a reference to the LGFX object and the budget.
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+#include "ImageCodec.h"
+#include "StripPipeline.h"
+
+struct CacheStats
+{
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t stores;
+  uint32_t evictions;
+  uint32_t rejected;                // screens larger than the entry limit
+  uint32_t usRestore;               // last restore
+  uint32_t usStore;                 // last store
+};
+
+class ScreenCache
+{
+  public:
+    static constexpr int MAX_ENTRIES = 8;
+    static constexpr int STRIP_ROWS  = 8;
+    static constexpr size_t GROW_STEP = 8192;
+
+    ScreenCache(LGFX &lcd, uint32_t byteBudget) : _lcd(lcd), _budget(byteBudget), _grow(byteBudget / 2, GROW_STEP) {}
+    ~ScreenCache() { clear(); }
+    static uint32_t makeKey(const char *action, const void *params = nullptr, size_t size = 0);
+    bool restore(uint32_t key);
+    bool store(uint32_t key);
+    void clear();
+    uint32_t getBytesUsed() { return _bytesUsed; }
+    const CacheStats &getStats() { return _stats; }
+    void printStats();
+
+  private:
+    struct Entry
+    {
+      uint32_t key;
+      uint16_t width, height;
+      uint32_t lastUse;
+      uint32_t size;
+      uint8_t  *data;                 // nullptr if the slot is free
+    };
+
+    LGFX          &_lcd;
+    uint32_t      _budget;
+    uint32_t      _bytesUsed = 0;
+    uint32_t      _useCounter = 0;
+    Entry         _entries[MAX_ENTRIES] = {};
+    CacheStats    _stats = {};
+    Rle565Decoder _decoder;           // source of the strips of restore()
+    uint32_t      _pixelsDecoded;     // by restore()
+    ByteBuffer    _grow;              // screen compressed by store()
+
+    Entry *find(uint32_t key);
+    void  remove(Entry &e);
+    Entry *makeRoom(uint32_t size);
+    static void renderStrip(void *context, uint16_t *strip, int y0, int rows);
+};
@@ -0,0 +1,448 @@
+/**
+ * Class        ScreenCapture
+ *
+ * Purpose      Implements a class ScreenCapture which captures what the panel
+ *              shows, cheap enough to stay enabled in the field:
+ *              - The panel is read with readRect() in strips of STRIP_ROWS rows,
+ *                each strip is encoded and written before the next one is read.
+ *                Besides the output only one or two strips are in memory.
+ *              - BMP files hold the rgb565 pixels as they are, only the byte
+ *                order is changed. QOI files are encoded with QoiEncoder.
+ *              - A recording keeps the previous frame RLE565 compressed. It is
+ *                decoded strip by strip in step with the panel, the XOR of both
+ *                strips is RLE565 encoded as the delta frame, the new strip is
+ *                encoded as the next reference. The delta is written unless the
+ *                key frame is smaller or a key frame is due. A key frame larger
+ *                than FRAME_LIMIT is written in a second pass over the panel,
+ *                straight from the encoder to the output.
+ *              - loop() captures a frame when the next frame of the fixed rate
+ *                is due, frames whose time has passed are counted as dropped.
+ *                If the panel was rotated, the new size is written first and
+ *                the frame is a key frame.
+ *              The time to read, encode and write each frame is measured,
+ *              printStats() shows the cost of the last frame, the mean and the
+ *              maximum.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      readRect() uses the bus of the panel, so a capture must run on
+ *              the task which draws, e.g. from loop() or after a frame of the
+ *              FrameScheduler. A key frame larger than FRAME_LIMIT cannot be
+ *              kept as reference, the frame after it is a key frame as well,
+ *              so a busy screen costs two passes and a full key per frame.
+ *              While a capture is written to Serial, the log output is muted,
+ *              other Serial prints would still corrupt it.
+ * References   https://qoiformat.org
+ *              https://en.wikipedia.org/wiki/BMP_file_format
+ */
+#include "ScreenCapture.h"
+
+static const char *CAPTURE_DIR = "/capture";
+
+/**
+ * Write the screen as BMP or QOI to a new file on the SD
+ * card or to Serial, returns false if it cannot be written
+*/
+bool ScreenCapture::screenshot(CaptureFormat format, CaptureTarget target)
+{
+  if (_isRecording)
+  {
+    log_w("No screenshot while recording");
+    return false;
+  }
+  int w = _lcd.width();
+  int h = _lcd.height();
+
+  _target = target;
+  if (! allocStrips(false)) return false;
+  if (! open(format == CAPTURE_BMP ? "bmp" : "qoi"))
+  {
+    freeStrips();
+    return false;
+  }
+
+  beginFrame();
+  uint32_t usStart = micros();
+  uint32_t usRead = 0;
+  QoiEncoder qoi;
+  uint32_t rowSize = bmpRowSize(w);
+
+  if (format == CAPTURE_BMP)
+  {
+    writeBmpHeader(writeOut, this, w, h);
+  }
+  else
+  {
+    qoi.begin(writeOut, this, w, h);
+  }
+  for (int y = 0; y < h && _isWriteOk; y += STRIP_ROWS)
+  {
+    int rows = min((int)STRIP_ROWS, h - y);
+    uint32_t usReadStart = micros();
+    _lcd.readRect(0, y, w, rows, (lgfx::swap565_t *)_strip);
+    usRead += micros() - usReadStart;
+    if (format == CAPTURE_BMP)
+    {
+      static const uint8_t padding[2] = {0, 0};
+      for (int i = 0; i < rows * w; i++) _strip[i] = (_strip[i] >> 8) | (_strip[i] << 8);
+      for (int r = 0; r < rows; r++)
+      {
+        writeOut(this, (uint8_t *)(_strip + r * w), w * sizeof(uint16_t));
+        if (rowSize > w * sizeof(uint16_t)) writeOut(this, padding, rowSize - w * sizeof(uint16_t));
+      }
+    }
+    else
+    {
+      qoi.add(_strip, rows * w);
+    }
+  }
+  if (format == CAPTURE_QOI) qoi.finish();
+  endFrame(usStart, usRead);
+  close();
+  freeStrips();
+
+  bool isOk = _isWriteOk;
+  if (isOk) log_i("Screenshot %s, %u bytes in %u us", _name, _stats.bytes, _stats.usFrame);
+  else      log_e("Screenshot %s could not be written", _name);
+  return isOk;
+}
+
+/**
+ * Record the screen with fps frames per second to a new file
+ * on the SD card or to Serial, loop() captures the frames
+*/
+bool ScreenCapture::startRecording(uint16_t fps, CaptureTarget target)
+{
+  if (_isRecording) return false;
+  _target = target;
+  if (! allocStrips(true)) return false;
+  if (! open("rec"))
+  {
+    freeStrips();
+    return false;
+  }
+
+  _msPeriod = 1000 / constrain(fps, (uint16_t)1, (uint16_t)50);
+  _width    = _lcd.width();
+  _height   = _lcd.height();
+  uint8_t header[10] = {'R', 'R', 'E', 'C',
+                        (uint8_t)_width,    (uint8_t)(_width >> 8),
+                        (uint8_t)_height,   (uint8_t)(_height >> 8),
+                        (uint8_t)_msPeriod, (uint8_t)(_msPeriod >> 8)};
+  log_i("Recording %s at %u ms per frame", _name, _msPeriod);
+  writeOut(this, header, sizeof(header));
+  _stats = {};
+  _stats.bytesTotal = sizeof(header);
+  _key.clear();
+  _prevKey.clear();
+  _nbrRecorded = 0;
+  _msStart = _msDue = millis();
+  _isRecording = true;
+  return true;
+}
+
+void ScreenCapture::stopRecording()
+{
+  if (! _isRecording) return;
+  _isRecording = false;
+  close();
+  freeStrips();
+  free(_key.release());
+  free(_prevKey.release());
+  free(_delta.release());
+  log_i("Recording %s stopped, %u frames, %u bytes", _name, _nbrRecorded, _stats.bytesTotal);
+}
+
+/**
+ * Record a frame if one is due
+*/
+void ScreenCapture::loop()
+{
+  if (! _isRecording) return;
+  uint32_t msLate = millis() - _msDue;
+  if ((int32_t)msLate < 0) return;
+  uint32_t missed = msLate / _msPeriod;
+  _stats.dropped += missed;
+  _msDue += (missed + 1) * _msPeriod;
+  if ((_lcd.width() != _width || _lcd.height() != _height) && ! changeSize())
+  {
+    stopRecording();
+    return;
+  }
+  recordFrame();
+  if (! _isWriteOk)
+  {
+    log_e("Recording %s could not be written", _name);
+    stopRecording();
+  }
+}
+
+/**
+ * The panel was rotated, write the new size and reallocate the strips.
+ * The previous frame has the old size, so the next frame is a key frame.
+ * Returns false if there is not enough memory for the new strips.
+*/
+bool ScreenCapture::changeSize()
+{
+  _width  = _lcd.width();
+  _height = _lcd.height();
+  log_i("Recording %s continues at %d x %d", _name, _width, _height);
+  freeStrips();
+  if (! allocStrips(true)) return false;
+  uint8_t size[4] = {(uint8_t)_width, (uint8_t)(_width >> 8), (uint8_t)_height, (uint8_t)(_height >> 8)};
+  beginFrame();
+  writeFrame('S', size, sizeof(size));
+  _stats.bytesTotal += _bytesOut;
+  _prevKey.clear();
+  return true;
+}
+
+/**
+ * Encode the screen as reference and the XOR with the previous
+ * frame as delta in one pass, then write the smaller one
+*/
+void ScreenCapture::recordFrame()
+{
+  int w = _lcd.width();
+  int h = _lcd.height();
+  bool isKey = _nbrRecorded % KEY_INTERVAL == 0;
+  Rle565Encoder keyEncoder, deltaEncoder;
+
+  beginFrame();
+  uint32_t usStart = micros();
+  uint32_t usRead = 0;
+  _key.clear();
+  _delta.clear();
+  keyEncoder.begin(ByteBuffer::append, &_key);
+  deltaEncoder.begin(ByteBuffer::append, &_delta);
+  _prevDecoder.begin(_prevKey.data(), _prevKey.size());
+  for (int y = 0; y < h; y += STRIP_ROWS)
+  {
+    uint32_t n = min((int)STRIP_ROWS, h - y) * w;
+    uint32_t usReadStart = micros();
+    _lcd.readRect(0, y, w, n / w, (lgfx::swap565_t *)_strip);
+    usRead += micros() - usReadStart;
+    keyEncoder.add(_strip, n);       // counts the bytes on after the buffer is full
+    if (! isKey)
+    {
+      if (_prevDecoder.decode(_prevStrip, n) < n) isKey = true;
+      for (uint32_t i = 0; i < n; i++) _prevStrip[i] ^= _strip[i];
+      if (! deltaEncoder.add(_prevStrip, n)) isKey = true;
+    }
+  }
+  bool isKeyBuffered = keyEncoder.finish();
+  isKey = isKey || ! deltaEncoder.finish() || (isKeyBuffered && _delta.size() >= _key.size());
+
+  if (! isKey)
+  {
+    writeFrame('D', _delta.data(), _delta.size());
+  }
+  else if (isKeyBuffered)
+  {
+    writeFrame('K', _key.data(), _key.size());
+  }
+  else
+  {
+    usRead += streamKey(keyEncoder.getBytesOut());
+  }
+  // a key which did not fit cannot be the reference, the next frame is a key frame
+  if (isKeyBuffered) _key.swap(_prevKey);
+  else               _prevKey.clear();
+  _nbrRecorded++;
+  if (isKey) _stats.keyFrames++;
+  endFrame(usStart, usRead);
+}
+
+/**
+ * Write a key frame larger than FRAME_LIMIT without buffering it, the
+ * panel is read and encoded a second time straight into the output.
+ * Returns the time spent reading the panel.
+*/
+uint32_t ScreenCapture::streamKey(uint32_t len)
+{
+  int w = _lcd.width();
+  int h = _lcd.height();
+  uint32_t usRead = 0;
+  Rle565Encoder encoder;
+
+  writeFrame('K', nullptr, len);
+  encoder.begin(writeOut, this);
+  for (int y = 0; y < h && _isWriteOk; y += STRIP_ROWS)
+  {
+    uint32_t n = min((int)STRIP_ROWS, h - y) * w;
+    uint32_t usReadStart = micros();
+    _lcd.readRect(0, y, w, n / w, (lgfx::swap565_t *)_strip);
+    usRead += micros() - usReadStart;
+    encoder.add(_strip, n);
+  }
+  encoder.finish();
+  if (encoder.getBytesOut() != len)
+  { // the panel changed between both passes, the file cannot be read beyond this frame
+    log_e("Key frame %u changed while it was written", _nbrRecorded);
+    _isWriteOk = false;
+  }
+  return usRead;
+}
+
+/**
+ * Write the header of a recorded frame, followed by len bytes of data
+ * unless data is nullptr
+*/
+void ScreenCapture::writeFrame(char type, const uint8_t *data, uint32_t len)
+{
+  uint32_t ms = millis() - _msStart;
+  uint8_t header[9] = {(uint8_t)type,
+                       (uint8_t)ms,  (uint8_t)(ms >> 8),  (uint8_t)(ms >> 16),  (uint8_t)(ms >> 24),
+                       (uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24)};
+  writeOut(this, header, sizeof(header));
+  if (data != nullptr) writeOut(this, data, len);
+}
+
+/**
+ * Open the output for a new capture with the file extension
+*/
+bool ScreenCapture::open(const char *extension)
+{
+  _isWriteOk = true;
+  if (_target == TO_SERIAL)
+  {
+    snprintf(_name, sizeof(_name), "%04u.%s", _nextNumber++, extension);
+    return true;
+  }
+
+  _isMounted = SdCard::mount();
+  if (! _isMounted) return false;
+  SdCard::makeDir(CAPTURE_DIR);
+  do
+  {
+    snprintf(_name, sizeof(_name), "%s/%04u.%s", CAPTURE_DIR, _nextNumber++, extension);
+  } while (SdCard::exists(_name) && _nextNumber < 10000);
+  if (_file.open(_name, true)) return true;
+
+  log_e("Cannot create %s", _name);
+  SdCard::unmount();
+  _isMounted = false;
+  return false;
+}
+
+void ScreenCapture::close()
+{
+  if (_isLogMuted)
+  {
+    static const uint8_t END_BLOCK[2] = {0, 0};
+    Serial.write(END_BLOCK, sizeof(END_BLOCK));
+    muteLog(false);
+  }
+  _file.close();
+  if (_isMounted) SdCard::unmount();
+  _isMounted = false;
+}
+
+bool ScreenCapture::allocStrips(bool withPrevious)
+{
+  size_t size = STRIP_ROWS * _lcd.width() * sizeof(uint16_t);
+  _strip     = (uint16_t *)malloc(size);
+  _prevStrip = withPrevious ? (uint16_t *)malloc(size) : nullptr;
+  if (_strip != nullptr && (_prevStrip != nullptr || ! withPrevious)) return true;
+  log_e("Not enough memory for the capture strips");
+  freeStrips();
+  return false;
+}
+
+void ScreenCapture::freeStrips()
+{
+  free(_strip);
+  free(_prevStrip);
+  _strip = _prevStrip = nullptr;
+}
+
+void ScreenCapture::beginFrame()
+{
+  _usWrite  = 0;
+  _bytesOut = 0;
+}
+
+void ScreenCapture::endFrame(uint32_t usStart, uint32_t usRead)
+{
+  CaptureStats &s = _stats;
+  s.frames++;
+  s.bytes       = _bytesOut;
+  s.bytesTotal += _bytesOut;
+  s.usFrame     = micros() - usStart;
+  s.usRead      = usRead;
+  s.usWrite     = _usWrite;
+  s.usEncode    = s.usFrame - min(s.usFrame, usRead + _usWrite);
+  s.usFrameMax  = max(s.usFrameMax, s.usFrame);
+  s.usFrameSum += s.usFrame;
+  log_d("Frame %u: %u bytes in %u us, read %u us, encode %u us, write %u us",
+        s.frames, s.bytes, s.usFrame, s.usRead, s.usEncode, s.usWrite);
+}
+
+/**
+ * Mute the log output of the Arduino core and of ESP-IDF while
+ * the blocks of a capture are written to Serial. The line with
+ * the name is the last text before the first block.
+*/
+void ScreenCapture::muteLog(bool isMuted)
+{
+  if (isMuted == _isLogMuted) return;
+  if (isMuted)
+  {
+    Serial.printf("\n#capture %s\n", _name);
+    _logLevel = esp_log_level_get("*");
+    esp_log_level_set("*", ESP_LOG_NONE);
+  }
+  else
+  {
+    esp_log_level_set("*", _logLevel);
+  }
+  Serial.setDebugOutput(! isMuted);
+  _isLogMuted = isMuted;
+}
+
+/**
+ * ByteSink of the encoders, writes to the file or in blocks to Serial
+*/
+bool ScreenCapture::writeOut(void *context, const uint8_t *data, size_t len)
+{
+  ScreenCapture *c = (ScreenCapture *)context;
+  uint32_t usStart = micros();
+
+  while (len > 0 && c->_isWriteOk)
+  {
+    size_t n = min(len, (size_t)4096);
+    if (c->_target == TO_SERIAL)
+    {
+      if (! c->_isLogMuted) c->muteLog(true);
+      uint8_t block[2] = {(uint8_t)n, (uint8_t)(n >> 8)};
+      Serial.write(block, sizeof(block));
+      Serial.write(data, n);
+    }
+    else
+    {
+      c->_isWriteOk = c->_file.write(data, n) == n;
+    }
+    c->_bytesOut += n;
+    data += n;
+    len  -= n;
+  }
+  c->_usWrite += micros() - usStart;
+  return c->_isWriteOk;
+}
+
+void ScreenCapture::printStats()
+{
+  const CaptureStats &s = _stats;
+  Serial.printf(R"(
+Screen Capture %s
+--------------------------
+frames          %8u  (%u key frames)
+dropped         %8u
+last frame      %8u bytes
+total           %8u bytes
+read panel      %8u us
+encode          %8u us
+write           %8u us
+frame time      %8u us  (mean %u, max %u)
+)", _name, s.frames, s.keyFrames, s.dropped, s.bytes, s.bytesTotal, s.usRead, s.usEncode, s.usWrite,
+    s.usFrame, (uint32_t)(s.usFrameSum / max(s.frames, (uint32_t)1)), s.usFrameMax);
+}
@@ -0,0 +1,110 @@
+/**
+ * ScreenCapture.h
+ *
+ * Declaration of the class ScreenCapture, which reads the panel back with
+ * readRect() in strips and encodes each strip at once, so no copy of the
+ * screen is ever held in memory. A screenshot is written as BMP or QOI, a
+ * recording as a sequence of RLE565 frames at a fixed rate. Each recorded
+ * frame is either a key frame or the XOR with the previous frame, which
+ * is mostly 0 and compresses to a few bytes. The output goes to a file on
+ * the SD card (/capture/NNNN.bmp, .qoi or .rec) or to Serial.
+ *
+ * Recording file: "RREC", width, height and period in ms as little endian
+ * 16 bit values, followed by the frames: the type 'K' or 'D' as one byte,
+ * the time since the start in ms and the length of the RLE565 data as
+ * little endian 32 bit values, then the data. If the panel is rotated,
+ * a record of the type 'S' with the new width and height as data, 16 bit
+ * little endian, comes before the next frame, which is a key frame.
+ * On Serial the file follows a line "#capture <name>" in blocks of a
+ * 16 bit little endian length and the data, a length of 0 ends it. The
+ * log output is muted from the first block until the end, so it cannot
+ * end up between the blocks.
+ *
+ * The constructor needs a reference to the LGFX object.
+ */
+#pragma once
+#include <Arduino.h>
+#ifndef NATIVE_BUILD
+#include <esp_log.h>
+#endif
+#include "lgfx_ESP32_2432S028.h"
+#include "ImageCodec.h"
+#include "SdCard.h"
+
+enum CaptureFormat : uint8_t { CAPTURE_BMP, CAPTURE_QOI };
+enum CaptureTarget : uint8_t { TO_SD_CARD, TO_SERIAL };
+
+struct CaptureStats
+{
+  uint32_t frames;                  // screenshots and recorded frames
+  uint32_t keyFrames;
+  uint32_t dropped;                 // recorded frames missed
+  uint32_t bytes;                   // output of the last frame
+  uint32_t bytesTotal;
+  uint32_t usRead;                  // last frame, reading the panel
+  uint32_t usEncode;                // last frame, encoding
+  uint32_t usWrite;                 // last frame, writing the output
+  uint32_t usFrame;                 // last frame, total
+  uint32_t usFrameMax;
+  uint64_t usFrameSum;
+};
+
+class ScreenCapture
+{
+  public:
+    static constexpr int    STRIP_ROWS   = 8;
+    static constexpr size_t FRAME_LIMIT  = 32768;   // per buffered frame of a recording, larger keys are streamed
+    static constexpr int    KEY_INTERVAL = 50;      // a key frame after this many frames
+
+    ScreenCapture(LGFX &lcd) : _lcd(lcd), _key(FRAME_LIMIT), _prevKey(FRAME_LIMIT), _delta(FRAME_LIMIT) {}
+    ~ScreenCapture() { stopRecording(); }
+    bool screenshot(CaptureFormat format, CaptureTarget target = TO_SD_CARD);
+    bool startRecording(uint16_t fps, CaptureTarget target = TO_SD_CARD);
+    void stopRecording();
+    bool isRecording() { return _isRecording; }
+    void loop();
+    const char *getLastName() { return _name; }
+    const CaptureStats &getStats() { return _stats; }
+    void printStats();
+
+  private:
+    LGFX         &_lcd;
+    CaptureStats _stats = {};
+    CaptureTarget _target = TO_SD_CARD;
+    SdFile       _file;
+    char         _name[24] = "";
+    bool         _isMounted = false;
+    uint16_t     *_strip = nullptr;
+    uint16_t     *_prevStrip = nullptr;
+    uint32_t     _usWrite;                // of the current frame
+    uint32_t     _bytesOut;               // of the current frame
+    bool         _isWriteOk;
+    bool         _isLogMuted = false;
+    esp_log_level_t _logLevel;            // before the log was muted
+    uint16_t     _nextNumber = 1;         // of the file name
+
+    // Recording
+    bool          _isRecording = false;
+    uint32_t      _msPeriod;
+    uint32_t      _msStart;
+    uint32_t      _msDue;
+    uint32_t      _nbrRecorded;
+    int           _width, _height;        // of the recorded frames
+    ByteBuffer    _key;                   // RLE565 of the current frame
+    ByteBuffer    _prevKey;               // RLE565 of the previous frame
+    ByteBuffer    _delta;                 // RLE565 of the XOR of both
+    Rle565Decoder _prevDecoder;
+
+    bool open(const char *extension);
+    void close();
+    bool allocStrips(bool withPrevious);
+    void freeStrips();
+    bool changeSize();
+    void recordFrame();
+    uint32_t streamKey(uint32_t len);
+    void writeFrame(char type, const uint8_t *data, uint32_t len);
+    void beginFrame();
+    void endFrame(uint32_t usStart, uint32_t usRead);
+    void muteLog(bool isMuted);
+    static bool writeOut(void *context, const uint8_t *data, size_t len);
+};
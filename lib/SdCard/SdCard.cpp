@@ -0,0 +1,239 @@
+/**
+ * Class        SdCard, SdFile, SdDir
+ *
+ * Purpose      Implements the access to the SD card of the CYD:
+ *              - mount() starts VSPI on the pins of the card slot and mounts
+ *                the card for the first user, unmount() ends both for the last.
+ *              - The card and the touch controller both use VSPI, on different
+ *                pins. The clock and data outputs of VSPI can drive both sets of
+ *                pins, but its MISO input is connected to one pin only. Every
+ *                call of SdFile and SdDir connects it to the card with select()
+ *                and back to the touch controller afterwards, so the touch
+ *                screen can be polled between two file operations.
+ *              - SdFile and SdDir keep the callers free of the differences
+ *                between the SD library and the file functions of the host.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      Paths are absolute, e.g. "/images/fern.qoi". In the environment
+ *              "native" they are relative to the directory sdcard/.
+ * References   https://github.com/espressif/arduino-esp32/tree/master/libraries/SD
+ */
+#include "SdCard.h"
+#ifdef NATIVE_BUILD
+#include <sys/stat.h>
+#else
+#include "soc/gpio_sig_map.h"
+#endif
+
+int SdCard::_users = 0;
+
+#ifdef NATIVE_BUILD
+static const char *SD_ROOT = "sdcard";
+
+static const char *hostPath(const char *path)
+{
+  static char buf[96];
+  snprintf(buf, sizeof(buf), "%s%s", SD_ROOT, path);
+  return buf;
+}
+#else
+static SPIClass sdSpi(VSPI);
+#endif
+
+/**
+ * Mount the card, returns false if there is no card
+*/
+bool SdCard::mount()
+{
+  if (_users > 0)
+  {
+    _users++;
+    return true;
+  }
+#ifdef NATIVE_BUILD
+  DIR *root = opendir(SD_ROOT);
+  bool isMounted = root != nullptr;
+  if (root != nullptr) closedir(root);
+#else
+  sdSpi.begin(TF_SCLK, TF_MISO, TF_MOSI, TF_CS);
+  bool isMounted = SD.begin(TF_CS, sdSpi, SD_FREQ);
+  if (! isMounted) sdSpi.end();
+  select(false);
+#endif
+  if (! isMounted)
+  {
+    log_w("No SD card");
+    return false;
+  }
+  _users = 1;
+  return true;
+}
+
+void SdCard::unmount()
+{
+  if (_users == 0 || --_users > 0) return;
+#ifndef NATIVE_BUILD
+  SD.end();
+  sdSpi.end();
+  select(false);
+#endif
+}
+
+/**
+ * Connect the MISO input of VSPI to the card or to the touch controller
+*/
+void SdCard::select(bool isCard)
+{
+#ifndef NATIVE_BUILD
+  pinMatrixInAttach(isCard ? TF_MISO : TP_MISO, VSPIQ_IN_IDX, false);
+#endif
+}
+
+bool SdCard::exists(const char *path)
+{
+#ifdef NATIVE_BUILD
+  struct stat st;
+  return stat(hostPath(path), &st) == 0;
+#else
+  select(true);
+  bool isFound = SD.exists(path);
+  select(false);
+  return isFound;
+#endif
+}
+
+/**
+ * Create a directory, returns true if it exists afterwards
+*/
+bool SdCard::makeDir(const char *path)
+{
+  if (exists(path)) return true;
+#ifdef NATIVE_BUILD
+  return mkdir(hostPath(path), 0755) == 0;
+#else
+  select(true);
+  bool isMade = SD.mkdir(path);
+  select(false);
+  return isMade;
+#endif
+}
+
+bool SdFile::open(const char *path, bool forWriting)
+{
+  close();
+#ifdef NATIVE_BUILD
+  _file = fopen(hostPath(path), forWriting ? "wb" : "rb");
+#else
+  SdCard::select(true);
+  _file = SD.open(path, forWriting ? FILE_WRITE : FILE_READ);
+  SdCard::select(false);
+#endif
+  return isOpen();
+}
+
+void SdFile::close()
+{
+#ifdef NATIVE_BUILD
+  if (_file != nullptr) fclose(_file);
+  _file = nullptr;
+#else
+  if (! _file) return;
+  SdCard::select(true);
+  _file.close();
+  SdCard::select(false);
+#endif
+}
+
+bool SdFile::isOpen()
+{
+#ifdef NATIVE_BUILD
+  return _file != nullptr;
+#else
+  return (bool)_file;
+#endif
+}
+
+size_t SdFile::read(uint8_t *data, size_t len)
+{
+  if (! isOpen()) return 0;
+#ifdef NATIVE_BUILD
+  return fread(data, 1, len, _file);
+#else
+  SdCard::select(true);
+  size_t n = _file.read(data, len);
+  SdCard::select(false);
+  return n;
+#endif
+}
+
+size_t SdFile::write(const uint8_t *data, size_t len)
+{
+  if (! isOpen()) return 0;
+#ifdef NATIVE_BUILD
+  return fwrite(data, 1, len, _file);
+#else
+  SdCard::select(true);
+  size_t n = _file.write(data, len);
+  SdCard::select(false);
+  return n;
+#endif
+}
+
+bool SdDir::open(const char *path)
+{
+  close();
+#ifdef NATIVE_BUILD
+  _dir = opendir(hostPath(path));
+  return _dir != nullptr;
+#else
+  SdCard::select(true);
+  _dir = SD.open(path);
+  bool isDir = _dir && _dir.isDirectory();
+  SdCard::select(false);
+  return isDir;
+#endif
+}
+
+void SdDir::close()
+{
+#ifdef NATIVE_BUILD
+  if (_dir != nullptr) closedir(_dir);
+  _dir = nullptr;
+#else
+  if (! _dir) return;
+  SdCard::select(true);
+  _dir.close();
+  SdCard::select(false);
+#endif
+}
+
+/**
+ * Name of the next file of the directory, subdirectories
+ * are skipped. Returns false after the last file.
+*/
+bool SdDir::nextFile(char *name, size_t size)
+{
+#ifdef NATIVE_BUILD
+  struct dirent *entry;
+  while (_dir != nullptr && (entry = readdir(_dir)) != nullptr)
+  {
+    if (entry->d_type == DT_DIR) continue;
+    snprintf(name, size, "%s", entry->d_name);
+    return true;
+  }
+  return false;
+#else
+  bool isFound = false;
+  SdCard::select(true);
+  while (_dir && ! isFound)
+  {
+    File entry = _dir.openNextFile();
+    if (! entry) break;
+    if (entry.isDirectory()) continue;
+    snprintf(name, size, "%s", entry.name());
+    isFound = true;
+  }
+  SdCard::select(false);
+  return isFound;
+#endif
+}
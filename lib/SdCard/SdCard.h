@@ -0,0 +1,69 @@
+/**
+ * SdCard.h
+ *
+ * Declaration of the classes SdCard, SdFile and SdDir, the access to the
+ * SD card shared by SdImages and ScreenCapture. SdCard mounts the card on
+ * its own pins (TF_MOSI, TF_MISO, TF_SCLK, TF_CS) and counts the users,
+ * the card is unmounted when the last one is done. SdFile and SdDir wrap
+ * the file functions of the SD library and connect the card to the MISO
+ * input of VSPI for the duration of each call. In the environment "native"
+ * the directory sdcard/ of the working directory replaces the card.
+ */
+#pragma once
+#include <Arduino.h>
+#ifdef NATIVE_BUILD
+#include <dirent.h>
+#else
+#include <SD.h>
+#include <SPI.h>
+#endif
+
+class SdCard
+{
+  public:
+    static constexpr uint32_t SD_FREQ = 25000000;
+
+    static bool mount();
+    static void unmount();
+    static bool isMounted() { return _users > 0; }
+    static void select(bool isCard);
+    static bool exists(const char *path);
+    static bool makeDir(const char *path);
+
+  private:
+    static int _users;
+};
+
+class SdFile
+{
+  public:
+    ~SdFile() { close(); }
+    bool open(const char *path, bool forWriting = false);
+    void close();
+    bool isOpen();
+    size_t read(uint8_t *data, size_t len);
+    size_t write(const uint8_t *data, size_t len);
+
+  private:
+#ifdef NATIVE_BUILD
+    FILE *_file = nullptr;
+#else
+    File _file;
+#endif
+};
+
+class SdDir
+{
+  public:
+    ~SdDir() { close(); }
+    bool open(const char *path);
+    void close();
+    bool nextFile(char *name, size_t size);
+
+  private:
+#ifdef NATIVE_BUILD
+    DIR  *_dir = nullptr;
+#else
+    File _dir;
+#endif
+};
@@ -0,0 +1,230 @@
+/**
+ * Class        SdImages
+ *
+ * Purpose      Implements a class SdImages which shows images from the SD card
+ *              without holding them in memory:
+ *              - The file is read in chunks of CHUNK_SIZE bytes by the
+ *                ChunkReader of an ImageDecoder, which recognizes RLE565 and
+ *                QOI files by their magic.
+ *              - A StripPipeline with two DMA buffers asks for the screen strip
+ *                by strip. renderStrip() decodes the rows of the image into the
+ *                strip and fills the rest of the screen black. While the DMA
+ *                sends a strip to the panel on HSPI, the next chunk is read from
+ *                the card on VSPI and decoded, so reading and writing overlap.
+ *              - The time spent in the file reads is measured separately, the
+ *                rest of the render time is decoding. The time to pixels runs
+ *                from the call of show() until the last strip is on the panel.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      The images are decoded on core 1 only, a stream cannot be decoded
+ *              out of order by a second core. SdCard switches the MISO input of
+ *              VSPI between the card and the touch controller for every chunk,
+ *              so a touch can abort show() between two strips.
+ * References   https://qoiformat.org
+ */
+#include "SdImages.h"
+
+/**
+ * Mount the card and allocate the chunk and the strip buffers,
+ * returns false if there is no card or not enough memory
+*/
+bool SdImages::begin()
+{
+  end();
+  _chunk   = (uint8_t *)malloc(CHUNK_SIZE);
+  _scratch = (uint16_t *)malloc(_lcd.width() * sizeof(uint16_t));
+  if (_chunk == nullptr || _scratch == nullptr || ! _pipeline.begin(STRIP_ROWS, 2, false))
+  {
+    log_e("Not enough memory for the image buffers");
+    end();
+    return false;
+  }
+  _isMounted = SdCard::mount();
+  if (! _isMounted) end();
+  return _isMounted;
+}
+
+void SdImages::end()
+{
+  _dir.close();
+  if (_isMounted) SdCard::unmount();
+  _isMounted = false;
+  _pipeline.end();
+  free(_chunk);
+  free(_scratch);
+  _chunk   = nullptr;
+  _scratch = nullptr;
+}
+
+/**
+ * Start listing the images of a directory
+*/
+bool SdImages::openDir(const char *path)
+{
+  if (! _isMounted) return false;
+  snprintf(_dirPath, sizeof(_dirPath), "%s", path);
+  return _dir.open(path);
+}
+
+/**
+ * Path of the next .qoi or .rle file of the directory,
+ * returns false after the last one
+*/
+bool SdImages::nextImage(char *path, size_t size)
+{
+  char name[64];
+
+  while (_dir.nextFile(name, sizeof(name)))
+  {
+    const char *ext = strrchr(name, '.');
+    if (ext != nullptr && (strcasecmp(ext, ".qoi") == 0 || strcasecmp(ext, ".rle") == 0))
+    {
+      snprintf(path, size, "%s/%s", _dirPath, name);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Show the image centered on the screen, isAborted is polled after
+ * every strip. Returns IMAGE_ABORTED if isAborted stopped it and
+ * IMAGE_FAILED if the file cannot be read or decoded.
+*/
+ShowResult SdImages::show(const char *path, AbortCallback isAborted)
+{
+  if (! _isMounted) return IMAGE_FAILED;
+  _usStart = micros();
+  _stats = {};
+
+  if (! _file.open(path))
+  {
+    log_w("Cannot open %s", path);
+    return IMAGE_FAILED;
+  }
+
+  ShowResult result = IMAGE_FAILED;
+  bool isOk = _decoder.begin(readChunk, this, _chunk, CHUNK_SIZE);
+  _stats.usOpen = micros() - _usStart;
+  if (isOk)
+  {
+    int w = _decoder.width();
+    int h = _decoder.height();
+    _x0 = (_lcd.width() - w) / 2;
+    _y0 = (_lcd.height() - h) / 2;
+    if (_y0 < 0) skipPixels(-_y0 * w);
+    uint32_t usReadHeader = _stats.usRead;
+    result = _pipeline.run(renderStrip, this, isAborted) ? IMAGE_SHOWN : IMAGE_ABORTED;
+
+    const PipelineStats &ps = _pipeline.getStats();
+    _stats.width      = w;
+    _stats.height     = h;
+    _stats.format     = _decoder.getFormat();
+    _stats.isCorrupt  = _decoder.isCorrupt();
+    _stats.usToPixels = micros() - _usStart;
+    _stats.usDecode   = ps.usRender - min(ps.usRender, _stats.usRead - usReadHeader);
+    _stats.overlap    = ps.overlap;
+  }
+  else
+  {
+    log_w("%s is neither RLE565 nor QOI", path);
+  }
+  _file.close();
+  if (result != IMAGE_SHOWN) return result;
+
+  ImageStats &s = _stats;
+  s.kBytesPerSec  = s.usRead > 0 ? (uint32_t)(1e6f / 1024 * s.bytes / s.usRead) : 0;
+  s.mPixelsPerSec = s.usDecode > 0 ? (float)s.pixels / s.usDecode : 0.0f;
+  log_i("%s: %u x %u, %u bytes, %u pixels decoded, on the panel after %u us%s", path, s.width, s.height,
+        s.bytes, s.pixels, s.usToPixels, s.isCorrupt ? ", corrupt" : "");
+  return s.isCorrupt ? IMAGE_FAILED : IMAGE_SHOWN;
+}
+
+/**
+ * ByteSource of the decoder
+*/
+size_t SdImages::readChunk(void *context, uint8_t *data, size_t len)
+{
+  SdImages *s = (SdImages *)context;
+  uint32_t usStart = micros();
+  size_t n = s->_file.read(data, len);
+  s->_stats.usRead += micros() - usStart;
+  s->_stats.bytes  += n;
+  return n;
+}
+
+/**
+ * Decode and drop n pixels of rows or columns outside the screen
+*/
+void SdImages::skipPixels(uint32_t n)
+{
+  while (n > 0)
+  {
+    uint32_t m = min(n, (uint32_t)_lcd.width());
+    uint32_t got = _decoder.decode(_scratch, m);
+    _stats.pixels += got;
+    if (got < m) return;
+    n -= m;
+  }
+}
+
+/**
+ * Decode the visible part of the next row of the image into a
+ * screen row, missing pixels of a truncated file are black
+*/
+void SdImages::decodeRow(uint16_t *row)
+{
+  int width = _lcd.width();
+  int w = _decoder.width();
+  int x = max(_x0, 0);
+  int n = min(w, width);
+
+  memset(row, 0, width * sizeof(uint16_t));
+  if (_x0 < 0) skipPixels(-_x0);
+  uint32_t got = _decoder.decode(row + x, n);
+  _stats.pixels += got;
+  if (_x0 < 0) skipPixels(w - width + _x0);
+}
+
+/**
+ * StripRenderer of show()
+*/
+void SdImages::renderStrip(void *context, uint16_t *strip, int y0, int rows)
+{
+  SdImages *s = (SdImages *)context;
+  int width = s->_lcd.width();
+
+  for (int r = 0; r < rows; r++)
+  {
+    int y = y0 + r;
+    uint16_t *row = strip + r * width;
+    if (y < s->_y0 || y >= s->_y0 + s->_decoder.height())
+    {
+      memset(row, 0, width * sizeof(uint16_t));
+    }
+    else
+    {
+      s->decodeRow(row);
+    }
+  }
+  if (s->_stats.usFirstPixels == 0) s->_stats.usFirstPixels = micros() - s->_usStart;
+}
+
+void SdImages::printStats(const char *path)
+{
+  const ImageStats &s = _stats;
+  Serial.printf(R"(
+Image %s
+--------------------------
+format          %8s  %u x %u%s
+bytes read      %8u
+open + header   %8u us
+read            %8u us  (%u kB/s)
+decode          %8u us  (%.2f Mpixel/s)
+first pixels    %8u us
+time to pixels  %8u us
+DMA overlap     %8.0f %%
+)", path, s.format == IMG_QOI ? "QOI" : "RLE565", s.width, s.height, s.isCorrupt ? "  corrupt" : "",
+    s.bytes, s.usOpen, s.usRead, s.kBytesPerSec, s.usDecode, s.mPixelsPerSec,
+    s.usFirstPixels, s.usToPixels, 100.0f * s.overlap);
+}
@@ -0,0 +1,72 @@
+/**
+ * SdImages.h
+ *
+ * Declaration of the class SdImages, which shows RLE565 (.rle) and QOI
+ * (.qoi) images stored on the SD card. A file is read in chunks of 2 kB
+ * and decoded strip by strip into the DMA buffers of a StripPipeline, so
+ * a full screen image needs about 12 kB of RAM. Images are centered, larger
+ * images are cropped. show() reports the read and decode throughput and
+ * the time until the pixels are on the panel.
+ * The constructor needs a reference to the LGFX object.
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+#include "ImageCodec.h"
+#include "StripPipeline.h"
+#include "SdCard.h"
+
+enum ShowResult : uint8_t { IMAGE_SHOWN, IMAGE_ABORTED, IMAGE_FAILED };
+
+struct ImageStats
+{
+  uint32_t bytes;                   // read from the file
+  uint32_t pixels;                  // decoded
+  uint16_t width, height;
+  ImageFormat format;
+  bool     isCorrupt;
+  uint32_t usOpen;                  // open the file and read the header
+  uint32_t usFirstPixels;           // until the first strip goes to the panel
+  uint32_t usToPixels;              // until the last strip is on the panel
+  uint32_t usRead;                  // reading the file
+  uint32_t usDecode;                // decoding without reading
+  uint32_t kBytesPerSec;            // read throughput
+  float    mPixelsPerSec;           // decode throughput
+  float    overlap;                 // share of the DMA time hidden by reading and decoding
+};
+
+class SdImages
+{
+  public:
+    static constexpr int    STRIP_ROWS = 8;
+    static constexpr size_t CHUNK_SIZE = 2048;
+
+    SdImages(LGFX &lcd) : _lcd(lcd), _pipeline(lcd) {}
+    ~SdImages() { end(); }
+    bool begin();
+    void end();
+    bool openDir(const char *path);
+    bool nextImage(char *path, size_t size);
+    ShowResult show(const char *path, AbortCallback isAborted = nullptr);
+    const ImageStats &getStats() { return _stats; }
+    void printStats(const char *path);
+
+  private:
+    LGFX          &_lcd;
+    StripPipeline _pipeline;
+    ImageDecoder  _decoder;
+    ImageStats    _stats = {};
+    uint8_t       *_chunk = nullptr;       // CHUNK_SIZE bytes read from the file
+    uint16_t      *_scratch = nullptr;     // one screen row of cropped pixels
+    bool          _isMounted = false;
+    char          _dirPath[32] = "";
+    int           _x0, _y0;                // position of the image on the screen
+    uint32_t      _usStart;
+    SdFile        _file;
+    SdDir         _dir;
+
+    void skipPixels(uint32_t n);
+    void decodeRow(uint16_t *row);
+    static size_t readChunk(void *context, uint8_t *data, size_t len);
+    static void renderStrip(void *context, uint16_t *strip, int y0, int rows);
+};
@@ -0,0 +1,239 @@
+/**
+ * Class        SpiTuner
+ *
+ * Purpose      Finds the fastest SPI write clock at which the panel stores the
+ *              transmitted pixels without errors. The clock of the SPI master
+ *              is 80 MHz divided by an integer, tune() steps it from the slowest
+ *              to the fastest divisor:
+ *              - Test patterns (checkerboard 0xAAAA/0x5555, walking bit and
+ *                pseudo random) are written to 3 bands of the screen and read
+ *                back with readRect(). The read clock is not changed, so an
+ *                error is a write error.
+ *              - The fillScreen() throughput is measured at each step.
+ *              - The first step with errors ends the sweep. The tuned clock
+ *                is marginSteps divisors below the fastest error-free one.
+ *              The tuned clock is stored in NVS, begin() applies it at boot.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      A garbled command at a too fast clock can change the rotation,
+ *              inversion or sleep state of the panel, which is restored after
+ *              the sweep. The SPI clock is also limited by the wiring, so the
+ *              result is valid for the tested board only.
+ * References   https://github.com/lovyan03/LovyanGFX/blob/master/src/lgfx/v1/platforms/esp32/Bus_SPI.cpp
+ */
+#include "SpiTuner.h"
+#include <Preferences.h>
+
+static const char *NVS_NAMESPACE = "spitune";
+static const char *NVS_KEY_FREQ  = "freqWrite";
+
+static constexpr int BAND_ROWS    = 10;
+static constexpr int NBR_BANDS    = 3;
+static constexpr int NBR_PATTERNS = 3;
+static constexpr int ROUNDS       = 2;
+static constexpr int NBR_FILLS    = 8;
+
+/**
+ * Apply the clock stored by tune(), returns the clock
+ * or 0 if the panel was never tuned
+*/
+uint32_t SpiTuner::begin()
+{
+  Preferences prefs;
+
+  prefs.begin(NVS_NAMESPACE, true);
+  _tunedFreq = prefs.getUInt(NVS_KEY_FREQ, 0);
+  prefs.end();
+  if (_tunedFreq < APB_FREQ / 255 || _tunedFreq > APB_FREQ)
+  {
+    _tunedFreq = 0;
+    return 0;
+  }
+  _lcd.setWriteFreq(_tunedFreq);
+  log_i("SPI write clock %.2f MHz", _tunedFreq / 1e6f);
+  return _tunedFreq;
+}
+
+/**
+ * Step the write clock from APB_FREQ / slowestDivisor to APB_FREQ / fastestDivisor,
+ * store and apply the tuned clock. Returns the tuned clock, or 0 if no step
+ * was error-free, in which case the clock is left unchanged.
+*/
+uint32_t SpiTuner::tune(uint8_t slowestDivisor, uint8_t fastestDivisor, uint8_t marginSteps)
+{
+  uint8_t  rotation  = _lcd.getRotation();
+  uint32_t savedFreq = _lcd.getWriteFreq();
+  size_t   bandSize  = _lcd.width() * BAND_ROWS * sizeof(uint16_t);
+  int      lastPassed = -1;
+
+  _written  = (uint16_t *)malloc(bandSize);
+  _readBack = (uint16_t *)malloc(bandSize);
+  if (_written == nullptr || _readBack == nullptr)
+  {
+    log_e("No memory for the test bands");
+    free(_written);
+    free(_readBack);
+    return 0;
+  }
+
+  _nbrSteps = 0;
+  fastestDivisor = max(fastestDivisor, (uint8_t)1);
+  for (int div = slowestDivisor; div >= fastestDivisor && _nbrSteps < MAX_STEPS; div--)
+  {
+    ClockStep &s = _steps[_nbrSteps++];
+    s.divisor = div;
+    s.freq    = APB_FREQ / div;
+    _lcd.setWriteFreq(s.freq);
+    s.errors       = verify(s.pixelsChecked);
+    s.passed       = s.errors == 0;
+    s.fillMBPerSec = measureFill();
+    log_i("%5.2f MHz: %u errors in %u pixels, fill %.2f MB/s",
+          s.freq / 1e6f, s.errors, s.pixelsChecked, s.fillMBPerSec);
+    if (! s.passed) break;   // faster clocks fail as well
+    lastPassed = _nbrSteps - 1;
+  }
+  free(_written);
+  free(_readBack);
+  _written = _readBack = nullptr;
+
+  if (lastPassed < 0)
+  {
+    log_w("No error-free write clock, readback not possible?");
+    _lcd.setWriteFreq(savedFreq);
+    restorePanel(rotation);
+    return 0;
+  }
+
+  _tunedFreq = _steps[max(lastPassed - marginSteps, 0)].freq;
+  _lcd.setWriteFreq(_tunedFreq);
+  restorePanel(rotation);
+
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putUInt(NVS_KEY_FREQ, _tunedFreq);
+  prefs.end();
+  return _tunedFreq;
+}
+
+/**
+ * Remove the tuned clock from NVS, the configured
+ * clock is used after the next reset
+*/
+void SpiTuner::forget()
+{
+  Preferences prefs;
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.remove(NVS_KEY_FREQ);
+  prefs.end();
+  _tunedFreq = 0;
+}
+
+/**
+ * Write all patterns to all bands and read them back,
+ * returns the number of wrong pixels
+*/
+uint32_t SpiTuner::verify(uint32_t &pixelsChecked)
+{
+  int      w = _lcd.width();
+  int      n = w * BAND_ROWS;
+  int      bandY[NBR_BANDS] = { 0, (_lcd.height() - BAND_ROWS) / 2, _lcd.height() - BAND_ROWS };
+  uint32_t seed   = 0x9E3779B9;
+  uint32_t errors = 0;
+
+  pixelsChecked = 0;
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    for (int pattern = 0; pattern < NBR_PATTERNS; pattern++)
+    {
+      for (int band = 0; band < NBR_BANDS; band++)
+      {
+        uint16_t *p = _written;
+        for (int y = 0; y < BAND_ROWS; y++)
+        {
+          for (int x = 0; x < w; x++)
+          {
+            switch (pattern)
+            {
+              case 0:  *p++ = ((x ^ y) & 1) ? 0xAAAA : 0x5555; break;
+              case 1:  *p++ = 1 << ((x + y + band + round) & 15); break;
+              default: seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                       *p++ = seed >> 16; break;
+            }
+          }
+        }
+        memset(_readBack, 0, n * sizeof(uint16_t));
+        _lcd.pushImage(0, bandY[band], w, BAND_ROWS, (lgfx::swap565_t*)_written);
+        _lcd.readRect(0, bandY[band], w, BAND_ROWS, (lgfx::swap565_t*)_readBack);
+        for (int i = 0; i < n; i++) errors += _written[i] != _readBack[i];
+        pixelsChecked += n;
+      }
+    }
+  }
+  return errors;
+}
+
+/**
+ * Fill the screen NBR_FILLS times, returns the throughput in MB/s
+*/
+float SpiTuner::measureFill()
+{
+  _lcd.startWrite();
+  uint32_t usStart = micros();
+  for (int i = 0; i < NBR_FILLS; i++) _lcd.fillScreen(i & 1 ? TFT_NAVY : TFT_BLACK);
+  uint32_t usTotal = max(micros() - usStart, (uint32_t)1);
+  _lcd.endWrite();
+  return 2.0f * NBR_FILLS * _lcd.width() * _lcd.height() / usTotal;
+}
+
+/**
+ * Resend the settings a garbled command may have changed
+*/
+void SpiTuner::restorePanel(uint8_t rotation)
+{
+  _lcd.wakeup();
+  _lcd.invertDisplay(false);
+  _lcd.setRotation(rotation);
+  _lcd.fillScreen(TFT_BLACK);
+}
+
+void SpiTuner::printSteps()
+{
+  Serial.printf(R"(
+SPI Write Clock
+---------------
+   MHz  div   errors   checked  fill MB/s
+)");
+  for (int i = 0; i < _nbrSteps; i++)
+  {
+    const ClockStep &s = _steps[i];
+    Serial.printf("%6.2f  %3u  %7u  %8u  %9.2f  %s\n", s.freq / 1e6f, s.divisor,
+                  s.errors, s.pixelsChecked, s.fillMBPerSec, s.passed ? "ok" : "failed");
+  }
+  if (_tunedFreq > 0) Serial.printf("tuned  %.2f MHz\n", _tunedFreq / 1e6f);
+  else                Serial.printf("not tuned\n");
+}
+
+void SpiTuner::showSteps()
+{
+  char s[64];
+  int  y = 2;
+
+  _lcd.fillScreen(TFT_BLACK);
+  _lcd.setTextFont(1);
+  _lcd.setTextSize(1);
+  _lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
+  _lcd.drawString("  MHz   errors  fill MB/s", 2, y);
+  for (int i = 0; i < _nbrSteps; i++)
+  {
+    const ClockStep &st = _steps[i];
+    y += _lcd.fontHeight() + 2;
+    snprintf(s, sizeof(s), "%5.2f  %7u  %9.2f", st.freq / 1e6f, st.errors, st.fillMBPerSec);
+    _lcd.setTextColor(st.passed ? (st.freq == _tunedFreq ? TFT_GREEN : TFT_WHITE) : TFT_RED, TFT_BLACK);
+    _lcd.drawString(s, 2, y);
+  }
+  y += 2 * (_lcd.fontHeight() + 2);
+  _lcd.setTextColor(TFT_SKYBLUE, TFT_BLACK);
+  if (_tunedFreq > 0) snprintf(s, sizeof(s), "write clock %.2f MHz, stored", _tunedFreq / 1e6f);
+  else                snprintf(s, sizeof(s), "write clock %.2f MHz, not tuned", _lcd.getWriteFreq() / 1e6f);
+  _lcd.drawString(s, 2, y);
+}
@@ -0,0 +1,50 @@
+/**
+ * SpiTuner.h
+ *
+ * Declaration of the class SpiTuner, which finds the fastest SPI write
+ * clock the panel accepts without errors. The clock is stepped through
+ * the integer divisors of 80 MHz, at each step test patterns are written
+ * and read back. The tuned clock is stored in NVS and applied by begin().
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+struct ClockStep
+{
+  uint32_t freq;              // write clock in Hz
+  uint8_t  divisor;           // 80 MHz / divisor
+  bool     passed;
+  uint32_t pixelsChecked;
+  uint32_t errors;            // pixels read back with a wrong value
+  float    fillMBPerSec;      // fillScreen throughput, rgb565 pixel data
+};
+
+class SpiTuner
+{
+  public:
+    static constexpr uint32_t APB_FREQ  = 80000000;
+    static constexpr int      MAX_STEPS = 8;
+
+    SpiTuner(LGFX &lcd) : _lcd(lcd) {}
+    uint32_t begin();
+    uint32_t tune(uint8_t slowestDivisor = 8, uint8_t fastestDivisor = 1, uint8_t marginSteps = 1);
+    void forget();
+    uint32_t getTunedFreq() { return _tunedFreq; }
+    const ClockStep *getSteps() { return _steps; }
+    int getNbrSteps() { return _nbrSteps; }
+    void printSteps();
+    void showSteps();
+
+  private:
+    LGFX      &_lcd;
+    ClockStep _steps[MAX_STEPS];
+    int       _nbrSteps  = 0;
+    uint32_t  _tunedFreq = 0;
+    uint16_t  *_written  = nullptr;   // test band and its readback, allocated by tune()
+    uint16_t  *_readBack = nullptr;
+
+    uint32_t verify(uint32_t &pixelsChecked);
+    float    measureFill();
+    void     restorePanel(uint8_t rotation);
+};
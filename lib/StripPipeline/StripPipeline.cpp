@@ -0,0 +1,312 @@
+/**
+ * Class        StripPipeline
+ *
+ * Purpose      Implements a class StripPipeline which overlaps the rendering of
+ *              a screen with its transfer to the panel. The screen is divided
+ *              into strips of stripRows rows, rendered into a ring of DMA buffers:
+ *              - The calling task on core 1 renders a strip and starts its DMA
+ *                transfer, then renders the next strip while the DMA is running.
+ *              - With useWorker a task on core 0 renders strips as well. Both
+ *                cores take the next strip from a shared counter, so a core with
+ *                expensive strips simply renders fewer of them. Only core 1
+ *                talks to the panel, the worker passes its strips in a queue.
+ *              - Every buffer has a state and a fence, the number of the DMA
+ *                transfer reading it. A buffer returns to the free queue only
+ *                after that transfer is known to be finished, so no buffer is
+ *                overwritten while the DMA still reads it.
+ *              Each run() measures the render time of both cores, the time core 1
+ *              waited for the DMA and for the worker, and the transfer time of
+ *              the pixels at the write clock. The share of the transfer time not
+ *              spent waiting is the overlap, 100 % means rendering fully hides
+ *              the transfer.
+ *
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      LovyanGFX runs one DMA transfer at a time and has no completion
+ *              callback, so a fence is passed when dmaBusy() turns false or after
+ *              waitDMA(). The strips are pushed in the order they are finished.
+ *              The worker runs at idle priority so that the idle task of core 0
+ *              still feeds the task watchdog.
+ * References   https://github.com/lovyan03/LovyanGFX/blob/master/src/lgfx/v1/platforms/esp32/Bus_SPI.cpp
+ */
+#include "StripPipeline.h"
+
+static constexpr int WORKER_DONE = -1;   // last message of the worker, no strip
+
+/**
+ * Allocate nbrBuffers strips of stripRows rows. Without the worker 2 buffers
+ * suffice, with the worker 3 are needed: one for each core and one in flight.
+ * Returns false if there is not enough DMA memory.
+*/
+bool StripPipeline::begin(int stripRows, int nbrBuffers, bool useWorker)
+{
+  end();
+  _useWorker  = useWorker;
+  _stripRows  = max(stripRows, 1);
+  _nbrBuffers = constrain(nbrBuffers, useWorker ? 3 : 2, MAX_BUFFERS);
+  _width      = max(_lcd.width(), _lcd.height());
+  for (int i = 0; i < _nbrBuffers; i++)
+  {
+    _buffers[i] = (uint16_t *)heap_caps_malloc(_stripRows * _width * sizeof(uint16_t), MALLOC_CAP_DMA);
+    if (_buffers[i] == nullptr)
+    {
+      log_e("Not enough memory for %d strips of %d rows", _nbrBuffers, _stripRows);
+      end();
+      return false;
+    }
+  }
+  _freeBuffers = xQueueCreate(MAX_BUFFERS, sizeof(int));
+  _rendered    = xQueueCreate(MAX_BUFFERS, sizeof(int));
+  _stripLock   = xSemaphoreCreateMutex();
+  _stats = {};
+  return true;
+}
+
+void StripPipeline::end()
+{
+  for (int i = 0; i < MAX_BUFFERS; i++)
+  {
+    free(_buffers[i]);
+    _buffers[i] = nullptr;
+  }
+  if (_freeBuffers != nullptr) vQueueDelete(_freeBuffers);
+  if (_rendered != nullptr)    vQueueDelete(_rendered);
+  if (_stripLock != nullptr)   vSemaphoreDelete(_stripLock);
+  _freeBuffers = _rendered = nullptr;
+  _stripLock   = nullptr;
+  _nbrBuffers  = 0;
+}
+
+/**
+ * Render rows y0 .. y0 + rows - 1 in strips and push them to the panel.
+ * isAborted is polled after every strip. Returns false if the run was
+ * aborted or begin() failed.
+*/
+bool StripPipeline::run(int y0, int rows, StripRenderer render, void *context, AbortCallback isAborted)
+{
+  if (_nbrBuffers == 0) return false;
+  uint32_t usStart = micros();
+
+  _render    = render;
+  _context   = context;
+  _isAborted = isAborted;
+  _width     = _lcd.width();
+  _y0        = y0;
+  _yEnd      = min(y0 + rows, (int)_lcd.height());
+  _nbrStrips = (_yEnd - _y0 + _stripRows - 1) / _stripRows;
+  _nextStrip = 0;
+  _abort     = false;
+  _pixels    = 0;
+  _usRenderWorker = 0;
+  _stripsWorker   = 0;
+  uint32_t frames = _stats.frames;
+  _stats = {};
+  _stats.frames = frames + 1;
+  for (int i = 0; i < _nbrBuffers; i++)
+  {
+    _state[i] = SB_FREE;
+    xQueueSend(_freeBuffers, &i, 0);
+  }
+
+  if (_useWorker && _nbrStrips > 1)
+  {
+    xTaskCreatePinnedToCore(workerTask, "pipeline", 3072, this, tskIDLE_PRIORITY, &_workerTask, 0);
+  }
+  _lcd.startWrite();
+  for (;;)
+  {
+    int buf   = acquire();
+    int strip = _abort ? -1 : takeStrip();
+    if (strip < 0)
+    {
+      _state[buf] = SB_FREE;
+      xQueueSend(_freeBuffers, &buf, 0);
+      break;
+    }
+    _stats.usRender += renderStrip(buf, strip);
+    transfer(buf, strip);
+    while (pushRendered(0)) {}
+  }
+  while (_workerTask != nullptr)
+  { // the worker needs free buffers to see that all strips are taken
+    if (! pushRendered(1)) retire(true);
+  }
+  while (pushRendered(0)) {}
+  retire(true);
+  _lcd.endWrite();
+
+  // Leave the queues empty for the next run
+  int buf;
+  while (xQueueReceive(_freeBuffers, &buf, 0) == pdTRUE) {}
+
+  PipelineStats &s = _stats;
+  s.usFrame        = micros() - usStart;
+  s.usRenderWorker = _usRenderWorker;
+  s.stripsWorker   = _stripsWorker;
+  s.usTransfer     = (uint32_t)(16.0f * _pixels / (max(_lcd.getWriteFreq(), (uint32_t)1) / 1e6f));
+  s.overlap        = s.usTransfer > 0 ? constrain(1.0f - (float)s.usWaitDMA / s.usTransfer, 0.0f, 1.0f) : 0.0f;
+  log_d("%u strips (%u on core 0) in %u us, render %u + %u us, transfer %u us, overlap %.0f %%",
+        s.strips, s.stripsWorker, s.usFrame, s.usRender, s.usRenderWorker, s.usTransfer, 100.0f * s.overlap);
+  return ! _abort;
+}
+
+/**
+ * Next strip to render or -1 if all are taken
+*/
+int StripPipeline::takeStrip()
+{
+  xSemaphoreTake(_stripLock, portMAX_DELAY);
+  int strip = _nextStrip < _nbrStrips ? _nextStrip++ : -1;
+  xSemaphoreGive(_stripLock);
+  return strip;
+}
+
+/**
+ * Free buffer for core 1. Buffers come back after their transfer
+ * or when the strips rendered by the worker have been pushed.
+*/
+int StripPipeline::acquire()
+{
+  int buf;
+
+  retire(false);
+  while (xQueueReceive(_freeBuffers, &buf, 0) != pdTRUE)
+  {
+    if (pushRendered(0)) continue;
+    if (_transfersDone != _transfersIssued)
+    {
+      retire(true);
+    }
+    else
+    { // all other buffers are rendered by the worker
+      uint32_t usStart = micros();
+      pushRendered(1);
+      _stats.usWaitWorker += micros() - usStart;
+    }
+  }
+  _state[buf] = SB_RENDERING;
+  return buf;
+}
+
+/**
+ * Render a strip into a buffer, returns the render time in us
+*/
+uint32_t StripPipeline::renderStrip(int buf, int strip)
+{
+  uint32_t usStart = micros();
+  int y = _y0 + strip * _stripRows;
+  _render(_context, _buffers[buf], y, min(_stripRows, _yEnd - y));
+  _state[buf] = SB_RENDERED;
+  return micros() - usStart;
+}
+
+/**
+ * Start the DMA transfer of a rendered strip. The previous transfer
+ * must be finished first, which passes its fence.
+*/
+void StripPipeline::transfer(int buf, int strip)
+{
+  int y    = _y0 + strip * _stripRows;
+  int rows = min(_stripRows, _yEnd - y);
+
+  retire(true);
+  _state[buf] = SB_TRANSFERRING;
+  _fence[buf] = ++_transfersIssued;
+  _lcd.pushImageDMA(0, y, _width, rows, (lgfx::swap565_t *)_buffers[buf]);
+  _pixels += rows * _width;
+  _stats.strips++;
+  if (_isAborted != nullptr && ! _abort && _isAborted()) _abort = true;
+}
+
+/**
+ * Push a strip rendered by the worker if one arrives within ticks,
+ * returns false if none arrived. WORKER_DONE clears _workerTask.
+*/
+bool StripPipeline::pushRendered(TickType_t ticks)
+{
+  int msg;
+  if (xQueueReceive(_rendered, &msg, ticks) != pdTRUE) return false;
+  if (msg == WORKER_DONE)
+  {
+    _workerTask = nullptr;
+    return false;
+  }
+  transfer(msg % MAX_BUFFERS, msg / MAX_BUFFERS);
+  return true;
+}
+
+/**
+ * Pass the fences of the finished transfers and return their buffers
+ * to the free queue. With wait, wait for the running transfer.
+*/
+void StripPipeline::retire(bool wait)
+{
+  if (_transfersDone == _transfersIssued) return;
+  if (wait)
+  {
+    uint32_t usStart = micros();
+    _lcd.waitDMA();
+    _stats.usWaitDMA += micros() - usStart;
+  }
+  else if (_lcd.dmaBusy())
+  {
+    return;
+  }
+  _transfersDone = _transfersIssued;
+  for (int i = 0; i < _nbrBuffers; i++)
+  {
+    if (_state[i] == SB_TRANSFERRING && _fence[i] <= _transfersDone)
+    {
+      _state[i] = SB_FREE;
+      xQueueSend(_freeBuffers, &i, 0);
+    }
+  }
+}
+
+/**
+ * Renders strips on core 0 until all are taken. A buffer is taken
+ * before the strip, so a strip is never held without a buffer.
+ * WORKER_DONE is its last message.
+*/
+void StripPipeline::workerTask(void *arg)
+{
+  StripPipeline *p = (StripPipeline *)arg;
+  int buf;
+
+  for (;;)
+  {
+    xQueueReceive(p->_freeBuffers, &buf, portMAX_DELAY);
+    int strip = p->_abort ? -1 : p->takeStrip();
+    if (strip < 0)
+    {
+      xQueueSend(p->_freeBuffers, &buf, 0);
+      break;
+    }
+    p->_state[buf] = SB_RENDERING;
+    p->_usRenderWorker += p->renderStrip(buf, strip);
+    p->_stripsWorker++;
+    int msg = strip * MAX_BUFFERS + buf;
+    xQueueSend(p->_rendered, &msg, portMAX_DELAY);
+  }
+  int done = WORKER_DONE;
+  xQueueSend(p->_rendered, &done, portMAX_DELAY);
+  vTaskDelete(NULL);
+}
+
+void StripPipeline::printStats(const char *name)
+{
+  const PipelineStats &s = _stats;
+  Serial.printf(R"(
+Strip Pipeline %s
+-------------------------
+frames          %8u
+strips          %8u  (%u on core 0)
+frame time      %8u us
+render core 1   %8u us
+render core 0   %8u us
+transfer        %8u us at %.1f MHz
+wait for DMA    %8u us
+wait for core 0 %8u us
+overlap         %8.0f %%
+)", name, s.frames, s.strips, s.stripsWorker, s.usFrame, s.usRender, s.usRenderWorker,
+    s.usTransfer, _lcd.getWriteFreq() / 1e6f, s.usWaitDMA, s.usWaitWorker, 100.0f * s.overlap);
+}
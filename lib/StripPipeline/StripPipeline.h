@@ -0,0 +1,91 @@
+/**
+ * StripPipeline.h
+ *
+ * Declaration of the class StripPipeline, which renders a screen in strips
+ * and sends them to the panel by DMA while the next strips are rendered.
+ * The caller supplies a StripRenderer which fills a strip buffer with byte
+ * swapped rgb565 values. The strips are rendered by the calling task on
+ * core 1 and, optionally, by a worker task on core 0. The constructor needs
+ * a reference to the LGFX object.
+ */
+#pragma once
+#include <Arduino.h>
+#include "lgfx_ESP32_2432S028.h"
+
+using StripRenderer = void (*)(void *context, uint16_t *strip, int y0, int rows);
+using AbortCallback = bool (*)();
+
+enum StripBufferState : uint8_t
+{
+  SB_FREE, SB_RENDERING, SB_RENDERED, SB_TRANSFERRING
+};
+
+struct PipelineStats
+{
+  uint32_t frames;                  // runs since begin()
+  uint16_t strips;                  // strips of the last frame
+  uint16_t stripsWorker;            // of these rendered on core 0
+  uint32_t usFrame;
+  uint32_t usRender;                // rendering on core 1
+  uint32_t usRenderWorker;          // rendering on core 0
+  uint32_t usTransfer;              // DMA time of the pixels at the write clock
+  uint32_t usWaitDMA;               // core 1 waiting for a transfer to finish
+  uint32_t usWaitWorker;            // core 1 waiting for a strip of core 0
+  float    overlap;                 // share of the transfer time hidden by rendering
+};
+
+class StripPipeline
+{
+  public:
+    static constexpr int MAX_BUFFERS = 4;
+
+    StripPipeline(LGFX &lcd) : _lcd(lcd) {}
+    ~StripPipeline() { end(); }
+    bool begin(int stripRows, int nbrBuffers = 3, bool useWorker = true);
+    void end();
+    bool run(StripRenderer render, void *context, AbortCallback isAborted = nullptr)
+    {
+      return run(0, _lcd.height(), render, context, isAborted);
+    }
+    bool run(int y0, int rows, StripRenderer render, void *context, AbortCallback isAborted = nullptr);
+    int  getStripRows() { return _stripRows; }
+    const PipelineStats &getStats() { return _stats; }
+    void printStats(const char *name);
+
+  private:
+    LGFX          &_lcd;
+    uint16_t      *_buffers[MAX_BUFFERS] = {};
+    StripBufferState _state[MAX_BUFFERS];
+    uint32_t      _fence[MAX_BUFFERS];     // transfer reading the buffer
+    uint32_t      _transfersIssued = 0;
+    uint32_t      _transfersDone   = 0;
+    int           _nbrBuffers = 0;
+    int           _stripRows  = 0;
+    int           _width      = 0;
+    bool          _useWorker  = false;
+    uint32_t      _pixels     = 0;         // pushed in the current frame
+    PipelineStats _stats = {};
+
+    // Shared with the worker task on core 0
+    StripRenderer     _render  = nullptr;
+    void             *_context = nullptr;
+    AbortCallback     _isAborted = nullptr;
+    int               _y0, _yEnd;
+    int               _nbrStrips;
+    int               _nextStrip;
+    volatile bool     _abort = false;
+    uint32_t          _usRenderWorker;
+    uint16_t          _stripsWorker;
+    QueueHandle_t     _freeBuffers = nullptr;  // buffers which can be rendered into
+    QueueHandle_t     _rendered    = nullptr;  // strip * MAX_BUFFERS + buffer, from the worker, then WORKER_DONE
+    SemaphoreHandle_t _stripLock   = nullptr;  // guards _nextStrip
+    TaskHandle_t      _workerTask  = nullptr;  // cleared by the caller when WORKER_DONE arrives
+
+    int  takeStrip();
+    int  acquire();
+    void transfer(int buf, int strip);
+    bool pushRendered(TickType_t ticks);
+    void retire(bool wait);
+    uint32_t renderStrip(int buf, int strip);
+    static void workerTask(void *arg);
+};
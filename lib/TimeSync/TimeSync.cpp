@@ -0,0 +1,242 @@
+/**
+ * Class        TimeSync
+ * 
+ * Purpose      Implements a class TimeSync which keeps the RTC of the ESP32 in 
+ *              sync with a NTP server without visible jumps of the clock.
+ *              A minimal SNTP client sends a request every _secInterval seconds 
+ *              and calculates the offset between server and RTC from the four 
+ *              timestamps of the exchange. 
+ *              - Offsets larger than US_STEP_LIMIT are corrected by a step,
+ *                which is only expected for the very first sync.
+ *              - Smaller offsets are corrected by slewing with adjtime().
+ *              - The offset that remains after the previous correction divided
+ *                by the elapsed time is the residual drift of the RTC. It updates
+ *                the drift estimate, which is compensated continuously by small
+ *                slews every SEC_COMPENSATION seconds.
+ *              - As long as the offsets stay below US_STABLE_OFFSET the resync 
+ *                interval is doubled up to _secMaxInterval, otherwise it falls 
+ *                back towards _secMinInterval. Longer intervals give the drift 
+ *                estimate a longer baseline and therefore a higher weight.
+ *              Measured offset, roundtrip delay and drift are reported over serial.
+ * 
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      loop() never blocks, the response is polled on the next calls.
+ *              Samples with a roundtrip delay above US_MAX_DELAY are discarded, 
+ *              e.g. when loop() was not called during a long running action.
+ * References   https://datatracker.ietf.org/doc/html/rfc4330 (SNTP)
+ *              https://man7.org/linux/man-pages/man3/adjtime.3.html
+ */
+#include "TimeSync.h"
+#include <WiFi.h>
+#include <sys/time.h>
+#include "esp_sntp.h"
+
+static constexpr uint16_t NTP_PORT          = 123;
+static constexpr uint32_t NTP_UNIX_OFFSET   = 2208988800UL;  // seconds 1900-01-01 .. 1970-01-01
+static constexpr int      NTP_PACKET_SIZE   = 48;
+static constexpr int64_t  US_STEP_LIMIT     = 500000;        // step the clock above 0.5 s offset
+static constexpr int64_t  US_MAX_DELAY      = 250000;        // discard samples with larger roundtrip
+static constexpr int64_t  US_STABLE_OFFSET  = 10000;         // offset below which the estimate is stable
+static constexpr float    SEC_DRIFT_TAU     = 256.0f;        // time constant of the drift filter
+static constexpr float    PPM_LIMIT         = 500.0f;
+static constexpr uint32_t MS_TIMEOUT        = 2000;
+static constexpr uint32_t SEC_COMPENSATION  = 10;
+
+/**
+ * Start the periodic resync. The SNTP client of the SDK is stopped, 
+ * because it would step the clock on every sync. A drift estimate 
+ * from a previous run can be passed to start with.
+*/
+void TimeSync::begin(float driftPpm)
+{
+  sntp_stop();
+  _driftPpm    = constrain(driftPpm, -PPM_LIMIT, PPM_LIMIT);
+  _usLastComp  = usNow();
+  _msNextQuery = millis();
+  _udp.begin(NTP_PORT);
+  log_i("==> done, drift %.2f ppm", _driftPpm);
+}
+
+void TimeSync::loop()
+{
+  if (_isWaiting) 
+    receiveResponse();
+  else if (WiFi.status() == WL_CONNECTED && (int32_t)(millis() - _msNextQuery) >= 0) 
+    sendRequest();
+
+  if (usNow() - _usLastComp >= SEC_COMPENSATION * 1000000LL) compensateDrift();
+}
+
+void TimeSync::addSyncCb(SyncCallback cb)
+{ _onSync = cb; }
+
+/**
+ * Send a client request, the local transmit time T1 is 
+ * put into the transmit timestamp and returned by the 
+ * server as originate timestamp
+*/
+void TimeSync::sendRequest()
+{
+  uint8_t packet[NTP_PACKET_SIZE] = { 0 };
+
+  while (_udp.parsePacket() > 0) _udp.flush();  // drop stale responses
+  _usRequest = usNow();
+  uint32_t sec  = (uint32_t)(_usRequest / 1000000) + NTP_UNIX_OFFSET;
+  uint32_t frac = (uint32_t)(((_usRequest % 1000000) << 32) / 1000000);
+  packet[0] = 0b00100011;  // LI = 0, version = 4, mode = 3 (client)
+  for (int i = 0; i < 4; i++)
+  {
+    packet[40 + i] = sec  >> (24 - 8 * i);
+    packet[44 + i] = frac >> (24 - 8 * i);
+  }
+  if (_udp.beginPacket(_ntpServer, NTP_PORT) && _udp.write(packet, NTP_PACKET_SIZE) == NTP_PACKET_SIZE && _udp.endPacket())
+  {
+    _isWaiting = true;
+    _msRequest = millis();
+  }
+  else
+  {
+    log_e("Sending NTP request to %s failed", _ntpServer);
+    _msNextQuery = millis() + _secMinInterval * 1000;
+  }
+}
+
+/**
+ * Convert the 64 bit NTP timestamp at p to microseconds since 1970
+*/
+static int64_t ntpToUs(const uint8_t *p)
+{
+  uint32_t sec  = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+  uint32_t frac = (uint32_t)p[4] << 24 | (uint32_t)p[5] << 16 | (uint32_t)p[6] << 8 | p[7];
+  return (int64_t)(sec - NTP_UNIX_OFFSET) * 1000000LL + (((uint64_t)frac * 1000000ULL) >> 32);
+}
+
+/**
+ * Poll for the response and calculate offset and roundtrip delay 
+ * from the timestamps T1 (request sent), T2 (request received by 
+ * the server), T3 (response sent by the server) and T4 (now)
+*/
+void TimeSync::receiveResponse()
+{
+  uint8_t packet[NTP_PACKET_SIZE];
+
+  if (_udp.parsePacket() < NTP_PACKET_SIZE)
+  {
+    if (millis() - _msRequest > MS_TIMEOUT)
+    {
+      log_w("NTP request to %s timed out", _ntpServer);
+      _isWaiting = false;
+      _msNextQuery = millis() + _secMinInterval * 1000;
+    }
+    return;
+  }
+  int64_t t4 = usNow();
+  _udp.read(packet, NTP_PACKET_SIZE);
+  _isWaiting = false;
+  _msNextQuery = millis() + _secMinInterval * 1000;  // retry soon if the sample is rejected
+
+  uint8_t mode    = packet[0] & 0x07;
+  uint8_t stratum = packet[1];
+  int64_t t1 = ntpToUs(&packet[24]);
+  int64_t t2 = ntpToUs(&packet[32]);
+  int64_t t3 = ntpToUs(&packet[40]);
+  if (mode != 4 || stratum == 0 || stratum > 15 || llabs(t1 - _usRequest) > 1)
+  {
+    log_w("Invalid NTP response, mode %d stratum %d", mode, stratum);
+    return;
+  }
+
+  int64_t usDelay  = (t4 - t1) - (t3 - t2);
+  int64_t usOffset = ((t2 - t1) + (t3 - t4)) / 2;
+  if (usDelay < 0 || usDelay > US_MAX_DELAY)
+  {
+    log_w("NTP sample discarded, roundtrip delay %lld us", (long long)usDelay);
+    return;
+  }
+  addSample(usOffset, t4);
+  Serial.printf("NTP offset %+8.3f ms  delay %6.3f ms  drift %+7.3f ppm  next sync in %u s\n",
+                usOffset / 1000.0, usDelay / 1000.0, _driftPpm, _secInterval);
+}
+
+/**
+ * Update drift estimate and resync interval with a new offset
+ * and correct the RTC
+*/
+void TimeSync::addSample(int64_t usOffset, int64_t usLocal)
+{
+  timeval pending;
+
+  _usOffset = (int32_t)constrain(usOffset, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+  if (llabs(usOffset) > US_STEP_LIMIT)
+  { // far off, e.g. first sync after power on, step the clock and start over
+    int64_t us = usNow() + usOffset;
+    timeval tv = { (time_t)(us / 1000000), (suseconds_t)(us % 1000000) };
+    settimeofday(&tv, NULL);
+    _isSynced    = false;
+    _nbrStable   = 0;
+    _secInterval = _secMinInterval;
+    _usLastComp  = usNow();
+    _msNextQuery = millis() + _secInterval * 1000;
+    log_i("RTC stepped by %lld ms", (long long)(usOffset / 1000));
+    return;
+  }
+
+  // The part of the previous correction that is not yet slewed 
+  // must not be counted as drift
+  adjtime(NULL, &pending);
+  int64_t usPending = pending.tv_sec * 1000000LL + pending.tv_usec;
+
+  if (_isSynced)
+  {
+    float secElapsed  = (usLocal - _usLastSample) / 1e6f;
+    float ppmResidual = -(usOffset - usPending) / secElapsed;
+    float gain        = secElapsed / (secElapsed + SEC_DRIFT_TAU);  // trust long baselines more
+    _driftPpm = constrain(_driftPpm + gain * ppmResidual, -PPM_LIMIT, PPM_LIMIT);
+
+    if (llabs(usOffset) < US_STABLE_OFFSET)
+    { // estimate has settled, back off
+      if (++_nbrStable >= 2 && _secInterval < _secMaxInterval) _secInterval *= 2;
+    }
+    else
+    {
+      _nbrStable = 0;
+      _secInterval = max(_secMinInterval, _secInterval / 4);
+    }
+  }
+  _isSynced     = true;
+  _usLastSample = usLocal;
+  slew(usOffset - usPending);
+  _msNextQuery = millis() + _secInterval * 1000;
+  if (_onSync) _onSync((uint32_t)(usNow() / 1000000), _driftPpm);
+}
+
+/**
+ * Slew out the drift accumulated since the last compensation
+*/
+void TimeSync::compensateDrift()
+{
+  int64_t now = usNow();
+  int64_t usCorrection = (int64_t)(-_driftPpm * (now - _usLastComp) / 1e6f);
+  _usLastComp = now;
+  if (usCorrection != 0) slew(usCorrection);
+}
+
+/**
+ * Add a correction to the adjustment that is still in progress
+*/
+void TimeSync::slew(int64_t usCorrection)
+{
+  timeval pending, delta;
+  adjtime(NULL, &pending);
+  int64_t us = pending.tv_sec * 1000000LL + pending.tv_usec + usCorrection;
+  delta.tv_sec  = us / 1000000;
+  delta.tv_usec = us % 1000000;
+  if (adjtime(&delta, NULL) != 0) log_e("adjtime failed for %lld us", (long long)us);
+}
+
+int64_t TimeSync::usNow()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
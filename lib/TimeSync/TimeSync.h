@@ -0,0 +1,58 @@
+/**
+ * TimeSync.h
+ * 
+ * Declaration of the class TimeSync. It periodically queries a NTP server,
+ * estimates the drift of the RTC from successive offsets and corrects the 
+ * RTC by slewing with adjtime() instead of stepping with settimeofday().
+ * The constructor needs the name of the NTP server and optionally the 
+ * minimal and maximal resync interval in seconds.
+ */ 
+#pragma once
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+using SyncCallback = void (*)(uint32_t epochSynced, float driftPpm);
+
+class TimeSync
+{
+  public:
+    TimeSync(const char *ntpServer, uint32_t secMinInterval = 64, uint32_t secMaxInterval = 4096) : 
+      _ntpServer(ntpServer),
+      _secMinInterval(secMinInterval),
+      _secMaxInterval(secMaxInterval),
+      _secInterval(secMinInterval)
+    {
+    }
+
+    void begin(float driftPpm = 0.0f);
+    void loop();
+    void addSyncCb(SyncCallback cb);
+    float    getDriftPpm()    { return _driftPpm; }
+    int32_t  getUsOffset()    { return _usOffset; }
+    uint32_t getSecInterval() { return _secInterval; }
+
+  private:
+    const char *_ntpServer;
+    uint32_t _secMinInterval;
+    uint32_t _secMaxInterval;
+    uint32_t _secInterval;
+    WiFiUDP  _udp;
+    bool     _isWaiting    = false;   // request sent, waiting for the response
+    bool     _isSynced     = false;   // at least one valid sample received
+    int64_t  _usRequest    = 0;       // local time when the request was sent (T1)
+    int64_t  _usLastSample = 0;       // local time of the last valid sample
+    int64_t  _usLastComp   = 0;       // local time of the last drift compensation
+    uint32_t _msNextQuery  = 0;
+    uint32_t _msRequest    = 0;
+    int32_t  _usOffset     = 0;       // last measured offset server - local
+    float    _driftPpm     = 0.0f;    // positive if the RTC runs fast
+    uint8_t  _nbrStable    = 0;       // number of successive stable samples
+    SyncCallback _onSync   = nullptr;
+
+    void sendRequest();
+    void receiveResponse();
+    void addSample(int64_t usOffset, int64_t usLocal);
+    void compensateDrift();
+    void slew(int64_t usCorrection);
+    static int64_t usNow();
+};
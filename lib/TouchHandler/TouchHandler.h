@@ -1,3 +1,4 @@
+#pragma once
 #include "lgfx_ESP32_2432S028.h"
 
 using Callback = void (*)(int x, int y);
@@ -0,0 +1,138 @@
+/**
+ * Class        WiFiScanner
+ * 
+ * Purpose      Implements a class WiFiScanner which scans for nearby WiFi networks
+ *              without blocking the caller. loop() starts an asynchronous scan 
+ *              every msInterval milliseconds and polls for its completion. The
+ *              results are copied into a fixed-size cache of MAX_NETWORKS entries
+ *              with SSID, RSSI, channel and authentication mode. Networks with the 
+ *              same SSID (e.g. several access points of a mesh) are merged and 
+ *              only the strongest is kept. Hidden networks have no SSID, they
+ *              are told apart by the BSSID of their access point. The cache is sorted by signal strength,
+ *              if it is full the weakest networks are dropped.
+ *              The cache stays valid while the next scan is running.
+ * 
+ * Board        ESP32 / ESP32-2432S028R (CYD Cheap Yellow Display)
+ * Remarks      No scan is started while the WiFi connection is being established,
+ *              because scanning would delay the connection. connecting() marks the
+ *              start of WiFi.begin(), for up to msTimeout afterwards the scans wait
+ *              while the status is WL_IDLE_STATUS or WL_DISCONNECTED. Later, e.g.
+ *              after the connection was lost, the scans run in any state.
+ * References   https://docs.espressif.com/projects/arduino-esp32/en/latest/api/wifi.html
+ */
+#include "WiFiScanner.h"
+
+/**
+ * Start the first scan immediately
+*/
+void WiFiScanner::begin()
+{
+  _waitScan.begin();
+  startScan();
+  log_i("==> done");
+}
+
+void WiFiScanner::loop()
+{
+  if (_isScanning)
+  {
+    int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) return;
+    _isScanning = false;
+    if (n >= 0) 
+    {
+      collectResults(n);
+      if (_onScanDone) _onScanDone();
+    }
+    else
+    {
+      log_w("WiFi scan failed");
+    }
+    WiFi.scanDelete();  // free the memory of the scan results
+  }
+  else if (_waitScan.isOver())
+  {
+    startScan();
+  }
+}
+
+void WiFiScanner::addScanDoneCb(ScanDoneCallback cb)
+{ _onScanDone = cb; }
+
+const char *WiFiScanner::authName(uint8_t auth)
+{
+  static const char *names[] = {"open", "WEP", "WPA", "WPA2", "WPA/2", "WPA2-E", "WPA3", "WPA2/3", "WAPI"};
+  return auth < sizeof(names) / sizeof(names[0]) ? names[auth] : "?";
+}
+
+/**
+ * Defer the scans while the connection started now is established,
+ * at most for msTimeout
+*/
+void WiFiScanner::connecting(uint32_t msTimeout)
+{
+  _msConnectStart   = millis();
+  _msConnectTimeout = msTimeout;
+}
+
+void WiFiScanner::startScan()
+{
+  wl_status_t status = WiFi.status();
+  if ((status == WL_IDLE_STATUS || status == WL_DISCONNECTED) && 
+      millis() - _msConnectStart < _msConnectTimeout) return;  // still connecting, try again next interval
+  if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
+  {
+    log_w("WiFi scan could not be started");
+    return;
+  }
+  _isScanning = true;
+}
+
+void WiFiScanner::collectResults(int n)
+{
+  _nbrNetworks = 0;
+  for (int i = 0; i < n; i++)
+  {
+    insert(WiFi.SSID(i).c_str(), WiFi.BSSID(i), WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i));
+  }
+  _scanCount++;
+  _msLastScan = millis();
+}
+
+/**
+ * Insert a network sorted by RSSI. A network with an already known SSID, 
+ * or a hidden one with a known BSSID, replaces the weaker entry, networks
+ * weaker than all cached ones are dropped when the cache is full.
+*/
+void WiFiScanner::insert(const char *ssid, const uint8_t *bssid, int8_t rssi, uint8_t channel, uint8_t auth)
+{
+  static const uint8_t noBssid[6] = {0};
+  int i;
+
+  if (bssid == nullptr) bssid = noBssid;
+  for (i = 0; i < _nbrNetworks; i++)
+  {
+    if (ssid[0] == '\0' ? _networks[i].ssid[0] == '\0' && memcmp(_networks[i].bssid, bssid, 6) == 0
+                        : strncmp(_networks[i].ssid, ssid, sizeof(_networks[i].ssid) - 1) == 0) break;
+  }
+  if (i < _nbrNetworks)
+  { // duplicate network, keep the stronger one
+    if (_networks[i].rssi >= rssi) return;
+    memmove(&_networks[i], &_networks[i + 1], (_nbrNetworks - i - 1) * sizeof(NetworkInfo));
+    _nbrNetworks--;
+  }
+
+  // find the position and shift the weaker entries down
+  for (i = _nbrNetworks; i > 0 && _networks[i - 1].rssi < rssi; i--)
+  {
+    if (i < MAX_NETWORKS) _networks[i] = _networks[i - 1];
+  }
+  if (i >= MAX_NETWORKS) return;  // weaker than all cached networks
+  if (_nbrNetworks < MAX_NETWORKS) _nbrNetworks++;
+
+  strlcpy(_networks[i].ssid, ssid, sizeof(_networks[i].ssid));
+  memcpy(_networks[i].bssid, bssid, sizeof(_networks[i].bssid));
+  _networks[i].rssi    = rssi;
+  _networks[i].channel = channel;
+  _networks[i].auth    = auth;
+}
@@ -0,0 +1,57 @@
+/**
+ * WiFiScanner.h
+ * 
+ * Declaration of the class WiFiScanner. It scans for nearby WiFi networks 
+ * in the background every msInterval milliseconds, which is passed to the
+ * constructor, and keeps the results in a small fixed-size cache.
+ */ 
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include "Wait.h"
+
+struct NetworkInfo
+{
+  char    ssid[33];           // empty for a hidden network
+  uint8_t bssid[6];           // MAC address of the access point
+  int8_t  rssi;
+  uint8_t channel;
+  uint8_t auth;     // wifi_auth_mode_t
+};
+
+using ScanDoneCallback = void (*)();
+
+class WiFiScanner
+{
+  public:
+    WiFiScanner(uint32_t msInterval) : _waitScan(msInterval) {}
+    void begin();
+    void loop();
+    void setInterval(uint32_t msInterval) { _waitScan.msWaitSet(msInterval); }
+    void addScanDoneCb(ScanDoneCallback cb);
+    void connecting(uint32_t msTimeout = MS_CONNECT_TIMEOUT);
+    bool isScanning()       { return _isScanning; }
+    int  getNbrNetworks()   { return _nbrNetworks; }
+    uint32_t getScanCount() { return _scanCount; }   // changes with every completed scan
+    uint32_t msSinceScan()  { return millis() - _msLastScan; }
+    const NetworkInfo &getNetwork(int i) { return _networks[i]; }
+    static const char *authName(uint8_t auth);
+
+    static constexpr int MAX_NETWORKS = 16;
+    static constexpr uint32_t MS_CONNECT_TIMEOUT = 10000;  // scans wait at most this long for a connection
+
+  private:
+    Wait        _waitScan;
+    NetworkInfo _networks[MAX_NETWORKS];
+    int         _nbrNetworks = 0;
+    bool        _isScanning  = false;
+    uint32_t    _scanCount   = 0;
+    uint32_t    _msLastScan  = 0;
+    uint32_t    _msConnectStart   = 0;
+    uint32_t    _msConnectTimeout = 0;  // no connection being established
+    ScanDoneCallback _onScanDone = nullptr;
+
+    void startScan();
+    void collectResults(int n);
+    void insert(const char *ssid, const uint8_t *bssid, int8_t rssi, uint8_t channel, uint8_t auth);
+};
@@ -9,6 +9,9 @@
  * Reference  https://github.com/lovyan03/LovyanGFX/blob/master/examples/HowToUse/2_user_setting
 */
 #pragma once
+#ifdef NATIVE_BUILD
+#include "lgfx_headless.h"  // in-memory panel of the environment "native"
+#else
 #include <LovyanGFX.hpp>
 
 class LGFX : public lgfx::LGFX_Device {
@@ -89,4 +92,19 @@ public:
     
     setPanel(&_panel_instance);  // set the panel to be used.
   }
+
+  // Change the SPI clock for transmit at runtime, the bus rounds it to an
+  // integer divisor of 80 MHz. Must not be called within startWrite().
+  void setWriteFreq(uint32_t freq)
+  {
+    auto cfg = _bus_instance.config();
+    cfg.freq_write = freq;
+    waitDMA();
+    _bus_instance.release();
+    _bus_instance.config(cfg);
+    _bus_instance.init();
+  }
+
+  uint32_t getWriteFreq() { return _bus_instance.config().freq_write; }
 };         
+#endif
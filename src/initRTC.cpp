@@ -19,11 +19,21 @@ const char *WGT_WGST = "WGT3WGST,M3.5.0/-2,M10.5.0/-1";                // Wester
 /**
  * Initialize the ESP32 RTC with local time
  * and close the no longer needed WiFi connection
- * when disconnect is passed as true, default is false
+ * when disconnect is passed as true, default is false.
+ * With waitForSync = false the RTC is assumed to be valid 
+ * already (e.g. after deep sleep), only the time zone is set
+ * and the resync is left to the class TimeSync.
 */
-void initRTC(const char *timeZone, bool disconnect = false)
+void initRTC(const char *timeZone, bool disconnect = false, bool waitForSync = true)
 {
   tm rtcTime;
+  if (! waitForSync)
+  {
+    setenv("TZ", timeZone, 1);
+    tzset();
+    log_i("RTC valid, NTP sync in background");
+    return;
+  }
   configTzTime(timeZone, NTP_SERVER_POOL);
   while(! getLocalTime(&rtcTime))
   {
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include "WiFiScanner.h"
 
 // WiFi credentials 
 const char ssid[]     = "Your SSID";
@@ -9,7 +10,7 @@ const char TIME_ZONE[]       = "MEZ-1MESZ-2,M3.5.0/02:00:00,M10.5.0/03:00:00";
 const char HOST_NAME[]       = "ESP32-CYD"; 
 
 // Forward declarations
-void initWiFi();
+void initWiFi(bool waitForConnection = true);
 void printConnectionDetails();
 void printNearbyNetworks();     
 void printDateTime(int format); // Format: Output
@@ -22,20 +23,24 @@ void printDateTime(int format); // Format: Output
 
 /**
  * Establish the WiFi connection with router 
- * and set a hostname for the ESP32
+ * and set a hostname for the ESP32.
+ * With waitForConnection = false the connection 
+ * is established in the background
 */
-void initWiFi()
+void initWiFi(bool waitForConnection)
 {
+    extern WiFiScanner wifiScanner;
     WiFi.setHostname(HOST_NAME);
     WiFi.begin(ssid, password);
+    wifiScanner.connecting();
 
     // Try forever
-    while (WiFi.status() != WL_CONNECTED) 
+    while (waitForConnection && WiFi.status() != WL_CONNECTED) 
     {
       log_i("Connecting to WiFi ...");
       delay(1000);
     }
-    log_i("... connected");
+    if (waitForConnection) log_i("... connected");
 
     // 👉 The next line prevents the interrupt at GPIO_NUM_36 
     //   from being triggered continuously. This undesirable 
@@ -48,18 +53,22 @@ void initWiFi()
 
 
 /*
- * Print nearby WiFi networks with SSID und RSSI 
+ * Print nearby WiFi networks with SSID, RSSI, channel and 
+ * authentication mode from the cache of the background scan.
+ * Installed as callback of the wifiScanner.
  */
 void printNearbyNetworks()
 {
-  int n = WiFi.scanNetworks();
+  extern WiFiScanner wifiScanner;
   Serial.printf(R"(
 Nearby WiFi networks
 --------------------
 )");
-  for (int i = 0; i < n; i++)
+  for (int i = 0; i < wifiScanner.getNbrNetworks(); i++)
   {
-    Serial.printf("%s\t%d\r\n", WiFi.SSID(i).c_str(), WiFi.RSSI(i));
+    const NetworkInfo &net = wifiScanner.getNetwork(i);
+    Serial.printf("%-32s\t%4d\t%2d\t%s\r\n", net.ssid[0] ? net.ssid : "<hidden>", net.rssi, net.channel,
+                  WiFiScanner::authName(net.auth));
   }
   Serial.println();
 }
@@ -30,25 +30,38 @@
 #include "PulseGen.h"
 #include "Wait.h"
 #include "TouchHandler.h"
+#include "ResumeState.h"
+#include "TimeSync.h"
+#include "WiFiScanner.h"
+#include "SpiTuner.h"
+#include "ScreenCapture.h"
 
 using Action = void(&)(LGFX &lcd);
 
 LGFX lcd;
 GFXfont myFont = fonts::DejaVu18;
 TouchHandler touchHandler(lcd);
+ResumeState  resumeState;
+SpiTuner     spiTuner(lcd);
+ScreenCapture screenCapture(lcd);
 
 extern void nop(LGFX &lcd);
 extern void initDisplay(LGFX &lcd, uint8_t rotation=0, GFXfont *theFont=&myFont, Action greet=nop);
-extern void initRTC(const char *timeZone, bool disconnect = false);
-extern void initWiFi();
+extern void initRTC(const char *timeZone, bool disconnect = false, bool waitForSync = true);
+extern void initWiFi(bool waitForConnection = true);
 extern void printConnectionDetails();
 extern void printDateTime(int format);
 extern void printNearbyNetworks();
 extern void printSystemInfo();
 
 extern const char *MEZ_MESZ;
+extern const char *NTP_SERVER_POOL;
+
+TimeSync timeSync(NTP_SERVER_POOL);
 
 const int MS_REFRESH = 1000;
+const uint32_t MS_WIFI_SCAN  = 30000;          // interval of the background WiFi scan
+const uint32_t MS_IDLE_SLEEP = 5 * 60 * 1000;  // enter deep sleep after 5 min without touch, 0 = never
 const int NBR_DISPLAYED_MENUITEMS = 9;  // Number of menuitems on a page
 
 
@@ -61,6 +74,8 @@ const bool DISCONNECT_WIFI = false;
 const char *timeZone       = MEZ_MESZ; 
 const int  TIME_FORMAT     = 5;  // 0..6 see function printDateTime()
 
+uint32_t msLastActivity = 0;
+
 
 MenuItem menuItems[] =
 {
@@ -76,7 +91,9 @@ MenuItem menuItems[] =
   {"Colored Triangles",     showColoredTriangles},
   {"Sierpinsky Dreieck",    showSierpinskyTriangle},
   {"Mandelbrot Set",        showMandelbrotSet},
+  {"Escape-Time Fractals",  showEscapeTimeFractals},
   {"Barnsley Fern ",        showBarnsleyFern},
+  {"IFS Fractals",          showIFSFractals},
   {"Random Walk",           showRandomWalk},
   {"HSV Color Circle",      showHSVcircle},
   {"RGB Palettes",          showRGB565palettes},
@@ -84,6 +101,10 @@ MenuItem menuItems[] =
   {"Grayscale",             showGrayScale},
   {"Digital Clock",         showDigitalClock},
   {"Analog Clock ",         showAnalogClock},  
+  {"WiFi Networks",         showNearbyNetworks},
+  {"Benchmark",             showBenchmark},
+  {"SPI Clock Tuning",      showSpiTuning},
+  {"SD Card Images",        showSdImages},
 };
 constexpr int nbrMenuItems = sizeof(menuItems) / sizeof(menuItems[0]);
 
@@ -91,6 +112,7 @@ constexpr int nbrMenuItems = sizeof(menuItems) / sizeof(menuItems[0]);
 Menu         menu(lcd, menuItems, nbrMenuItems, NBR_DISPLAYED_MENUITEMS);
 DigitalClock digitalClock = DigitalClock(MS_REFRESH);
 AnalogClock  analogClock  = AnalogClock(MS_REFRESH);
+WiFiScanner  wifiScanner(MS_WIFI_SCAN);
 
 
 /**
@@ -103,6 +125,28 @@ void touched(int x, int y)
 }
 
 
+/**
+ * Remember the menu position in RTC memory and
+ * restart the idle timeout
+*/
+void menuChanged()
+{
+  resumeState.saveMenu(menu.getSelectedMenuItem(), menu.getMenuPage());
+  msLastActivity = millis();
+}
+
+
+/**
+ * Called by timeSync after the RTC was synchronized,
+ * remember the sync and the drift estimate in NVS
+*/
+void onTimeSynced(uint32_t epochSynced, float driftPpm)
+{
+  resumeState.saveSync(epochSynced, driftPpm);
+  resumeState.commit();
+}
+
+
 /**
  * Generates 3 pulse generators, each of which  
  * causes one of the RGB LEDs to flash.
@@ -133,24 +177,31 @@ void onShortClick(int x, int y)
   //log_i("Short Click x = %3d  y = %3d", x, y);
   int menuItemTouched = y / lcd.fontHeight();
   menu.onTouch((uint8_t) menuItemTouched);
+  menuChanged();
 }
 
 
+// A long click takes a screenshot of the menu
 void onLongClick(int x, int y)
 {
   log_i("Long Click x = %3d  y = %3d", x, y);
+  screenCapture.screenshot(CAPTURE_QOI);
 }
 
 
 void onSwipeLeft(int x, int y)
 {
-  log_i("Swipe <--- x = %3d  y = %3d", x, y);
+  //log_i("Swipe <--- x = %3d  y = %3d", x, y);
+  menu.OnSwipe(LEFT);
+  menuChanged();
 }
 
 
 void onSwipeRight(int x, int y)
 {
-  log_i("Swipe ---> x = %3d  y = %3d", x, y);
+  //log_i("Swipe ---> x = %3d  y = %3d", x, y);
+  menu.OnSwipe(RIGHT);
+  menuChanged();
 }
 
 
@@ -158,6 +209,7 @@ void onSwipeUp(int x, int y)
 {
   //log_i("Swipe ^^^^ x = %3d  y = %3d", x, y);
   menu.OnSwipe(UP);
+  menuChanged();
 }
 
 
@@ -165,6 +217,41 @@ void onSwipeDown(int x, int y)
 {
   //log_i("Swipe vvvv x = %3d  y = %3d", x, y);
   menu.OnSwipe(DOWN);
+  menuChanged();
+}
+
+
+/**
+ * Records the animations of the menu actions as well
+*/
+void onFrameDone()
+{
+  screenCapture.loop();
+}
+
+
+/**
+ * Capture commands of the serial monitor:
+ * b, q   screenshot as BMP or QOI to the SD card
+ * B, Q   screenshot as BMP or QOI to Serial
+ * r      start or stop a recording with 5 fps to the SD card
+ * c      print the cost of the captures
+*/
+void handleCaptureCommands()
+{
+  if (! Serial.available()) return;
+  switch (Serial.read())
+  {
+    case 'b': screenCapture.screenshot(CAPTURE_BMP); break;
+    case 'q': screenCapture.screenshot(CAPTURE_QOI); break;
+    case 'B': screenCapture.screenshot(CAPTURE_BMP, TO_SERIAL); break;
+    case 'Q': screenCapture.screenshot(CAPTURE_QOI, TO_SERIAL); break;
+    case 'r':
+      if (screenCapture.isRecording()) screenCapture.stopRecording();
+      else screenCapture.startRecording(5);
+      break;
+    case 'c': screenCapture.printStats(); break;
+  }
 }
 
 
@@ -172,15 +259,33 @@ void setup()
 {
   Serial.begin(115200);
 
-  initWiFi();
-  initRTC(timeZone);
+  // After deep sleep or a software reset the RTC and the menu position are 
+  // restored immediately, WiFi and NTP sync follow in the background.
+  // After a power-on reset only the menu position is restored.
+  bool resume = resumeState.begin() && resumeState.isTimeValid();
   initDisplay(lcd, LANDSCAPE);
-
+  spiTuner.begin();  // write clock found by the menu action "SPI Clock Tuning"
+  if (resumeState.isValid()) menu.restore(resumeState.selectedMenuItem(), resumeState.menuPage());
   menu.setup();
+
+  initWiFi(! resume);
+  initRTC(timeZone, DISCONNECT_WIFI && ! resume, ! resume);
+  if (! resume) resumeState.saveSync(time(nullptr), resumeState.driftPpm());
+
+  // Periodic resync with drift compensation, needs the WiFi connection
+  if (! DISCONNECT_WIFI || resume)
+  {
+    timeSync.addSyncCb(onTimeSynced);
+    timeSync.begin(resumeState.driftPpm());
+  }
   printDateTime(TIME_FORMAT);
   printSystemInfo();
   printConnectionDetails();
-  printNearbyNetworks();
+
+  // Scan for nearby networks in the background, 
+  // the results are printed after each scan
+  wifiScanner.addScanDoneCb(printNearbyNetworks);
+  wifiScanner.begin();
 
   // Starts the blinking task, which causes the RGB LED to flash 
   // red, green and blue alternately every second
@@ -193,10 +298,23 @@ void setup()
   touchHandler.addSwipeRightCb(onSwipeRight);
   touchHandler.addSwipeUpCb(onSwipeUp);
   touchHandler.addSwipeDownCb(onSwipeDown);
+  FrameScheduler::setFrameDoneCb(onFrameDone);
 }
 
 
 void loop() 
 { 
   touchHandler.loop();
+  timeSync.loop();
+  wifiScanner.loop();
+  handleCaptureCommands();
+  screenCapture.loop();
+
+  if (MS_IDLE_SLEEP > 0 && millis() - msLastActivity > MS_IDLE_SLEEP)
+  {
+    resumeState.saveMenu(menu.getSelectedMenuItem(), menu.getMenuPage());
+    lcd.setBrightness(0);
+    lcd.sleep();
+    resumeState.deepSleep((gpio_num_t)TP_IRQ);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+/**
+ * Arduino.h (native)
+ *
+ * Minimal replacement of the Arduino core, ESP-IDF and FreeRTOS functions
+ * used by the menu actions. Only compiled in the PlatformIO environment
+ * "native", where the actions run headless on the host computer.
+ * Tasks are mapped to std::thread, queues and semaphores to a mutex
+ * and a condition variable. A tick is 1 ms. GPIO levels are kept in
+ * memory, deep sleep ends the program.
+ */
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/time.h>
+
+using std::min;
+using std::max;
+using String = std::string;
+
+#define PI         3.1415926535897932384626433832795
+#define HALF_PI    1.5707963267948966192313216916398
+#define TWO_PI     6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define radians(deg) ((deg)*DEG_TO_RAD)
+#define degrees(rad) ((rad)*RAD_TO_DEG)
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+// Logging, esp_log_level_set("*", ...) mutes the log_* macros as well
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+inline esp_log_level_t hostLogLevel = ESP_LOG_INFO;
+inline void esp_log_level_set(const char *tag, esp_log_level_t level) { hostLogLevel = level; }
+inline esp_log_level_t esp_log_level_get(const char *tag) { return hostLogLevel; }
+#define hostLog(level, tag, format, ...) \
+  do { if (hostLogLevel >= level) printf("[" tag "] %s(): " format "\n", __func__, ##__VA_ARGS__); } while (0)
+#define log_e(format, ...) hostLog(ESP_LOG_ERROR, "E", format, ##__VA_ARGS__)
+#define log_w(format, ...) hostLog(ESP_LOG_WARN,  "W", format, ##__VA_ARGS__)
+#define log_i(format, ...) hostLog(ESP_LOG_INFO,  "I", format, ##__VA_ARGS__)
+#define log_d(format, ...)
+
+
+// Time and random numbers
+// -----------------------
+// The clock of the ESP32 is an oscillator which runs driftPpm fast against
+// the true time. The true time follows the host, or after beginStepping()
+// only advance(), so a test can run hours of drift in a moment. micros() and
+// millis() count the oscillator. The system time of gettimeofday() is the
+// oscillator plus an offset set by settimeofday(), a correction passed to
+// adjtime() is slewed at 1/64 of the elapsed time like the SDK does.
+struct HostClock
+{
+  double  driftPpm  = 0.0;       // positive if the oscillator runs fast
+  bool    isStepped = false;
+  int64_t usTrue    = 0;         // true time since the start while stepped
+  int64_t usOffset  = 0;         // system time - oscillator
+  int64_t usPending = 0;         // correction of adjtime() not yet slewed
+  int64_t usSlewed  = 0;         // oscillator time up to which it is slewed
+
+  HostClock()
+  {
+    timeval tv;
+    ::gettimeofday(&tv, NULL);
+    usOffset = tv.tv_sec * 1000000LL + tv.tv_usec - usLocal();
+  }
+  int64_t usTrueNow()
+  {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return isStepped ? usTrue : duration_cast<microseconds>(steady_clock::now() - start).count();
+  }
+  void    beginStepping() { usTrue = usTrueNow(); isStepped = true; }
+  void    advance(int64_t us) { usTrue += us; }
+  int64_t usLocal() { int64_t us = usTrueNow(); return us + (int64_t)(us * driftPpm * 1e-6); }
+  int64_t usSystem() { slew(); return usLocal() + usOffset; }
+  void    setSystem(int64_t us) { usOffset = us - usLocal(); usPending = 0; usSlewed = usLocal(); }
+  void slew()
+  {
+    int64_t now  = usLocal();
+    int64_t step = max(now - usSlewed, (int64_t)0) >> 6;
+    usSlewed = now;
+    step = usPending > 0 ? min(step, usPending) : max(-step, usPending);
+    usOffset  += step;
+    usPending -= step;
+  }
+};
+inline HostClock hostClock;
+
+inline int hostGettimeofday(timeval *tv, void *tz)
+{
+  int64_t us = hostClock.usSystem();
+  tv->tv_sec  = us / 1000000;
+  tv->tv_usec = us % 1000000;
+  return 0;
+}
+inline int hostSettimeofday(const timeval *tv, const void *tz)
+{
+  hostClock.setSystem(tv->tv_sec * 1000000LL + tv->tv_usec);
+  return 0;
+}
+inline int hostAdjtime(const timeval *delta, timeval *oldDelta)
+{
+  hostClock.slew();
+  if (oldDelta != nullptr)
+  {
+    oldDelta->tv_sec  = hostClock.usPending / 1000000;
+    oldDelta->tv_usec = hostClock.usPending % 1000000;
+  }
+  if (delta != nullptr) hostClock.usPending = delta->tv_sec * 1000000LL + delta->tv_usec;
+  return 0;
+}
+#define gettimeofday(tv, tz)   hostGettimeofday(tv, tz)
+#define settimeofday(tv, tz)   hostSettimeofday(tv, tz)
+#define adjtime(delta, old)    hostAdjtime(delta, old)
+
+inline uint32_t micros() { return (uint32_t)hostClock.usLocal(); }
+inline uint32_t millis() { return (uint32_t)(hostClock.usLocal() / 1000); }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() { std::this_thread::yield(); }
+inline void randomSeed(uint32_t seed) { srand(seed); }
+inline long random(long howBig) { return howBig > 0 ? rand() % howBig : 0; }
+inline long random(long howSmall, long howBig) { return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall); }
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+// strlcpy is missing in older C libraries of the host
+inline size_t hostStrlcpy(char *dst, const char *src, size_t size)
+{
+  size_t len = strlen(src);
+  if (size > 0)
+  {
+    size_t n = min(len, size - 1);
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#define strlcpy hostStrlcpy
+
+inline bool getLocalTime(struct tm *info, uint32_t ms = 5000)
+{
+  time_t now = (time_t)(hostClock.usSystem() / 1000000);
+  localtime_r(&now, info);
+  return true;
+}
+
+
+// Serial prints to stdout
+// -----------------------
+class HostSerial
+{
+  public:
+    void begin(uint32_t baud) {}
+    void flush() { fflush(stdout); }
+    void setDebugOutput(bool isOn) {}
+    template <typename... Args>
+    int  printf(const char *format, Args... args) { return ::printf(format, args...); }
+    size_t write(const uint8_t *data, size_t len) { return fwrite(data, 1, len, stdout); }
+    void print(const char *s) { fputs(s, stdout); }
+    void print(const String &s) { fputs(s.c_str(), stdout); }
+    void print(long n) { ::printf("%ld", n); }
+    void print(double f) { ::printf("%.2f", f); }
+    void println() { putchar('\n'); }
+    template <typename T>
+    void println(T value) { print(value); println(); }
+};
+inline HostSerial Serial;
+
+
+// GPIO and sleep
+// --------------
+#define INPUT  0x01
+#define OUTPUT 0x03
+#define LOW    0
+#define HIGH   1
+inline uint8_t hostPinLevel[40];
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) { if (pin < 40) hostPinLevel[pin] = level; }
+inline int  digitalRead(uint8_t pin) { return pin < 40 ? hostPinLevel[pin] : LOW; }
+
+typedef int gpio_num_t;
+inline int  esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) { return 0; }
+[[noreturn]] inline void esp_deep_sleep_start() { fflush(stdout); exit(0); }
+
+
+// Heap
+// ----
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+inline void  *heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+inline size_t heap_caps_get_free_size(uint32_t caps) { return 320 * 1024; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 110 * 1024; }
+
+
+// FreeRTOS
+// --------
+typedef int      BaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE             1
+#define pdFALSE            0
+#define pdPASS             pdTRUE
+#define portMAX_DELAY      0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+#define tskIDLE_PRIORITY   0
+
+struct HostQueue
+{
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t   itemSize;
+  uint32_t capacity;
+};
+typedef HostQueue* QueueHandle_t;
+typedef HostQueue* SemaphoreHandle_t;
+typedef void*      TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Waits until the predicate is true or the timeout in ticks has elapsed
+template <typename Pred>
+bool hostWait(std::unique_lock<std::mutex> &lock, HostQueue *q, TickType_t ticks, Pred pred)
+{
+  if (ticks == portMAX_DELAY) { q->cv.wait(lock, pred); return true; }
+  return q->cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+inline QueueHandle_t xQueueCreate(uint32_t length, size_t itemSize)
+{
+  HostQueue *q = new HostQueue;
+  q->itemSize = itemSize;
+  q->capacity = length;
+  return q;
+}
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(q->m);
+  if (! hostWait(lock, q, ticks, [q]{ return q->items.size() < q->capacity; })) return pdFALSE;
+  const uint8_t *p = (const uint8_t*)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(q->m);
+  if (! hostWait(lock, q, ticks, [q]{ return ! q->items.empty(); })) return pdFALSE;
+  if (q->itemSize > 0) memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+inline void vQueueDelete(QueueHandle_t q) { delete q; }
+
+// A semaphore is a queue of empty items
+inline SemaphoreHandle_t xSemaphoreCreateCounting(uint32_t maxCount, uint32_t initialCount)
+{
+  QueueHandle_t q = xQueueCreate(maxCount, 0);
+  q->items.resize(initialCount);
+  return q;
+}
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) { return xQueueReceive(s, nullptr, ticks); }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return xQueueSend(s, nullptr, 0); }
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+
+// A task is a detached std::thread, which ends when the task function
+// returns. The handle is only a number, set before the thread starts
+// because a worker clears its own handle when it is done. Limits:
+// - vTaskDelete() can only end the calling task as the last statement of
+//   the task function, like the workers do. Another task cannot be ended.
+// - Nothing waits for the threads, the owner of a task has to wait for its
+//   end, e.g. by a semaphore, before the program or the owner ends.
+// - Priorities, stack sizes and cores are ignored.
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth,
+                                          void *param, uint32_t priority, TaskHandle_t *handle, int core)
+{
+  static uint32_t taskCounter = 0;
+  if (handle) *handle = (TaskHandle_t)(uintptr_t)(++taskCounter);
+  std::thread(task, param).detach();
+  return pdPASS;
+}
+inline BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth,
+                              void *param, uint32_t priority, TaskHandle_t *handle)
+{
+  return xTaskCreatePinnedToCore(task, name, stackDepth, param, priority, handle, 1);
+}
+inline void vTaskDelete(TaskHandle_t task)
+{
+  if (task != NULL) log_e("Only the calling task can be deleted on the host");
+}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline void taskYIELD() { yield(); }
@@ -0,0 +1,47 @@
+/**
+ * Preferences.h (native)
+ *
+ * Stand-in for the NVS key-value store of the Arduino core. The values
+ * are kept in memory for the run of the program, the namespace is
+ * part of the key.
+ */
+#pragma once
+#include <Arduino.h>
+#include <map>
+
+class Preferences
+{
+  public:
+    bool begin(const char *name, bool readOnly = false) { _namespace = name; return true; }
+    void end() {}
+    bool clear() { store().clear(); return true; }
+    bool remove(const char *key) { return store().erase(fullKey(key)) > 0; }
+    size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0)
+    {
+      uint32_t value;
+      return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+      const uint8_t *p = (const uint8_t*)value;
+      store()[fullKey(key)].assign(p, p + len);
+      return len;
+    }
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+      auto it = store().find(fullKey(key));
+      if (it == store().end() || it->second.size() > maxLen) return 0;
+      memcpy(buf, it->second.data(), it->second.size());
+      return it->second.size();
+    }
+
+  private:
+    String _namespace;
+    String fullKey(const char *key) { return _namespace + "/" + key; }
+    static std::map<String, std::vector<uint8_t>> &store()
+    {
+      static std::map<String, std::vector<uint8_t>> values;
+      return values;
+    }
+};
@@ -0,0 +1,49 @@
+/**
+ * WiFi.h (native)
+ *
+ * Stand-in for the WiFi scan functions of the Arduino core, used by
+ * WiFiScanner in the native environment. A scan completes immediately
+ * and finds a fixed set of networks, so the page "WiFi Networks"
+ * can be rendered without radio, two of them are hidden. The connection
+ * status is whatever setStatus() has set, e.g. WL_CONNECTED for a test of
+ * TimeSync.
+ */
+#pragma once
+#include <Arduino.h>
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED,
+                   WL_CONNECTED, WL_CONNECT_FAILED, WL_CONNECTION_LOST, WL_DISCONNECTED };
+
+class HostWiFi
+{
+  struct Network { const char *ssid; uint8_t bssid[6]; int8_t rssi; uint8_t channel; uint8_t auth; };
+  static constexpr Network _networks[] =
+  {
+    {"HomeNet",     {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x01}, -48,  6, 3},
+    {"Office-5",    {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x02}, -61, 11, 7},
+    {"",            {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x03}, -66, 11, 3},
+    {"Guest",       {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x04}, -70,  1, 0},
+    {"",            {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x05}, -74,  6, 3},
+    {"Printer-Dir", {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x06}, -77,  6, 3},
+    {"Neighbour",   {0x24, 0x4b, 0xfe, 0x10, 0x00, 0x07}, -86,  1, 4},
+  };
+  static constexpr int _nbrNetworks = sizeof(_networks) / sizeof(_networks[0]);
+  int _scanResult = WIFI_SCAN_FAILED;
+  wl_status_t _status = WL_NO_SSID_AVAIL;   // not connecting, scans run
+
+  public:
+    wl_status_t status() { return _status; }
+    void setStatus(wl_status_t status) { _status = status; }   // host only
+    int16_t scanNetworks(bool async = false) { _scanResult = _nbrNetworks; return async ? WIFI_SCAN_RUNNING : _scanResult; }
+    int16_t scanComplete() { return _scanResult; }
+    void    scanDelete() { _scanResult = WIFI_SCAN_FAILED; }
+    String  SSID(int i) { return _networks[i].ssid; }
+    const uint8_t *BSSID(int i) { return _networks[i].bssid; }
+    int8_t  RSSI(int i) { return _networks[i].rssi; }
+    int32_t channel(int i) { return _networks[i].channel; }
+    uint8_t encryptionType(int i) { return _networks[i].auth; }
+};
+inline HostWiFi WiFi;
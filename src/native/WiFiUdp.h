@@ -0,0 +1,71 @@
+/**
+ * WiFiUdp.h (native)
+ *
+ * Stand-in for the UDP class of the Arduino core, used by TimeSync in the
+ * native environment. There is no network: a packet sent to host:port
+ * is handed to hostUdpPeer, whose response can be read with parsePacket()
+ * and read() on the next call, like a response which arrived meanwhile.
+ * Without a peer beginPacket() fails.
+ */
+#pragma once
+#include <Arduino.h>
+
+// Answers a request, returns the length of the response or 0 for none
+using HostUdpPeer = size_t (*)(const char *host, uint16_t port, const uint8_t *request, size_t len,
+                               uint8_t *response, size_t maxLen);
+inline HostUdpPeer hostUdpPeer = nullptr;
+
+class WiFiUDP
+{
+  public:
+    uint8_t begin(uint16_t port) { return 1; }
+    void    stop() {}
+    int beginPacket(const char *host, uint16_t port)
+    {
+      if (hostUdpPeer == nullptr) return 0;
+      _host = host;
+      _port = port;
+      _requestLen = 0;
+      return 1;
+    }
+    size_t write(const uint8_t *data, size_t len)
+    {
+      size_t n = min(len, sizeof(_request) - _requestLen);
+      memcpy(_request + _requestLen, data, n);
+      _requestLen += n;
+      return n;
+    }
+    int endPacket()
+    {
+      uint8_t response[512];
+      size_t n = hostUdpPeer(_host.c_str(), _port, _request, _requestLen, response, sizeof(response));
+      if (n > 0) _received.emplace_back(response, response + n);
+      return 1;
+    }
+    int parsePacket()
+    {
+      _packet.clear();
+      _read = 0;
+      if (_received.empty()) return 0;
+      _packet.swap(_received.front());
+      _received.pop_front();
+      return (int)_packet.size();
+    }
+    int read(uint8_t *data, size_t len)
+    {
+      size_t n = min(len, _packet.size() - _read);
+      memcpy(data, _packet.data() + _read, n);
+      _read += n;
+      return (int)n;
+    }
+    void flush() { _read = _packet.size(); }
+
+  private:
+    String   _host;
+    uint16_t _port = 0;
+    uint8_t  _request[512];
+    size_t   _requestLen = 0;
+    std::vector<uint8_t> _packet;                 // parsed by parsePacket()
+    size_t   _read = 0;
+    std::deque<std::vector<uint8_t>> _received;
+};
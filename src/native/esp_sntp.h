@@ -0,0 +1,9 @@
+/**
+ * esp_sntp.h (native)
+ *
+ * Stand-in for the SNTP client of ESP-IDF, which never runs in the
+ * native environment.
+ */
+#pragma once
+
+inline void sntp_stop() {}
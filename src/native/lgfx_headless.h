@@ -0,0 +1,84 @@
+/**
+ * lgfx_headless.h
+ *
+ * In-memory replacement of the class LGFX for the native environment.
+ * The panel is a 240x320 rgb565 sprite with the same rotations as the
+ * ILI9341 of the CYD, so every drawing call of the menu actions renders
+ * exactly as on the board. The touch screen is replaced by a script:
+ * the panel is pressed periodically at its center, long enough to be
+ * recognized as a long click, which ends every action.
+ */
+#pragma once
+#include <Arduino.h>
+#include <LovyanGFX.hpp>
+
+class LGFX : public lgfx::LGFX_Sprite
+{
+  public:
+    static constexpr int PANEL_WIDTH  = 240;
+    static constexpr int PANEL_HEIGHT = 320;
+
+    LGFX()
+    {
+      setColorDepth(16);
+      createSprite(PANEL_WIDTH, PANEL_HEIGHT);
+    }
+
+    bool init() { return getBuffer() != nullptr; }
+    bool begin() { return init(); }
+    void setBrightness(uint8_t brightness) {}
+    void sleep() {}
+    void wakeup() {}
+    void setTouchCalibrate(uint16_t *parameters) {}
+    void setWriteFreq(uint32_t freq) { _freqWrite = freq; }
+    uint32_t getWriteFreq() { return _freqWrite; }
+    template <typename T>
+    void calibrateTouch(uint16_t *parameters, const T &colorFg, const T &colorBg, uint8_t size = 10) {}
+
+    /**
+     * The panel is pressed for msHold every msPeriod, the first
+     * press starts msFirst after the call
+    */
+    void setTouchScript(uint32_t msFirst, uint32_t msHold, uint32_t msPeriod)
+    {
+      _msScriptStart = millis() + msFirst;
+      _msHold   = msHold;
+      _msPeriod = max(msPeriod, msHold + 1);
+    }
+
+    template <typename T>
+    uint_fast8_t getTouch(T *x, T *y, uint_fast8_t index = 0)
+    {
+      int32_t msScript = (int32_t)(millis() - _msScriptStart);
+      if (index != 0 || msScript < 0 || (uint32_t)msScript % _msPeriod >= _msHold) return 0;
+      if (x) *x = width() / 2;
+      if (y) *y = height() / 2;
+      return 1;
+    }
+
+    /**
+     * Write the screen in the current rotation as binary PPM
+    */
+    bool writePPM(const char *path)
+    {
+      FILE *f = fopen(path, "wb");
+      if (f == nullptr) return false;
+      fprintf(f, "P6\n%d %d\n255\n", (int)width(), (int)height());
+      for (int y = 0; y < height(); y++)
+      {
+        for (int x = 0; x < width(); x++)
+        {
+          auto c = readPixelRGB(x, y);
+          uint8_t rgb[3] = { c.r, c.g, c.b };
+          fwrite(rgb, 1, 3, f);
+        }
+      }
+      return fclose(f) == 0;
+    }
+
+  private:
+    uint32_t _msScriptStart = 0;
+    uint32_t _msHold   = 1500;
+    uint32_t _msPeriod = 4000;
+    uint32_t _freqWrite = 40000000;
+};
@@ -0,0 +1,20 @@
+/**
+ * rom/crc.h (native)
+ *
+ * Stand-in for the CRC functions in the ROM of the ESP32, used by
+ * ResumeState. crc32_le() is the CRC-32 of zlib, like the ROM
+ * function it inverts the CRC before and after the data.
+ */
+#pragma once
+#include <cstdint>
+
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= buf[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
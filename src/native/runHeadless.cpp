@@ -0,0 +1,401 @@
+/**
+ * Program      runHeadless.cpp
+ *
+ * Purpose      Runs the menu actions on the host computer without a display
+ *              and without touch. Each action renders into the in-memory
+ *              panel of lgfx_headless.h, the scripted touch ends it after
+ *              a few seconds. The run time of every action is printed and
+ *              the final screen is saved as snapshots/<action>.ppm, so the
+ *              effect of a change can be compared without flashing the board.
+ *
+ * Board        none, PlatformIO environment "native"
+ *
+ * Remarks      pio run -e native && .pio/build/native/program [filter]
+ *              runs all actions, or only those whose name contains filter.
+ *              Actions which wait for a tap (IFS Fractals, RGB Palettes)
+ *              only show their first page, the scripted long click ends them.
+ *              The action "SD Card Images" reads sdcard/images/.
+ *              program --decode file ...  measures the decoders of ImageCodec
+ *              with images held in memory and read in chunks.
+ *              program --fuzz n file ...  decodes n random mutations of the
+ *              files and checks that no decoder writes past its output,
+ *              best built with -fsanitize=address.
+ *              program --colorconv  checks the integer HSV conversions of
+ *              ColorConv against HSVtoRGB() and measures conversions per second.
+ *              program --timesync [ppm]  lets TimeSync discipline a clock
+ *              which runs ppm fast (default 40) against a local SNTP stand-in
+ *              for a simulated day and checks drift estimate and offset.
+ */
+#include <sys/stat.h>
+#include <vector>
+#include <WiFiUdp.h>
+#include "lgfx_ESP32_2432S028.h"
+#include "MenuActions.h"
+#include "TimeSync.h"
+
+using HeadlessAction = void (*)();
+
+struct ActionEntry
+{
+  const char     *name;
+  const char     *snapshot;
+  HeadlessAction action;
+};
+
+// Same actions as the menu in main.cpp
+ActionEntry actions[] =
+{
+  {"Text Fonts",            "TextFonts",            showTextFonts},
+  {"Digit Fonts",           "DigitFonts",           showDigitFonts},
+  {"Text Sizes",            "TextSizes",            showTextSizes},
+  {"Rotated Text",          "RotatedText",          showRotatedText},
+  {"Show Pi",               "Pi",                   showPi},
+  {"Lines from Corner",     "CornerLines",          showCornerLines},
+  {"Shrinking Rectangles",  "ShrinkingRectangles",  showShrinkingRectangles},
+  {"Rounded Rectangles",    "RoundedRectangles",    showRoundedRectangles},
+  {"Colored Circles",       "ColoredCircles",       showFilledColorCircles},
+  {"Colored Triangles",     "ColoredTriangles",     showColoredTriangles},
+  {"Sierpinsky Dreieck",    "SierpinskyTriangle",   showSierpinskyTriangle},
+  {"Mandelbrot Set",        "MandelbrotSet",        showMandelbrotSet},
+  {"Escape-Time Fractals",  "EscapeTimeFractals",   showEscapeTimeFractals},
+  {"Barnsley Fern",         "BarnsleyFern",         showBarnsleyFern},
+  {"IFS Fractals",          "IFSFractals",          showIFSFractals},
+  {"Random Walk",           "RandomWalk",           showRandomWalk},
+  {"HSV Color Circle",      "HSVcircle",            showHSVcircle},
+  {"RGB Palettes",          "RGB565palettes",       showRGB565palettes},
+  {"HSV Colored Screen",    "HSVcoloredScreen",     showHSVcoloredScreen},
+  {"Grayscale",             "GrayScale",            showGrayScale},
+  {"Digital Clock",         "ClockDigital",         showDigitalClock},
+  {"Analog Clock",          "ClockAnalog",          showAnalogClock},
+  {"WiFi Networks",         "WiFiNetworks",         showNearbyNetworks},
+  {"Benchmark",             "Benchmark",            showBenchmark},
+  {"SPI Clock Tuning",      "SpiClockTuning",       showSpiTuning},
+  {"SD Card Images",        "SdImages",             showSdImages},
+};
+constexpr int nbrActions = sizeof(actions) / sizeof(actions[0]);
+
+const uint32_t MS_FIRST_TOUCH = 4000;  // the action runs undisturbed for 4 s
+const uint32_t MS_TOUCH_HOLD  = 1500;  // long enough for a long click
+const uint32_t MS_TOUCH_CYCLE = 4000;
+const char    *SNAPSHOT_DIR   = "snapshots";
+
+LGFX lcd;
+GFXfont      defaultFont  = fonts::DejaVu18;
+DigitalClock digitalClock = DigitalClock(1000);
+AnalogClock  analogClock  = AnalogClock(1000);
+WiFiScanner  wifiScanner(30000);
+SpiTuner     spiTuner(lcd);
+
+
+/**
+ * Read a whole file into memory
+*/
+static std::vector<uint8_t> readFile(const char *path)
+{
+  std::vector<uint8_t> data;
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) return data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+  return data;
+}
+
+// ByteSource reading an image in memory in chunks of random size
+struct MemorySource { const std::vector<uint8_t> *data; size_t pos; };
+
+static size_t readMemory(void *context, uint8_t *data, size_t len)
+{
+  MemorySource *m = (MemorySource *)context;
+  size_t n = min(len, m->data->size() - m->pos);
+  if (n > 1) n = 1 + rand() % n;
+  memcpy(data, m->data->data() + m->pos, n);
+  m->pos += n;
+  return n;
+}
+
+/**
+ * Decode the image row by row, returns the number of pixels or -1 if
+ * the decoder wrote past the row. With 0 reps the image is decoded
+ * through a source, otherwise reps times from memory.
+*/
+static long decodeImage(const std::vector<uint8_t> &data, int reps, ImageDecoder &decoder)
+{
+  static constexpr uint16_t GUARD = 0xA55A;
+  uint8_t chunk[2048];
+  MemorySource source = {&data, 0};
+  long pixels = 0;
+
+  for (int r = 0; r < max(reps, 1); r++)
+  {
+    bool isOk = reps > 0 ? decoder.begin(data.data(), data.size())
+                         : decoder.begin(readMemory, &source, chunk, sizeof(chunk));
+    if (! isOk) return 0;
+    std::vector<uint16_t> row(decoder.width() + 1);
+    for (int y = 0; y < decoder.height(); y++)
+    {
+      row[decoder.width()] = GUARD;
+      uint32_t got = decoder.decode(row.data(), decoder.width());
+      if (got > (uint32_t)decoder.width() || row[decoder.width()] != GUARD) return -1;
+      pixels += got;
+      if (got < (uint32_t)decoder.width()) break;
+    }
+  }
+  return pixels;
+}
+
+static int benchmarkDecoders(int argc, char **argv)
+{
+  ImageDecoder decoder;
+  const int REPS = 20;
+
+  Serial.printf(R"(
+Decoder benchmark
+-----------------
+File                      format   width height   bytes  Mpixel/s
+)");
+  for (int i = 0; i < argc; i++)
+  {
+    std::vector<uint8_t> data = readFile(argv[i]);
+    uint32_t usStart = micros();
+    long pixels = decodeImage(data, REPS, decoder);
+    uint32_t us = max(micros() - usStart, (uint32_t)1);
+    if (pixels <= 0)
+    {
+      Serial.printf("%-24s  not an image\n", argv[i]);
+      continue;
+    }
+    Serial.printf("%-24s  %-6s  %5d  %5d  %7u  %8.1f%s\n", argv[i], decoder.getFormat() == IMG_QOI ? "QOI" : "RLE565",
+                  decoder.width(), decoder.height(), (uint32_t)data.size(), (float)pixels / us,
+                  decodeImage(data, 0, decoder) * REPS == pixels ? "" : "  streamed differs");
+  }
+  return 0;
+}
+
+static int fuzzDecoders(long nbrRuns, int argc, char **argv)
+{
+  ImageDecoder decoder;
+  long nbrDecoded = 0;
+
+  srand(1);
+  for (long run = 0; run < nbrRuns; run++)
+  {
+    std::vector<uint8_t> data = readFile(argv[run % argc]);
+    if (data.empty()) continue;
+    switch (rand() % 3)
+    {
+      case 0: data.resize(rand() % data.size()); break;
+      case 1: for (int i = 0; i < 1 + rand() % 8; i++) data[rand() % data.size()] ^= 1 << (rand() % 8); break;
+      case 2: data[rand() % data.size()] = rand(); break;
+    }
+    long pixels = decodeImage(data, run % 2, decoder);
+    if (pixels < 0)
+    {
+      Serial.printf("==> run %ld: the decoder wrote past its output\n", run);
+      return 1;
+    }
+    nbrDecoded += pixels > 0;
+  }
+  Serial.printf("%ld mutations decoded, %ld with a valid header\n", nbrRuns, nbrDecoded);
+  return 0;
+}
+
+
+/**
+ * Compare the conversions of ColorConv with the float HSVtoRGB() over all
+ * hues and a grid of saturation and value, then measure their throughput
+*/
+static int benchmarkColorConv()
+{
+  const int REPS = 400;
+  std::vector<uint16_t> hues(HUE_MAX), colors(HUE_MAX);
+  std::vector<uint32_t> rgb888(HUE_MAX);
+  int  maxError = 0;
+  long nbrDiffer = 0;
+  uint8_t R, G, B;
+
+  for (int h = 0; h < HUE_MAX; h++) hues[h] = h;
+  for (int s = 0; s <= 255; s += 15)
+  {
+    for (int v = 0; v <= 255; v += 15)
+    {
+      hsvToRgb565(hues.data(), colors.data(), HUE_MAX, s, v);
+      for (int h = 0; h < HUE_MAX; h++)
+      {
+        uint16_t c = hsvToRgb565(h, s, v);
+        uint16_t ref = HSVtoRGB(R, G, B, h * 360.0f / HUE_MAX, s / 255.0f, v / 255.0f);
+        nbrDiffer += colors[h] != c;
+        maxError = max(maxError, abs((c >> 11) - (ref >> 11)));
+        maxError = max(maxError, abs(((c >> 5) & 0x3F) - ((ref >> 5) & 0x3F)));
+        maxError = max(maxError, abs((c & 0x1F) - (ref & 0x1F)));
+      }
+    }
+  }
+
+  // Conversions per second, sum keeps the compiler from dropping the loops
+  uint32_t sum = 0;
+  uint32_t usStart = micros();
+  for (int r = 0; r < REPS; r++)
+    for (int h = 0; h < HUE_MAX; h++) sum += HSVtoRGB(R, G, B, h * 360.0f / HUE_MAX, 0.9f, 0.9f);
+  uint32_t usFloat = micros() - usStart;
+  usStart = micros();
+  for (int r = 0; r < REPS; r++)
+    for (int h = 0; h < HUE_MAX; h++) sum += hsvToRgb565(h, 230, 230);
+  uint32_t usScalar = micros() - usStart;
+  usStart = micros();
+  for (int r = 0; r < REPS; r++)
+  {
+    hsvToRgb565(hues.data(), colors.data(), HUE_MAX, 230, 230, true);
+    sum += colors[r % HUE_MAX];
+  }
+  uint32_t usBatch = micros() - usStart;
+  for (int h = 0; h < HUE_MAX; h++) rgb888[h] = hsvToRgb888(h, 230, 230);
+  usStart = micros();
+  for (int r = 0; r < REPS; r++)
+  {
+    ditherToRgb565(rgb888.data(), colors.data(), HUE_MAX, r, true);
+    sum += colors[r % HUE_MAX];
+  }
+  uint32_t usDither = micros() - usStart;
+
+  float conversions = (float)REPS * HUE_MAX;
+  bool  isOk = maxError <= 1 && nbrDiffer == 0;
+  Serial.printf(R"(
+ColorConv
+---------
+max error to HSVtoRGB()   %8d LSB
+batch differs from scalar %8ld times
+HSVtoRGB() float          %8.1f M/s
+hsvToRgb565() scalar      %8.1f M/s
+hsvToRgb565() batch       %8.1f M/s
+ditherToRgb565()          %8.1f M/s
+%s  (checksum %u)
+)", maxError, nbrDiffer, conversions / max(usFloat, (uint32_t)1), conversions / max(usScalar, (uint32_t)1),
+    conversions / max(usBatch, (uint32_t)1), conversions / max(usDither, (uint32_t)1),
+    isOk ? "==> ok" : "==> failed", sum);
+  return isOk ? 0 : 1;
+}
+
+
+// SNTP stand-in, its time is the true time of hostClock
+static constexpr int64_t US_NTP_ROUNDTRIP = 20000;
+static int64_t usServerEpoch;            // server time - true time
+
+static void putNtpTime(uint8_t *p, int64_t us)
+{
+  uint32_t sec  = (uint32_t)(us / 1000000) + 2208988800UL;
+  uint32_t frac = (uint32_t)(((us % 1000000) << 32) / 1000000);
+  for (int i = 0; i < 4; i++)
+  {
+    p[i]     = sec  >> (24 - 8 * i);
+    p[4 + i] = frac >> (24 - 8 * i);
+  }
+}
+
+static size_t answerNtp(const char *host, uint16_t port, const uint8_t *request, size_t len,
+                        uint8_t *response, size_t maxLen)
+{
+  if (port != 123 || len < 48 || maxLen < 48) return 0;
+  int64_t us = usServerEpoch + hostClock.usTrueNow() + US_NTP_ROUNDTRIP / 2;  // received half way
+  memset(response, 0, 48);
+  response[0] = 0b00100100;                 // LI = 0, version = 4, mode = 4 (server)
+  response[1] = 2;                          // stratum
+  memcpy(response + 24, request + 40, 8);   // originate timestamp = transmit timestamp of the client
+  putNtpTime(response + 32, us);
+  putNtpTime(response + 40, us);
+  return 48;
+}
+
+/**
+ * Convergence of TimeSync with a simulated clock which runs ppm fast.
+ * The response of the stand-in is read one roundtrip after the request.
+*/
+static int checkTimeSync(float ppm)
+{
+  const int64_t US_START_ERROR = 3000000;    // first sync steps the clock
+  const int     HOURS          = 24;
+  TimeSync timeSync("ntp.local", 64, 4096);
+
+  hostClock.driftPpm = ppm;
+  hostClock.beginStepping();
+  usServerEpoch = hostClock.usSystem() - hostClock.usTrueNow();
+  timeval tv = {(time_t)((hostClock.usSystem() + US_START_ERROR) / 1000000), 0};
+  settimeofday(&tv, NULL);
+  hostUdpPeer = answerNtp;
+  wl_status_t savedStatus = WiFi.status();
+  WiFi.setStatus(WL_CONNECTED);
+
+  Serial.printf("\nTimeSync with a clock running %+.1f ppm fast\n", ppm);
+  timeSync.begin();
+  for (int64_t us = 0; us < HOURS * 3600 * 1000000LL; us += US_NTP_ROUNDTRIP)
+  {
+    timeSync.loop();
+    hostClock.advance(US_NTP_ROUNDTRIP);
+  }
+  double msError = (hostClock.usSystem() - usServerEpoch - hostClock.usTrueNow()) / 1000.0;
+  float  ppmError = timeSync.getDriftPpm() - ppm;
+  bool   isConverged = fabs(msError) < 1.0 && fabsf(ppmError) < 1.0f;
+  Serial.printf(R"(
+TimeSync after %d h
+-------------------
+clock error     %+8.3f ms
+drift estimate  %+8.3f ppm  (error %+.3f ppm)
+sync interval   %8u s
+%s
+)", HOURS, msError, timeSync.getDriftPpm(), ppmError, timeSync.getSecInterval(),
+    isConverged ? "==> converged" : "==> not converged");
+  WiFi.setStatus(savedStatus);
+  hostUdpPeer = nullptr;
+  return isConverged ? 0 : 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc > 2 && strcmp(argv[1], "--decode") == 0) return benchmarkDecoders(argc - 2, argv + 2);
+  if (argc > 3 && strcmp(argv[1], "--fuzz") == 0) return fuzzDecoders(atol(argv[2]), argc - 3, argv + 3);
+  if (argc > 1 && strcmp(argv[1], "--colorconv") == 0) return benchmarkColorConv();
+  if (argc > 1 && strcmp(argv[1], "--timesync") == 0) return checkTimeSync(argc > 2 ? atof(argv[2]) : 40.0f);
+
+  const char *filter = argc > 1 ? argv[1] : "";
+  char path[80];
+  int nbrRun = 0;
+
+  if (! lcd.begin())
+  {
+    log_e("==> no memory for the panel");
+    return 1;
+  }
+  mkdir(SNAPSHOT_DIR, 0755);
+  wifiScanner.begin();
+
+  Serial.printf(R"(
+Headless run
+------------
+Action                  ms  Snapshot
+)");
+  for (int i = 0; i < nbrActions; i++)
+  {
+    if (strstr(actions[i].name, filter) == nullptr) continue;
+
+    // Same state as after initDisplay() and a click on the menu item
+    lcd.setRotation(1);
+    lcd.clear();
+    lcd.setTextSize(1.0);
+    lcd.setTextDatum(lgfx::textdatum::TL_DATUM);
+    lcd.setFont(&defaultFont);
+    lcd.setTouchScript(MS_FIRST_TOUCH, MS_TOUCH_HOLD, MS_TOUCH_CYCLE);
+
+    uint32_t msStart = millis();
+    actions[i].action();
+    uint32_t msRun = millis() - msStart;
+
+    snprintf(path, sizeof(path), "%s/%s.ppm", SNAPSHOT_DIR, actions[i].snapshot);
+    bool saved = lcd.writePPM(path);
+    Serial.printf("%-20s %7u  %s\n", actions[i].name, msRun, saved ? path : "not saved");
+    nbrRun++;
+  }
+  Serial.printf("%d actions run\n", nbrRun);
+  return nbrRun > 0 ? 0 : 1;
+}
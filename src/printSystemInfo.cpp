@@ -13,6 +13,33 @@
   const char *chipModel[] = {"UNKOWN", "ESP32", "ESP32-S", "ESP32-S3", "ESP32-C3", "ESP32-H2"};
   const char *chipFeatures[] = {"FLASH", "WIFI b/g/n", "", "", "BLE", "BT", "IEEE 802.15.4", "PSRAM"};
   esp_chip_info_t chipInfo;
+
+  /**
+   * Print the lowest free heap since boot, the largest free block of DRAM
+   * and what remains of it after allocating a full screen frame with 16,
+   * 8 and 4 bits per pixel:
+   *
+   *  Min free       180 kB
+   *  Largest blk    110 kB
+   *  Frame 16bpp    150 kB  missing    40 kB
+   *  Frame  8bpp     75 kB  headroom   35 kB
+   *  Frame  4bpp     37 kB  headroom   72 kB
+  */
+  void printFrameHeadroom()
+  {
+    int largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    const int bitsPerPixel[] = { 16, 8, 4 };
+
+    Serial.printf("  Min free    %6d kB\n", ESP.getMinFreeHeap()/1024);
+    Serial.printf("  Largest blk %6d kB\n", largest/1024);
+    for (int bpp : bitsPerPixel)
+    {
+      int size = TFT_WIDTH * TFT_HEIGHT * bpp / 8;
+      Serial.printf("  Frame %2dbpp %6d kB  %s %4d kB\n", bpp, size/1024,
+                    size <= largest ? "headroom" : "missing ", abs(largest - size)/1024);
+    }
+  }
+
   void printSystemInfo()
   {
     esp_chip_info(&chipInfo);
@@ -31,4 +58,5 @@
     Serial.printf("  Free heap   %6d kB\n", ESP.getFreeHeap()/1024);
     Serial.printf("  Psram size  %6d kB\n", ESP.getPsramSize()/1024);
     Serial.printf("  Free Psram  %6d kB\n", ESP.getFreePsram()/1024);
+    printFrameHeadroom();
   }
\ No newline at end of file